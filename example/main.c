@@ -26,6 +26,12 @@ extern simulator_settings_t settings;
 int main(int argc, char **argv)
 {
 
+    /* Create the run loop, before any thread is created */
+    if (driver_backends_init_run_loop() == -1) {
+        fprintf(stderr, "Failed to create the run loop\n");
+        exit(EXIT_FAILURE);
+    }
+
     /* Initialize LVGL. */
     lv_init();
 
@@ -43,8 +49,9 @@ int main(int argc, char **argv)
     lv_demo_widgets();
     lv_demo_widgets_start_slideshow();
 
-    /* Enter the run loop - does not return */
+    /* Enter the run loop - returns once the window is closed */
     driver_backends_run_loop();
+    driver_backends_deinit_run_loop();
 
     return 0;
 }
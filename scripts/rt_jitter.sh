@@ -0,0 +1,136 @@
+#!/bin/sh
+
+# Compare the frame intervals of topdemo with and without the real-time
+# mode (-R) while the CPUs are loaded
+#
+# Each mode runs for the same time with the frame histograms exported to a
+# file (LV_SIM_FRAME_HIST), the distributions of the intervals between the
+# frames are then printed side by side. The load comes from stress-ng when
+# it is installed, busy loops otherwise.
+#
+# The real-time mode needs CAP_SYS_NICE or an RLIMIT_RTPRIO, and an
+# RLIMIT_MEMLOCK large enough for the process, run it as root or see
+# limits.conf(5)
+
+usage() {
+    echo "usage: rt_jitter.sh [-b backend] [-d seconds] [-l load_workers] [-p priority] [topdemo_path]"
+    exit 1
+}
+
+backend=""
+duration=30
+workers=$(nproc)
+priority=""
+
+while getopts "b:d:l:p:h" opt
+do
+    case $opt in
+    b) backend="-b $OPTARG" ;;
+    d) duration=$OPTARG ;;
+    l) workers=$OPTARG ;;
+    p) priority=$OPTARG ;;
+    *) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+bin=${1:-./build/bin/topdemo}
+
+if test ! -x "$bin"
+then
+    echo "$bin not found, build it first or pass its path"
+    exit 1
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+start_load() {
+    load_pids=""
+    if command -v stress-ng > /dev/null
+    then
+        stress-ng --cpu "$workers" --vm 1 --vm-bytes 10% --io 1 --quiet &
+        load_pids=$!
+    else
+        i=0
+        while test $i -lt "$workers"
+        do
+            sh -c 'while :; do :; done' &
+            load_pids="$load_pids $!"
+            i=$((i + 1))
+        done
+    fi
+}
+
+stop_load() {
+    # shellcheck disable=SC2086
+    kill $load_pids 2> /dev/null
+    wait 2> /dev/null
+}
+
+run() {
+    mode=$1
+    shift
+
+    echo "Running $mode for $duration s under $workers load workers"
+    start_load
+
+    # SIGINT exits the run loop, the last histograms are exported on exit
+    # shellcheck disable=SC2086
+    env LV_SIM_FRAME_HIST="$tmp/$mode.jsonl" ${priority:+LV_SIM_RT_PRIORITY=$priority} \
+        timeout -s INT "$duration" "$bin" $backend "$@" > "$tmp/$mode.log" 2>&1
+
+    stop_load
+}
+
+run normal
+run realtime -R
+
+grep -h "Real-time\|SCHED_FIFO\|lock the memory" "$tmp/realtime.log"
+
+python3 - "$tmp/normal.jsonl" "$tmp/realtime.jsonl" << 'EOF'
+import json
+import sys
+
+def load(path):
+    try:
+        with open(path) as f:
+            lines = f.read().splitlines()
+        return json.loads(lines[-1])["interval_us"]
+    except (OSError, IndexError, ValueError, KeyError):
+        sys.exit("No histograms in %s, check the log of the run" % path)
+
+def percentile(hist, p):
+    """Upper bound of the bucket holding the percentile, in us"""
+    rank = hist["count"] * p / 100.0
+    seen = 0
+    for i, n in enumerate(hist["buckets"]):
+        seen += n
+        if n and seen >= rank:
+            return min(1 << i, hist["max"]) if i else 0
+    return hist["max"]
+
+def ms(us):
+    return "%.1f" % (us / 1000.0)
+
+modes = [("normal", load(sys.argv[1])), ("realtime", load(sys.argv[2]))]
+
+print("\nFrame intervals in ms, percentiles are bucket upper bounds\n")
+print("%-10s %8s %8s %8s %8s %8s %8s" % ("mode", "frames", "mean", "p50", "p99", "p99.9", "max"))
+for name, h in modes:
+    mean = h["sum"] / h["count"] if h["count"] else 0
+    print("%-10s %8d %8s %8s %8s %8s %8s" % (name, h["count"], ms(mean), ms(percentile(h, 50)),
+                                             ms(percentile(h, 99)), ms(percentile(h, 99.9)), ms(h["max"])))
+
+print("\nDistribution\n")
+print("%-20s %10s %10s" % ("interval", "normal", "realtime"))
+used = max(len(h["buckets"]) for _, h in modes)
+first = min((i for _, h in modes for i, n in enumerate(h["buckets"]) if n), default=0)
+for i in range(first, used):
+    low = (1 << (i - 1)) if i else 0
+    row = []
+    for _, h in modes:
+        n = h["buckets"][i] if i < len(h["buckets"]) else 0
+        row.append("%9.2f%%" % (100.0 * n / h["count"]) if h["count"] else "%10s" % "-")
+    print("%-20s %10s %10s" % ("[%s, %s) ms" % (ms(low), ms(1 << i)), row[0], row[1]))
+EOF
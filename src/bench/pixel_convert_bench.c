@@ -0,0 +1,180 @@
+/**
+ * @file pixel_convert_bench.c
+ *
+ * Microbenchmark of the pixel conversion kernels
+ *
+ * Converts a frame with each kernel of each implementation supported by
+ * the CPU, checks the result against the scalar kernels and prints the
+ * throughput.
+ *
+ * Usage: pixel_convert_bench [-w width] [-h height] [-n iterations]
+ * A width that is not a multiple of 16 also checks the tails of the
+ * vector kernels.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pixel_convert.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* A kernel and the size of its pixels */
+typedef struct {
+    const char *name;
+    size_t offset;                      /* of the kernel in pixel_convert_ops_t */
+    uint32_t src_size;
+    uint32_t dst_size;
+} kernel_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static pixel_convert_fn_t get_fn(const pixel_convert_ops_t *ops, const kernel_t *k);
+static double now_s(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static const kernel_t kernels[] = {
+    {"rgb565_to_xrgb8888", offsetof(pixel_convert_ops_t, rgb565_to_xrgb8888), 2, 4},
+    {"xrgb8888_to_rgb565", offsetof(pixel_convert_ops_t, xrgb8888_to_rgb565), 4, 2},
+    {"rgb565_swap", offsetof(pixel_convert_ops_t, rgb565_swap), 2, 2},
+};
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(int argc, char **argv)
+{
+    const pixel_convert_ops_t *all[PIXEL_CONVERT_MAX_IMPLS];
+    uint32_t w = 800;
+    uint32_t h = 480;
+    uint32_t n = 200;
+    uint32_t count;
+    uint32_t i;
+    uint8_t *src;
+    uint8_t *dst;
+    uint8_t *ref;
+    double t;
+    int impls;
+    int opt;
+    int ret = 0;
+    int j;
+    size_t k;
+
+    while ((opt = getopt(argc, argv, "w:h:n:")) != -1) {
+        switch (opt) {
+        case 'w':
+            w = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'h':
+            h = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            n = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-w width] [-h height] [-n iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (w == 0 || h == 0 || n == 0) {
+        fprintf(stderr, "The size and the iterations must not be 0\n");
+        return 1;
+    }
+
+    count = w * h;
+    src = malloc((size_t)count * 4);
+    dst = malloc((size_t)count * 4);
+    ref = malloc((size_t)count * 4);
+
+    if (src == NULL || dst == NULL || ref == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    srand(1);
+    for (i = 0; i < count * 4; i++) {
+        src[i] = (uint8_t)rand();
+    }
+
+    impls = pixel_convert_get_all(all, PIXEL_CONVERT_MAX_IMPLS);
+
+    printf("%ux%u, %u iterations, selected: %s\n", (unsigned)w, (unsigned)h, (unsigned)n,
+           pixel_convert_get()->name);
+    printf("%-20s %-8s %10s %10s\n", "kernel", "impl", "Mpx/s", "GB/s");
+
+    for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        get_fn(all[0], &kernels[k])(ref, src, count);
+
+        for (j = 0; j < impls; j++) {
+            pixel_convert_fn_t fn = get_fn(all[j], &kernels[k]);
+
+            memset(dst, 0, (size_t)count * 4);
+            pixel_convert_area(fn, dst, w * kernels[k].dst_size, src, w * kernels[k].src_size, w, h);
+
+            if (memcmp(dst, ref, (size_t)count * kernels[k].dst_size) != 0) {
+                printf("%-20s %-8s MISMATCH\n", kernels[k].name, all[j]->name);
+                ret = 1;
+                continue;
+            }
+
+            t = now_s();
+            for (i = 0; i < n; i++) {
+                pixel_convert_area(fn, dst, w * kernels[k].dst_size, src, w * kernels[k].src_size, w, h);
+            }
+            t = now_s() - t;
+
+            printf("%-20s %-8s %10.1f %10.2f\n", kernels[k].name, all[j]->name,
+                   (double)count * n / t / 1e6,
+                   (double)count * n * (kernels[k].src_size + kernels[k].dst_size) / t / 1e9);
+        }
+    }
+
+    free(src);
+    free(dst);
+    free(ref);
+
+    return ret;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static pixel_convert_fn_t get_fn(const pixel_convert_ops_t *ops, const kernel_t *k)
+{
+    pixel_convert_fn_t fn;
+
+    memcpy(&fn, (const uint8_t *)ops + k->offset, sizeof(fn));
+    return fn;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
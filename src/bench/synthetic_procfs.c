@@ -0,0 +1,322 @@
+/**
+ * @file synthetic_procfs.c
+ *
+ * Synthetic /proc and /sys trees for the benchmarks
+ *
+ * The activity of each core and process is drawn from a hash of its
+ * index and the step, there is no random state to seed.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "synthetic_procfs.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* The first pid of the synthetic processes */
+#define FIRST_PID       100
+
+/* 8 GiB of memory */
+#define MEM_TOTAL_KB    8388608ULL
+
+/* Large enough for /proc/stat with SYNTHETIC_PROCFS_MAX_CORES */
+#define FILE_BUF_SIZE   8192
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static int write_system(synthetic_procfs_t *fs);
+static int write_process(synthetic_procfs_t *fs, uint32_t idx);
+static int write_file(const synthetic_procfs_t *fs, const char *path, const char *fmt, ...);
+static uint32_t hash(uint32_t a, uint32_t b);
+static int remove_cb(const char *path, const struct stat *st, int flag, struct FTW *ftw);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static const char *const proc_names[] = {
+    "systemd", "kworker/0:1", "sshd", "bash", "Xwayland", "pipewire",
+    "dbus-daemon", "journald", "chrome", "code", "python3", "make",
+};
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int synthetic_procfs_create(synthetic_procfs_t *fs, uint32_t cores, uint32_t procs)
+{
+    char path[PATH_MAX + 32];
+    uint32_t i;
+
+    memset(fs, 0, sizeof(*fs));
+
+    if (cores == 0 || cores > SYNTHETIC_PROCFS_MAX_CORES) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    fs->cores = cores;
+    fs->procs = procs;
+    fs->proc_ticks = calloc(procs + 1, sizeof(uint64_t));
+    fs->proc_io = calloc(procs + 1, sizeof(uint64_t));
+    if (fs->proc_ticks == NULL || fs->proc_io == NULL) {
+        synthetic_procfs_destroy(fs);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    snprintf(fs->root, sizeof(fs->root), "%s/synthetic_procfs.XXXXXX", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+    if (mkdtemp(fs->root) == NULL) {
+        fs->root[0] = '\0';
+        synthetic_procfs_destroy(fs);
+        return -1;
+    }
+
+    /* The whole disks are listed in /sys/block, not the partitions */
+    snprintf(path, sizeof(path), "%s/proc", fs->root);
+    if (mkdir(path, 0755) != 0) {
+        goto err;
+    }
+
+    snprintf(path, sizeof(path), "%s/sys", fs->root);
+    if (mkdir(path, 0755) != 0) {
+        goto err;
+    }
+
+    snprintf(path, sizeof(path), "%s/sys/block", fs->root);
+    if (mkdir(path, 0755) != 0) {
+        goto err;
+    }
+
+    snprintf(path, sizeof(path), "%s/sys/block/vda", fs->root);
+    if (mkdir(path, 0755) != 0) {
+        goto err;
+    }
+
+    for (i = 0; i < procs; i++) {
+        snprintf(path, sizeof(path), "%s/proc/%u", fs->root, (unsigned)(FIRST_PID + i));
+        if (mkdir(path, 0755) != 0) {
+            goto err;
+        }
+    }
+
+    if (synthetic_procfs_step(fs) != 0) {
+        goto err;
+    }
+
+    return 0;
+
+err:
+    synthetic_procfs_destroy(fs);
+    return -1;
+}
+
+int synthetic_procfs_step(synthetic_procfs_t *fs)
+{
+    uint32_t i;
+
+    fs->step++;
+
+    if (write_system(fs) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < fs->procs; i++) {
+        if (write_process(fs, i) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void synthetic_procfs_destroy(synthetic_procfs_t *fs)
+{
+    if (fs->root[0] != '\0') {
+        nftw(fs->root, remove_cb, 16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    free(fs->proc_ticks);
+    free(fs->proc_io);
+    memset(fs, 0, sizeof(*fs));
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Write stat, meminfo, loadavg and diskstats
+ */
+static int write_system(synthetic_procfs_t *fs)
+{
+    char buf[FILE_BUF_SIZE];
+    uint64_t busy = 0;
+    uint64_t idle = 0;
+    uint64_t avail_kb;
+    uint32_t load;
+    uint32_t delta;
+    size_t len = 0;
+    uint32_t i;
+
+    /* Each core is busy a share of the last second, the cpu line sums them */
+    for (i = 0; i < fs->cores; i++) {
+        delta = hash(fs->step, i) % (SYNTHETIC_PROCFS_HZ + 1);
+        fs->core_busy[i] += delta;
+        fs->core_idle[i] += SYNTHETIC_PROCFS_HZ - delta;
+        busy += fs->core_busy[i];
+        idle += fs->core_idle[i];
+    }
+
+    /* user nice system idle iowait irq softirq steal guest guest_nice */
+    len += (size_t)snprintf(buf + len, sizeof(buf) - len, "cpu  %llu 0 %llu %llu 0 0 0 0 0 0\n",
+                            (unsigned long long)(busy - busy / 4), (unsigned long long)(busy / 4),
+                            (unsigned long long)idle);
+    for (i = 0; i < fs->cores; i++) {
+        len += (size_t)snprintf(buf + len, sizeof(buf) - len, "cpu%u %llu 0 %llu %llu 0 0 0 0 0 0\n", (unsigned)i,
+                                (unsigned long long)(fs->core_busy[i] - fs->core_busy[i] / 4),
+                                (unsigned long long)(fs->core_busy[i] / 4), (unsigned long long)fs->core_idle[i]);
+    }
+    snprintf(buf + len, sizeof(buf) - len, "ctxt %llu\nbtime 1700000000\nprocesses %u\n",
+             (unsigned long long)fs->step * 1000, (unsigned)fs->procs);
+
+    if (write_file(fs, "/proc/stat", "%s", buf) != 0) {
+        return -1;
+    }
+
+    /* Between a quarter and three quarters of the memory is available */
+    avail_kb = MEM_TOTAL_KB / 4 + (uint64_t)(hash(fs->step, 1000) % 1024) * (MEM_TOTAL_KB / 2048);
+    if (write_file(fs, "/proc/meminfo", "MemTotal: %llu kB\nMemFree: %llu kB\nMemAvailable: %llu kB\n"
+                   "Buffers: 0 kB\nCached: 0 kB\n", MEM_TOTAL_KB, (unsigned long long)avail_kb / 2,
+                   (unsigned long long)avail_kb) != 0) {
+        return -1;
+    }
+
+    load = hash(fs->step, 2000) % (fs->cores * 100);
+    if (write_file(fs, "/proc/loadavg", "%u.%02u %u.%02u %u.%02u 2/%u %u\n",
+                   (unsigned)load / 100, (unsigned)load % 100, (unsigned)load / 150, (unsigned)load % 100,
+                   (unsigned)load / 200, (unsigned)load % 100, (unsigned)fs->procs,
+                   (unsigned)(FIRST_PID + fs->procs)) != 0) {
+        return -1;
+    }
+
+    /* The partition must not be summed with its disk */
+    fs->sectors_read += hash(fs->step, 3000) % 20000;
+    fs->sectors_written += hash(fs->step, 3001) % 20000;
+    return write_file(fs, "/proc/diskstats",
+                      " 253       0 vda 1000 0 %llu 500 2000 0 %llu 900 0 1000 1400\n"
+                      " 253       1 vda1 1000 0 %llu 500 2000 0 %llu 900 0 1000 1400\n",
+                      (unsigned long long)fs->sectors_read, (unsigned long long)fs->sectors_written,
+                      (unsigned long long)fs->sectors_read, (unsigned long long)fs->sectors_written);
+}
+
+/**
+ * Write /proc/[pid]/stat and /proc/[pid]/io
+ */
+static int write_process(synthetic_procfs_t *fs, uint32_t idx)
+{
+    char path[64];
+    char name[16];
+    uint32_t pid = FIRST_PID + idx;
+    uint32_t h = hash(fs->step, pid);
+    unsigned long long ticks;
+    unsigned long long rss_pages;
+
+    /* A few busy processes, most of them idle */
+    fs->proc_ticks[idx] += idx % 16 == 0 ? h % SYNTHETIC_PROCFS_HZ : h % 3;
+    fs->proc_io[idx] += idx % 8 == 0 ? (h % 4096) * 1024 : 0;
+    ticks = fs->proc_ticks[idx];
+    rss_pages = 256 + hash(pid, 0) % 65536 + h % 64;
+
+    snprintf(name, sizeof(name), "%s", proc_names[idx % (sizeof(proc_names) / sizeof(proc_names[0]))]);
+
+    /* pid (comm) state ppid pgrp session tty tpgid flags minflt cminflt majflt cmajflt
+     * utime stime cutime cstime priority nice threads itrealvalue starttime vsize rss */
+    snprintf(path, sizeof(path), "/proc/%u/stat", (unsigned)pid);
+    if (write_file(fs, path, "%u (%s) %c 1 %u %u 0 -1 4194560 0 0 0 0 %llu %llu 0 0 20 0 1 0 %u %llu %llu\n",
+                   (unsigned)pid, name, idx % 16 == 0 ? 'R' : 'S', (unsigned)pid, (unsigned)pid,
+                   ticks - ticks / 4, ticks / 4, (unsigned)(idx * 10), rss_pages * 4096 * 4, rss_pages) != 0) {
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%u/io", (unsigned)pid);
+    return write_file(fs, path, "rchar: %llu\nwchar: %llu\nsyscr: 0\nsyscw: 0\nread_bytes: %llu\n"
+                      "write_bytes: %llu\ncancelled_write_bytes: 0\n",
+                      (unsigned long long)fs->proc_io[idx], (unsigned long long)fs->proc_io[idx] / 2,
+                      (unsigned long long)fs->proc_io[idx], (unsigned long long)fs->proc_io[idx] / 2);
+}
+
+/**
+ * Replace the content of a file below the root, keeping its inode
+ * @return 0 on success, -1 with errno set on error
+ */
+static int write_file(const synthetic_procfs_t *fs, const char *path, const char *fmt, ...)
+{
+    char full[PATH_MAX + 64];
+    char buf[FILE_BUF_SIZE];
+    va_list args;
+    ssize_t n;
+    int len;
+    int fd;
+
+    va_start(args, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    if (len < 0 || (size_t)len >= sizeof(buf)) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    snprintf(full, sizeof(full), "%s%s", fs->root, path);
+    fd = open(full, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    n = write(fd, buf, (size_t)len);
+    if (n != len) {
+        if (n >= 0) {
+            errno = EIO;
+        }
+        close(fd);
+        return -1;
+    }
+
+    return close(fd);
+}
+
+static uint32_t hash(uint32_t a, uint32_t b)
+{
+    uint64_t k = ((uint64_t)a << 32) | b;
+
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return (uint32_t)k;
+}
+
+static int remove_cb(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+
+    return remove(path);
+}
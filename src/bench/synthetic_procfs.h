@@ -0,0 +1,90 @@
+/**
+ * @file synthetic_procfs.h
+ *
+ * Synthetic /proc and /sys trees for the benchmarks
+ *
+ * Writes the system wide files read by the sampler and a fixed set of
+ * processes below a temporary directory. The content of every sample is
+ * a function of the step only, point procfs_set_root() at the tree and
+ * every run renders the same values.
+ */
+
+#ifndef SYNTHETIC_PROCFS_H
+#define SYNTHETIC_PROCFS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <limits.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Highest number of cores of the synthetic system */
+#define SYNTHETIC_PROCFS_MAX_CORES  64
+
+/* Ticks per second of the counters, the USER_HZ of the kernel */
+#define SYNTHETIC_PROCFS_HZ         100
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    char root[PATH_MAX];                /* the directory to pass to procfs_set_root() */
+    uint32_t cores;
+    uint32_t procs;
+    uint32_t step;                      /* samples written so far */
+    /* Cumulative counters */
+    uint64_t core_busy[SYNTHETIC_PROCFS_MAX_CORES];
+    uint64_t core_idle[SYNTHETIC_PROCFS_MAX_CORES];
+    uint64_t sectors_read;
+    uint64_t sectors_written;
+    uint64_t *proc_ticks;               /* one per process */
+    uint64_t *proc_io;
+} synthetic_procfs_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Create the tree in a new temporary directory and write the first sample
+ * @param fs the tree to initialize
+ * @param cores the number of cores, at most SYNTHETIC_PROCFS_MAX_CORES
+ * @param procs the number of processes
+ * @return 0 on success, -1 with errno set on error
+ */
+int synthetic_procfs_create(synthetic_procfs_t *fs, uint32_t cores, uint32_t procs);
+
+/**
+ * Rewrite the files with the next sample
+ * @description the counters advance by one second of activity, the files
+ * are truncated and rewritten in place so that the opened ones see the
+ * new content
+ * @param fs the tree
+ * @return 0 on success, -1 with errno set on error
+ */
+int synthetic_procfs_step(synthetic_procfs_t *fs);
+
+/**
+ * Remove the tree and release the counters
+ * @param fs the tree
+ */
+void synthetic_procfs_destroy(synthetic_procfs_t *fs);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*SYNTHETIC_PROCFS_H*/
@@ -0,0 +1,460 @@
+/**
+ * @file topdemo_bench.c
+ *
+ * Deterministic rendering benchmark of the dashboard
+ *
+ * LVGL runs on a virtual tick that advances by a fixed step per frame,
+ * the sampler is driven manually on a synthetic /proc whose content
+ * only depends on the sample number. Every run therefore renders the
+ * same frames, only the time they take changes between builds and
+ * backends.
+ *
+ * The views of top_demo_init() and the LVGL benchmark demo are rendered
+ * in turn, the frame, render and flush times of each are reported as
+ * JSON with their p50, p95 and p99. The JSON goes to stdout by default,
+ * the logs of LVGL and the backends are moved to stderr.
+ *
+ * Usage: topdemo_bench [-b backend] [-W width] [-H height] [-n frames]
+ *                      [-w warmup] [-t tick_ms] [-s sample_ms]
+ *                      [-c cores] [-p processes] [-o output.json]
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "lvgl/lvgl.h"
+#include "lvgl/demos/lv_demos.h"
+
+#include "simulator_util.h"
+#include "simulator_settings.h"
+#include "driver_backends.h"
+#include "top_demo.h"
+#include "sampler.h"
+#include "procfs.h"
+#include "synthetic_procfs.h"
+#include "mem_alloc.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* A workload, entered once then rendered for the configured frames */
+typedef struct {
+    const char *name;
+    void (*enter)(void);
+} phase_t;
+
+/* The samples of a phase, in microseconds */
+typedef struct {
+    uint32_t *frame_us;                 /* refresh start to refresh ready */
+    uint32_t *render_us;                /* rendering, without the flushes */
+    uint32_t *flush_us;                 /* flush callbacks and waits for them */
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t idle;                      /* refreshes with nothing to render */
+} phase_stats_t;
+
+/**********************
+ *  EXTERNAL VARIABLES
+ **********************/
+extern simulator_settings_t settings;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void enter_dashboard(void);
+static void enter_processes(void);
+static void enter_heatmap(void);
+#if LV_USE_DEMO_BENCHMARK
+static void enter_lvgl_benchmark(void);
+#endif
+static void run_phase(lv_display_t *disp, uint32_t frames, bool record);
+static void refr_event_cb(lv_event_t *e);
+static uint32_t virtual_tick(void);
+static uint64_t virtual_ns(void);
+static int compare_u32(const void *a, const void *b);
+static void print_metric(FILE *f, const char *name, uint32_t *values, uint32_t count, bool last);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static const phase_t phases[] = {
+    {"dashboard", enter_dashboard},
+    {"processes", enter_processes},
+    {"heatmap", enter_heatmap},
+#if LV_USE_DEMO_BENCHMARK
+    {"lvgl_benchmark", enter_lvgl_benchmark},
+#endif
+};
+
+static synthetic_procfs_t synthetic;
+static uint32_t virtual_ms;
+static uint32_t tick_ms = 16;
+static uint32_t sample_ms = 1000;
+static uint32_t next_sample_ms;
+
+/* The phase being recorded, NULL during the warmup */
+static phase_stats_t *stats;
+static uint64_t refr_start_us;
+static uint64_t render_start_us;
+static uint64_t render_total_us;
+static uint64_t flush_start_us;
+static uint64_t flush_total_us;
+static bool rendered;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(int argc, char **argv)
+{
+    phase_stats_t results[sizeof(phases) / sizeof(phases[0])];
+    char *backend = "HEADLESS";
+    const char *output = "-";
+    uint32_t frames = 300;
+    uint32_t warmup = 10;
+    uint32_t cores = 8;
+    uint32_t procs = 300;
+    lv_display_t *disp;
+    mem_alloc_stats_t mem;
+    FILE *f;
+    int json_fd = -1;
+    size_t i;
+    int opt;
+
+    settings.window_width = 800;
+    settings.window_height = 480;
+
+    driver_backends_register();
+
+    while ((opt = getopt(argc, argv, "b:W:H:n:w:t:s:c:p:o:")) != -1) {
+        switch (opt) {
+        case 'b':
+            if (driver_backends_is_supported(optarg) == 0) {
+                die("error no such backend: %s\n", optarg);
+            }
+            backend = optarg;
+            break;
+        case 'W':
+            settings.window_width = (uint32_t)atoi(optarg);
+            break;
+        case 'H':
+            settings.window_height = (uint32_t)atoi(optarg);
+            break;
+        case 'n':
+            frames = (uint32_t)atoi(optarg);
+            break;
+        case 'w':
+            warmup = (uint32_t)atoi(optarg);
+            break;
+        case 't':
+            tick_ms = (uint32_t)atoi(optarg);
+            break;
+        case 's':
+            sample_ms = (uint32_t)atoi(optarg);
+            break;
+        case 'c':
+            cores = (uint32_t)atoi(optarg);
+            break;
+        case 'p':
+            procs = (uint32_t)atoi(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            die("Usage: %s [-b backend] [-W width] [-H height] [-n frames] [-w warmup] "
+                "[-t tick_ms] [-s sample_ms] [-c cores] [-p processes] [-o output.json]\n", argv[0]);
+        }
+    }
+
+    if (frames == 0 || tick_ms == 0 || sample_ms == 0) {
+        die("The frames, the tick and the sample period must not be 0\n");
+    }
+
+    /* LVGL and the backends print to stdout, only the JSON is kept on it */
+    if (strcmp(output, "-") == 0) {
+        fflush(stdout);
+        json_fd = dup(STDOUT_FILENO);
+        if (json_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            die("Failed to redirect stdout: %s\n", strerror(errno));
+        }
+    }
+
+    /* The sampler reads the synthetic tree, timed on the virtual clock */
+    if (synthetic_procfs_create(&synthetic, cores, procs) != 0) {
+        die("Failed to create the synthetic procfs: %s\n", strerror(errno));
+    }
+
+    procfs_set_root(synthetic.root);
+    procfs_set_clock(virtual_ns);
+
+    lv_init();
+    lv_tick_set_cb(virtual_tick);
+    mem_alloc_tag_draw_bufs();
+
+    if (driver_backends_init_backend(backend) == -1) {
+        synthetic_procfs_destroy(&synthetic);
+        die("Failed to initialize the %s backend\n", backend);
+    }
+
+    disp = lv_display_get_default();
+    lv_display_add_event_cb(disp, refr_event_cb, LV_EVENT_ALL, NULL);
+
+    /* top_demo_init() does not start the sampler thread once it runs manually */
+    if (sampler_start_manual() != 0) {
+        lv_deinit();
+        synthetic_procfs_destroy(&synthetic);
+        die("Failed to start the sampler\n");
+    }
+    top_demo_init();
+
+    for (i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+        memset(&results[i], 0, sizeof(results[i]));
+        results[i].capacity = frames;
+        results[i].frame_us = malloc(frames * sizeof(uint32_t));
+        results[i].render_us = malloc(frames * sizeof(uint32_t));
+        results[i].flush_us = malloc(frames * sizeof(uint32_t));
+        if (results[i].frame_us == NULL || results[i].render_us == NULL || results[i].flush_us == NULL) {
+            die("Out of memory\n");
+        }
+
+        phases[i].enter();
+
+        stats = NULL;
+        run_phase(disp, warmup, false);
+
+        stats = &results[i];
+        run_phase(disp, frames, true);
+        stats = NULL;
+    }
+
+    f = json_fd >= 0 ? fdopen(json_fd, "w") : fopen(output, "w");
+    if (f == NULL) {
+        die("Failed to open %s: %s\n", output, strerror(errno));
+    }
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"backend\": \"%s\",\n", backend);
+    fprintf(f, "  \"width\": %u,\n  \"height\": %u,\n", (unsigned)settings.window_width,
+            (unsigned)settings.window_height);
+    fprintf(f, "  \"tick_ms\": %u,\n  \"sample_ms\": %u,\n", (unsigned)tick_ms, (unsigned)sample_ms);
+    fprintf(f, "  \"warmup\": %u,\n  \"cores\": %u,\n  \"processes\": %u,\n", (unsigned)warmup,
+            (unsigned)cores, (unsigned)procs);
+
+    /* Bytes held by each subsystem at the end of the run */
+    if (mem_alloc_get_stats(&mem) == 0) {
+        fprintf(f, "  \"memory\": {");
+        for (i = 0; i < MEM_TAG_COUNT; i++) {
+            fprintf(f, "\"%s\": %zu, ", mem_tag_name((mem_tag_t)i), mem.tags[i].bytes);
+        }
+        fprintf(f, "\"peak\": %zu, \"arena\": %zu},\n", mem.peak_used, mem.arena_size);
+    }
+
+    fprintf(f, "  \"phases\": [\n");
+
+    for (i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+        fprintf(f, "    {\n      \"name\": \"%s\",\n      \"frames\": %u,\n      \"idle\": %u,\n",
+                phases[i].name, (unsigned)results[i].count, (unsigned)results[i].idle);
+        print_metric(f, "frame_us", results[i].frame_us, results[i].count, false);
+        print_metric(f, "render_us", results[i].render_us, results[i].count, false);
+        print_metric(f, "flush_us", results[i].flush_us, results[i].count, true);
+        fprintf(f, "    }%s\n", i + 1 < sizeof(phases) / sizeof(phases[0]) ? "," : "");
+
+        free(results[i].frame_us);
+        free(results[i].render_us);
+        free(results[i].flush_us);
+    }
+
+    fprintf(f, "  ]\n}\n");
+
+    fclose(f);
+
+    top_demo_deinit();
+    lv_deinit();
+    synthetic_procfs_destroy(&synthetic);
+
+    return 0;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void enter_dashboard(void)
+{
+    top_demo_show(TOP_DEMO_VIEW_DASHBOARD);
+}
+
+static void enter_processes(void)
+{
+    top_demo_show(TOP_DEMO_VIEW_PROCESSES);
+}
+
+static void enter_heatmap(void)
+{
+    top_demo_show(TOP_DEMO_VIEW_HEATMAP);
+}
+
+#if LV_USE_DEMO_BENCHMARK
+/**
+ * The demo gets a screen of its own, the dashboard stops updating
+ */
+static void enter_lvgl_benchmark(void)
+{
+    lv_obj_t *scr = lv_obj_create(NULL);
+
+    top_demo_deinit();
+    lv_screen_load(scr);
+    lv_demo_benchmark();
+}
+#endif
+
+/**
+ * Render frames, one per tick of the virtual clock
+ */
+static void run_phase(lv_display_t *disp, uint32_t frames, bool record)
+{
+    uint32_t rendered_frames = 0;
+    uint32_t attempts = 0;
+
+    /* A static view can go idle, the attempts are bounded */
+    while (rendered_frames < frames && attempts < frames * 4) {
+        virtual_ms += tick_ms;
+        attempts++;
+
+        if (virtual_ms >= next_sample_ms) {
+            synthetic_procfs_step(&synthetic);
+            sampler_step();
+            next_sample_ms = virtual_ms + sample_ms;
+        }
+
+        /* Only lv_refr_now() renders, at most once per tick */
+        lv_timer_pause(lv_display_get_refr_timer(disp));
+        lv_timer_handler();
+
+        rendered = false;
+        lv_refr_now(disp);
+
+        if (rendered || !record) {
+            rendered_frames++;
+        }
+    }
+}
+
+/**
+ * Time the steps of the refreshes
+ */
+static void refr_event_cb(lv_event_t *e)
+{
+    uint64_t now = now_us();
+    uint64_t render_us;
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_REFR_START:
+        refr_start_us = now;
+        render_total_us = 0;
+        flush_total_us = 0;
+        break;
+    case LV_EVENT_RENDER_START:
+        render_start_us = now;
+        rendered = true;
+        break;
+    case LV_EVENT_RENDER_READY:
+        render_total_us = now - render_start_us;
+        break;
+    case LV_EVENT_FLUSH_START:
+    case LV_EVENT_FLUSH_WAIT_START:
+        flush_start_us = now;
+        break;
+    case LV_EVENT_FLUSH_FINISH:
+    case LV_EVENT_FLUSH_WAIT_FINISH:
+        flush_total_us += now - flush_start_us;
+        break;
+    case LV_EVENT_REFR_READY:
+        if (stats == NULL) {
+            break;
+        }
+
+        if (!rendered) {
+            stats->idle++;
+            break;
+        }
+
+        if (stats->count < stats->capacity) {
+            render_us = render_total_us > flush_total_us ? render_total_us - flush_total_us : 0;
+            stats->frame_us[stats->count] = (uint32_t)(now - refr_start_us);
+            stats->render_us[stats->count] = (uint32_t)render_us;
+            stats->flush_us[stats->count] = (uint32_t)flush_total_us;
+            stats->count++;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static uint32_t virtual_tick(void)
+{
+    return virtual_ms;
+}
+
+static uint64_t virtual_ns(void)
+{
+    return (uint64_t)virtual_ms * 1000000ULL;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Print the percentiles of a metric, nearest rank
+ */
+static void print_metric(FILE *f, const char *name, uint32_t *values, uint32_t count, bool last)
+{
+    static const uint32_t percentiles[] = {50, 95, 99};
+    uint64_t sum = 0;
+    uint32_t i;
+
+    fprintf(f, "      \"%s\": {", name);
+
+    if (count == 0) {
+        fprintf(f, "\"p50\": 0, \"p95\": 0, \"p99\": 0, \"max\": 0, \"mean\": 0}%s\n", last ? "" : ",");
+        return;
+    }
+
+    qsort(values, count, sizeof(values[0]), compare_u32);
+
+    for (i = 0; i < count; i++) {
+        sum += values[i];
+    }
+
+    for (i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        fprintf(f, "\"p%u\": %u, ", (unsigned)percentiles[i],
+                (unsigned)values[(percentiles[i] * count + 99) / 100 - 1]);
+    }
+
+    fprintf(f, "\"max\": %u, \"mean\": %.1f}%s\n", (unsigned)values[count - 1], (double)sum / count,
+            last ? "" : ",");
+}
@@ -0,0 +1,298 @@
+/**
+ * @file core_heatmap.c
+ *
+ * Per-core CPU usage heatmap
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <string.h>
+
+#include "core_heatmap.h"
+#include "lib/mem_alloc.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Width of a sample in pixels */
+#define HEATMAP_COLUMN_WIDTH    2
+
+/* Bounds of the height of a core in pixels */
+#define HEATMAP_MIN_ROW_HEIGHT  2
+#define HEATMAP_MAX_ROW_HEIGHT  24
+
+/* Color of the column following the newest sample */
+#define HEATMAP_CURSOR_COLOR    0x000000
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    lv_draw_buf_t *buf;
+    lv_image_dsc_t image;               /* the whole buffer */
+    uint32_t columns;
+    uint32_t head;                      /* column written by the next sample */
+    uint32_t height;                    /* requested height */
+    uint32_t cores;                     /* number of cores the buffer is laid out for */
+    uint32_t row_height;                /* pixels per core */
+} heatmap_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void init_palette(void);
+static int resize(lv_obj_t *obj, heatmap_t *hm, uint32_t cores);
+static void fill_column(heatmap_t *hm, uint32_t column, uint32_t y1, uint32_t y2, uint16_t color);
+static void invalidate_column(lv_obj_t *obj, uint32_t column);
+static void set_image(heatmap_t *hm);
+static void draw_cb(lv_event_t *e);
+static void delete_cb(lv_event_t *e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/* RGB565 color of each percentage */
+static uint16_t palette[101];
+static uint16_t cursor_color;
+static bool palette_ready;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+lv_obj_t *core_heatmap_create(lv_obj_t *parent, uint32_t columns, uint32_t height)
+{
+    lv_obj_t *obj;
+    heatmap_t *hm;
+
+    if (!palette_ready) {
+        init_palette();
+    }
+
+    hm = lv_malloc_zeroed(sizeof(*hm));
+    LV_ASSERT_MALLOC(hm);
+    if (hm == NULL) {
+        return NULL;
+    }
+
+    hm->columns = columns;
+    hm->height = height;
+
+    obj = lv_obj_create(parent);
+    lv_obj_remove_style_all(obj);
+    lv_obj_remove_flag(obj, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_user_data(obj, hm);
+    lv_obj_add_event_cb(obj, draw_cb, LV_EVENT_DRAW_MAIN, NULL);
+    lv_obj_add_event_cb(obj, delete_cb, LV_EVENT_DELETE, NULL);
+
+    /* Laid out for one core until the first sample */
+    resize(obj, hm, 1);
+
+    return obj;
+}
+
+void core_heatmap_push(lv_obj_t *heatmap, const uint8_t *usage, uint32_t count)
+{
+    heatmap_t *hm = lv_obj_get_user_data(heatmap);
+    uint32_t core;
+    uint16_t color;
+
+    if (hm == NULL || count == 0) {
+        return;
+    }
+
+    if (count > hm->cores && resize(heatmap, hm, count) != 0) {
+        return;
+    }
+
+    /* Overwrite the column under the cursor, the rest of the buffer is not touched */
+    for (core = 0; core < hm->cores; core++) {
+        color = palette[core < count && usage[core] <= 100 ? usage[core] : 0];
+        fill_column(hm, hm->head, core * hm->row_height, (core + 1) * hm->row_height, color);
+    }
+    invalidate_column(heatmap, hm->head);
+
+    hm->head = (hm->head + 1) % hm->columns;
+
+    /* The cursor covers the oldest column, the next one to be written */
+    if (hm->columns > 1) {
+        fill_column(hm, hm->head, 0, hm->cores * hm->row_height, cursor_color);
+        invalidate_column(heatmap, hm->head);
+    }
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Build the color scale, blue - green - yellow - red
+ */
+static void init_palette(void)
+{
+    static const uint32_t stops[] = {0x1A237E, 0x2E7D32, 0xFDD835, 0xD32F2F};
+    uint32_t i;
+    uint32_t seg;
+    uint32_t pos;
+
+    for (i = 0; i <= 100; i++) {
+        seg = i * 3 / 101;
+        pos = i * 3 - seg * 101;
+
+        /* lv_color_mix returns the first color at 255 */
+        palette[i] = lv_color_to_u16(lv_color_mix(lv_color_hex(stops[seg + 1]), lv_color_hex(stops[seg]),
+                                                  (uint8_t)(pos * 255 / 100)));
+    }
+
+    cursor_color = lv_color_to_u16(lv_color_hex(HEATMAP_CURSOR_COLOR));
+    palette_ready = true;
+}
+
+/**
+ * Lay the buffer out for a number of cores, the history is lost
+ */
+static int resize(lv_obj_t *obj, heatmap_t *hm, uint32_t cores)
+{
+    lv_draw_buf_t *buf;
+    mem_tag_t tag;
+    uint32_t row_height = hm->height / cores;
+    uint32_t width = hm->columns * HEATMAP_COLUMN_WIDTH;
+    uint32_t y;
+    uint32_t x;
+    uint16_t *row;
+
+    if (row_height < HEATMAP_MIN_ROW_HEIGHT) {
+        row_height = HEATMAP_MIN_ROW_HEIGHT;
+    } else if (row_height > HEATMAP_MAX_ROW_HEIGHT) {
+        row_height = HEATMAP_MAX_ROW_HEIGHT;
+    }
+
+    /* The history of the samples, not a rendering buffer */
+    tag = mem_tag_set(MEM_TAG_HISTORY);
+    buf = lv_draw_buf_create(width, row_height * cores, LV_COLOR_FORMAT_RGB565, LV_STRIDE_AUTO);
+    mem_tag_set(tag);
+    if (buf == NULL) {
+        return -1;
+    }
+
+    for (y = 0; y < row_height * cores; y++) {
+        row = (uint16_t *)(buf->data + y * buf->header.stride);
+        for (x = 0; x < width; x++) {
+            row[x] = palette[0];
+        }
+    }
+
+    if (hm->buf != NULL) {
+        lv_draw_buf_destroy(hm->buf);
+    }
+
+    hm->buf = buf;
+    hm->head = 0;
+    hm->cores = cores;
+    hm->row_height = row_height;
+
+    set_image(hm);
+
+    lv_obj_set_size(obj, (int32_t)width, (int32_t)(row_height * cores));
+    lv_obj_invalidate(obj);
+    return 0;
+}
+
+/**
+ * Paint a column of the buffer
+ * @param hm the heatmap
+ * @param column the column
+ * @param y1 the first row
+ * @param y2 the row after the last one
+ * @param color the RGB565 color
+ */
+static void fill_column(heatmap_t *hm, uint32_t column, uint32_t y1, uint32_t y2, uint16_t color)
+{
+    uint32_t stride = hm->buf->header.stride;
+    uint32_t y;
+    uint32_t x;
+    uint16_t *row;
+
+    for (y = y1; y < y2; y++) {
+        row = (uint16_t *)(hm->buf->data + y * stride);
+        for (x = column * HEATMAP_COLUMN_WIDTH; x < (column + 1) * HEATMAP_COLUMN_WIDTH; x++) {
+            row[x] = color;
+        }
+    }
+}
+
+/**
+ * Redraw only the area of a column
+ */
+static void invalidate_column(lv_obj_t *obj, uint32_t column)
+{
+    lv_area_t area;
+
+    lv_obj_get_coords(obj, &area);
+    area.x1 += (int32_t)(column * HEATMAP_COLUMN_WIDTH);
+    area.x2 = area.x1 + HEATMAP_COLUMN_WIDTH - 1;
+    lv_obj_invalidate_area(obj, &area);
+}
+
+/**
+ * Describe the buffer as an image
+ */
+static void set_image(heatmap_t *hm)
+{
+    /* The decoder may have cached the previous buffer */
+    lv_image_cache_drop(&hm->image);
+
+    memset(&hm->image, 0, sizeof(hm->image));
+    hm->image.header.magic = LV_IMAGE_HEADER_MAGIC;
+    hm->image.header.cf = LV_COLOR_FORMAT_RGB565;
+    hm->image.header.w = hm->buf->header.w;
+    hm->image.header.h = hm->buf->header.h;
+    hm->image.header.stride = hm->buf->header.stride;
+    hm->image.data = hm->buf->data;
+    hm->image.data_size = hm->buf->data_size;
+}
+
+/**
+ * Draw the buffer unshifted, the columns stay in place
+ */
+static void draw_cb(lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_target(e);
+    heatmap_t *hm = lv_obj_get_user_data(obj);
+    lv_layer_t *layer = lv_event_get_layer(e);
+    lv_draw_image_dsc_t dsc;
+    lv_area_t area;
+
+    if (hm == NULL || hm->buf == NULL) {
+        return;
+    }
+
+    lv_obj_get_coords(obj, &area);
+    area.x2 = area.x1 + (int32_t)hm->image.header.w - 1;
+    area.y2 = area.y1 + (int32_t)hm->image.header.h - 1;
+
+    lv_draw_image_dsc_init(&dsc);
+    dsc.src = &hm->image;
+    lv_draw_image(layer, &dsc, &area);
+}
+
+static void delete_cb(lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_target(e);
+    heatmap_t *hm = lv_obj_get_user_data(obj);
+
+    if (hm == NULL) {
+        return;
+    }
+
+    if (hm->buf != NULL) {
+        lv_draw_buf_destroy(hm->buf);
+    }
+
+    lv_free(hm);
+    lv_obj_set_user_data(obj, NULL);
+}
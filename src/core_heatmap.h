@@ -0,0 +1,64 @@
+/**
+ * @file core_heatmap.h
+ *
+ * Per-core CPU usage heatmap, cores on the Y axis and time on the X axis
+ *
+ * The pixels are written straight into a buffer used as a ring of columns
+ * and the buffer is drawn as it is, like a sweep display: every sample color
+ * maps the column at the write position and blanks the next one as a cursor
+ * separating the newest samples from the oldest. Nothing moves on the screen,
+ * only these two columns are redrawn, so the cost of a sample does not depend
+ * on the length of the history shown.
+ */
+
+#ifndef CORE_HEATMAP_H
+#define CORE_HEATMAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Create a heatmap
+ * @param parent the parent object
+ * @param columns the number of samples shown
+ * @param height the height of the heatmap in pixels, shared by the cores
+ * @return the heatmap object
+ */
+lv_obj_t *core_heatmap_create(lv_obj_t *parent, uint32_t columns, uint32_t height);
+
+/**
+ * Add a sample at the write position, left of the cursor
+ * @description the buffer is resized when cores come online
+ * @param heatmap the heatmap
+ * @param usage the usage of each core in percent
+ * @param count the number of cores
+ */
+void core_heatmap_push(lv_obj_t *heatmap, const uint8_t *usage, uint32_t count);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*CORE_HEATMAP_H*/
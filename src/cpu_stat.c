@@ -0,0 +1,139 @@
+/**
+ * @file cpu_stat.c
+ *
+ * System and per-core CPU usage from /proc/stat
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <string.h>
+
+#include "cpu_stat.h"
+#include "procfs_parse.h"
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void compute_usage(const uint64_t *restrict total, const uint64_t *restrict idle,
+                          const uint64_t *restrict prev_total, const uint64_t *restrict prev_idle,
+                          uint8_t *restrict usage, uint32_t count);
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void cpu_stat_init(cpu_stat_t *stat)
+{
+    memset(stat, 0, sizeof(*stat));
+}
+
+int cpu_stat_update(cpu_stat_t *stat, const char *buf, size_t len, uint8_t *core_usage)
+{
+    cpu_stat_counters_t *cur = &stat->counters[stat->prev ^ 1];
+    const cpu_stat_counters_t *prev = &stat->counters[stat->prev];
+    procfs_view_t text = procfs_view(buf, len);
+    procfs_view_t line;
+    procfs_view_t name;
+    procfs_cpu_times_t times;
+    uint64_t total_diff;
+    uint64_t idle_diff;
+    uint64_t core;
+    uint32_t core_count = 0;
+
+    /* The aggregated line comes first */
+    if (!procfs_next_line(&text, &line) || !procfs_parse_cpu_line(line, &times)) {
+        return -1;
+    }
+
+    cur->all_total = procfs_cpu_total(&times);
+    cur->all_idle = procfs_cpu_idle(&times);
+
+    /* Offline cores have no line, they must read as 0 */
+    memset(cur->total, 0, sizeof(cur->total[0]) * stat->core_count);
+    memset(cur->idle, 0, sizeof(cur->idle[0]) * stat->core_count);
+
+    /* Then one line per online core, the other lines follow */
+    while (procfs_next_line(&text, &line)) {
+
+        if (!procfs_parse_cpu_line(line, &times)) {
+            break;
+        }
+
+        name = line;
+        name.ptr += 3;
+        name.len -= 3;
+        core = procfs_parse_u64(&name);
+        if (core >= CPU_STAT_MAX_CORES) {
+            continue;
+        }
+
+        cur->total[core] = procfs_cpu_total(&times);
+        cur->idle[core] = procfs_cpu_idle(&times);
+
+        if (core >= core_count) {
+            core_count = (uint32_t)core + 1;
+        }
+    }
+
+    /* A core that came online reports its usage since boot, like the first call */
+    if (core_count > stat->core_count) {
+        memset(&stat->counters[stat->prev].total[stat->core_count], 0,
+               sizeof(cur->total[0]) * (core_count - stat->core_count));
+        memset(&stat->counters[stat->prev].idle[stat->core_count], 0,
+               sizeof(cur->idle[0]) * (core_count - stat->core_count));
+    }
+
+    compute_usage(cur->total, cur->idle, prev->total, prev->idle, core_usage, core_count);
+    memset(&core_usage[core_count], 0, CPU_STAT_MAX_CORES - core_count);
+
+    total_diff = cur->all_total - prev->all_total;
+    idle_diff = cur->all_idle - prev->all_idle;
+
+    stat->core_count = core_count;
+    stat->prev ^= 1;
+
+    if (total_diff == 0) {
+        return 0;
+    }
+
+    if (idle_diff > total_diff) {
+        idle_diff = total_diff;
+    }
+
+    return (int)((total_diff - idle_diff) * 100 / total_diff);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Usage of every core in percent
+ * @description no branch and no aliasing in the loop body so the compiler
+ * can vectorize it, the checks are masks. The deltas of one tick fit in 32 bits.
+ */
+static void compute_usage(const uint64_t *restrict total, const uint64_t *restrict idle,
+                          const uint64_t *restrict prev_total, const uint64_t *restrict prev_idle,
+                          uint8_t *restrict usage, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        uint64_t total_delta = total[i] - prev_total[i];
+        uint64_t idle_delta = idle[i] - prev_idle[i];
+
+        /* An offline core has no line and reads 0, a counter that went
+         * backwards has the top bit of its delta set and counts as 0 */
+        uint32_t total_diff = (uint32_t)total_delta & ((uint32_t)(total_delta >> 63) - 1);
+        uint32_t idle_diff = (uint32_t)idle_delta & ((uint32_t)(idle_delta >> 63) - 1);
+
+        /* iowait is not monotonic, idle may grow more than total */
+        idle_diff = idle_diff < total_diff ? idle_diff : total_diff;
+
+        float busy = (float)(total_diff - idle_diff);
+        float span = (float)(total_diff | (total_diff == 0));
+
+        usage[i] = (uint8_t)(busy * 100.0f / span);
+    }
+}
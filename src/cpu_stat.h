@@ -0,0 +1,79 @@
+/**
+ * @file cpu_stat.h
+ *
+ * System and per-core CPU usage from /proc/stat
+ *
+ * The counters of every cpuN line are stored as a struct of arrays, the
+ * usage of all the cores is then computed by a single loop over contiguous
+ * arrays that the compiler can vectorize. Two sets of arrays are used
+ * alternately, the previous tick is never copied.
+ */
+
+#ifndef CPU_STAT_H
+#define CPU_STAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stddef.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Highest number of cores tracked, the cores beyond are ignored */
+#define CPU_STAT_MAX_CORES  128
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    uint64_t total[CPU_STAT_MAX_CORES];
+    uint64_t idle[CPU_STAT_MAX_CORES];
+    uint64_t all_total;                 /* the aggregated cpu line */
+    uint64_t all_idle;
+} cpu_stat_counters_t;
+
+typedef struct {
+    cpu_stat_counters_t counters[2];
+    uint32_t prev;                      /* index of the counters of the previous tick */
+    uint32_t core_count;                /* highest core number + 1 */
+} cpu_stat_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Initialize the CPU usage state
+ * @param stat the state
+ */
+void cpu_stat_init(cpu_stat_t *stat);
+
+/**
+ * Parse the cpu lines of /proc/stat and compute the usage since the previous call
+ * @description the first call reports the usage since boot. Offline cores
+ * have no line and report 0.
+ * @param stat the state
+ * @param buf the content of /proc/stat
+ * @param len the length of the content
+ * @param core_usage the usage of each core in percent, CPU_STAT_MAX_CORES entries
+ * @return the usage of the whole system in percent, -1 if the content can not be parsed
+ */
+int cpu_stat_update(cpu_stat_t *stat, const char *buf, size_t len, uint8_t *core_usage);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*CPU_STAT_H*/
@@ -23,28 +23,79 @@ extern "C" {
  *      DEFINES
  *********************/
 
+/* Maximum number of fds a backend can ask the scheduler to watch */
+#define BACKEND_MAX_FDS 32
+
 /**********************
  *      TYPEDEFS
  **********************/
 /* Prototype of the display initialization functions */
 typedef lv_display_t *(*display_init_t)(void);
 
-/* Prototype of the run loop */
-typedef void (*run_loop_t)(void);
+/* A file descriptor watched by the scheduler */
+typedef struct {
+    int fd;
+    bool edge;                   /* Only wake up when new data arrives, it is consumed later by the driver */
+} backend_fd_t;
+
+/* Prototype of the function returning the fds to watch, returns the number of fds */
+typedef int (*get_fds_t)(backend_fd_t *fds, int max);
+
+/* Prototype of the function called when a display fd is readable */
+typedef void (*flush_done_t)(void);
+
+/* Prototype of the timer handler, returns the time until the next call in ms */
+typedef uint32_t (*timer_handler_t)(void);
+
+/* Prototype of the function telling if the display is still open */
+typedef bool (*is_running_t)(void);
 
-/* Represents a display driver handle */
+/* Prototype of the function showing the cursor of a pointer without LVGL, returns false if not supported */
+typedef bool (*set_cursor_t)(lv_indev_t *indev, const lv_image_dsc_t *icon);
+
+/* Prototype of the function telling if the display hardware applies settings.rotation */
+typedef bool (*hw_rotation_t)(void);
+
+/*
+ * A vsync source, notifies the scheduler of the vblanks of the display
+ * The notifications are one shot, they are requested only when
+ * a frame is pending so that an idle display does not wake up
+ */
+typedef struct {
+    int (*open)(lv_display_t *display); /* Returns a fd readable after each requested vblank, -1 if not supported */
+    bool (*request)(void);              /* Requests a notification for the next vblank */
+    bool (*read)(uint64_t *time_us);    /* Consumes the notification, returns the CLOCK_MONOTONIC time of the vblank */
+    void (*close)(void);
+} vsync_source_t;
+
+/*
+ * Represents a display driver handle
+ * All the hooks except init_display are optional, they are
+ * called by the scheduler - see driver_backends_run_loop()
+ */
 typedef struct {
     display_init_t init_display; /* The display creation/initialization function */
-    run_loop_t run_loop;         /* The run loop of the driver handle */
+    get_fds_t get_fds;           /* The fds of the display connection or device */
+    flush_done_t flush_done;     /* Completes the pending flushes when one of the fds is readable */
+    timer_handler_t timer_handler; /* Replaces lv_timer_handler() */
+    is_running_t is_running;     /* The run loop stops once it returns false */
+    const vsync_source_t *vsync; /* Paces the rendering on the vblanks */
+    set_cursor_t set_cursor;     /* Shows the mouse cursor with a hardware plane */
+    hw_rotation_t hw_rotation;   /* Skips the software rotation of LVGL when it returns true */
     lv_display_t *display;       /* The LVGL display that was created */
 } display_backend_t;
 
 /* Prototype for the initialization of an indev driver backend */
 typedef lv_indev_t *(*indev_init_t)(lv_display_t *display);
 
-/* Represents an indev driver backend */
+/*
+ * Represents an indev driver backend
+ * The input devices of a backend providing get_fds are switched
+ * to event mode, they are read only when one of the fds is readable
+ */
 typedef struct {
     indev_init_t init_indev;
+    get_fds_t get_fds;           /* The fds of the input devices, optional */
 } indev_backend_t;
 
 /* Regroup all different types of driver backend */
@@ -80,6 +131,7 @@ int backend_init_sdl(backend_t *backend);
 int backend_init_glfw3(backend_t *backend);
 int backend_init_wayland(backend_t *backend);
 int backend_init_x11(backend_t *backend);
+int backend_init_headless(backend_t *backend);
 
 /* Input device driver backends */
 int backend_init_evdev(backend_t *backend);
@@ -0,0 +1,192 @@
+/**
+ * @file cpu_affinity.c
+ *
+ * Thread placement on the cores of heterogeneous CPUs
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "simulator_util.h"
+#include "cpu_affinity.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    int cpu;
+    uint64_t capacity;                  /* cpu_capacity or the highest frequency in kHz */
+} core_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void detect_cores(void);
+static uint64_t read_capacity(int cpu);
+static bool read_u64(const char *path, uint64_t *value);
+static int compare_cores(const void *a, const void *b);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+
+/* Sorted by decreasing capacity, the performance cores come first */
+static core_t cores[CPU_SETSIZE];
+static uint32_t core_count;
+static uint32_t performance_count;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+uint32_t cpu_affinity_count(cpu_affinity_class_t cls)
+{
+    pthread_once(&detect_once, detect_cores);
+
+    return cls == CPU_AFFINITY_PERFORMANCE ? performance_count : core_count - performance_count;
+}
+
+uint32_t cpu_affinity_pin(cpu_affinity_class_t cls, uint32_t max)
+{
+    cpu_set_t set;
+    uint32_t first;
+    uint32_t count;
+    uint32_t i;
+
+    pthread_once(&detect_once, detect_cores);
+
+    if (strcmp(getenv_default("LV_SIM_AFFINITY", "1"), "0") == 0) {
+        return 0;
+    }
+
+    first = cls == CPU_AFFINITY_PERFORMANCE ? 0 : performance_count;
+    count = cpu_affinity_count(cls);
+    if (max != 0 && max < count) {
+        count = max;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    CPU_ZERO(&set);
+    for (i = first; i < first + count; i++) {
+        CPU_SET(cores[i].cpu, &set);
+    }
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        return 0;
+    }
+
+    return count;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Rank the cores the process may run on
+ * @description runs once, before any thread of the process is pinned
+ */
+static void detect_cores(void)
+{
+    cpu_set_t allowed;
+    int cpu;
+
+    core_count = 0;
+    performance_count = 0;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return;
+    }
+
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            cores[core_count].cpu = cpu;
+            cores[core_count].capacity = read_capacity(cpu);
+            core_count++;
+        }
+    }
+
+    qsort(cores, core_count, sizeof(cores[0]), compare_cores);
+
+    while (performance_count < core_count && cores[performance_count].capacity == cores[0].capacity) {
+        performance_count++;
+    }
+}
+
+/**
+ * Read the capacity of a core
+ * @return the capacity, the highest frequency without it, 0 if unknown
+ */
+static uint64_t read_capacity(int cpu)
+{
+    char path[96];
+    uint64_t value;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+    if (read_u64(path, &value)) {
+        return value;
+    }
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+    if (read_u64(path, &value)) {
+        return value;
+    }
+
+    return 0;
+}
+
+static bool read_u64(const char *path, uint64_t *value)
+{
+    unsigned long long v;
+    FILE *f;
+    bool ok;
+
+    f = fopen(path, "re");
+    if (f == NULL) {
+        return false;
+    }
+
+    ok = fscanf(f, "%llu", &v) == 1;
+    fclose(f);
+
+    if (ok) {
+        *value = v;
+    }
+    return ok;
+}
+
+/**
+ * Decreasing capacity, then increasing core number
+ */
+static int compare_cores(const void *a, const void *b)
+{
+    const core_t *x = a;
+    const core_t *y = b;
+
+    if (x->capacity != y->capacity) {
+        return x->capacity > y->capacity ? -1 : 1;
+    }
+
+    return x->cpu - y->cpu;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file cpu_affinity.h
+ *
+ * Thread placement on the cores of heterogeneous CPUs
+ *
+ * The cores are ranked by the capacity the kernel reports in
+ * /sys/devices/system/cpu/cpuN/cpu_capacity, or by their highest cpufreq
+ * frequency when the capacity is not exposed. The cores of the highest
+ * capacity are the performance cores, the others the efficiency cores.
+ *
+ * Threads inherit the affinity of the thread creating them, pinning the
+ * main thread before lv_init() also pins the LVGL draw threads.
+ * Set LV_SIM_AFFINITY=0 to leave the placement to the scheduler.
+ */
+
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef enum {
+    CPU_AFFINITY_PERFORMANCE,           /* the cores of the highest capacity */
+    CPU_AFFINITY_EFFICIENCY,            /* the other cores */
+} cpu_affinity_class_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Count the cores of a class
+ * @description the cores are detected on the first call, only the cores
+ * the process is allowed to run on are counted
+ * @param cls the class
+ * @return the number of cores, the efficiency class is empty on CPUs with
+ * identical cores
+ */
+uint32_t cpu_affinity_count(cpu_affinity_class_t cls);
+
+/**
+ * Pin the calling thread to the cores of a class
+ * @description the fastest cores of the class are picked first
+ * @param cls the class
+ * @param max the highest number of cores, 0 for all the cores of the class
+ * @return the number of cores the thread is pinned to, 0 if it was left
+ * alone (disabled, empty class or failure)
+ */
+uint32_t cpu_affinity_pin(cpu_affinity_class_t cls, uint32_t max);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*CPU_AFFINITY_H*/
@@ -0,0 +1,147 @@
+/**
+ * @file damage.c
+ *
+ * Damage tracking for displays with several full frame buffers
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <string.h>
+
+#include "damage.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static bool try_merge(lv_area_t *dst, const lv_area_t *area);
+static uint64_t area_size(const lv_area_t *area);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void damage_add(damage_t *damage, const lv_area_t *area)
+{
+    uint32_t i;
+
+    if (damage->full) {
+        return;
+    }
+
+    for (i = 0; i < damage->count; i++) {
+        if (try_merge(&damage->areas[i], area)) {
+            return;
+        }
+    }
+
+    if (damage->count == DAMAGE_MAX_AREAS) {
+        damage->full = true;
+        damage->count = 0;
+        return;
+    }
+
+    damage->areas[damage->count++] = *area;
+}
+
+void damage_tracker_init(damage_tracker_t *tracker, uint32_t buf_count, uint32_t height)
+{
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->buf_count = buf_count < DAMAGE_MAX_BUFFERS ? buf_count : DAMAGE_MAX_BUFFERS;
+    tracker->height = height;
+}
+
+void damage_tracker_add(damage_tracker_t *tracker, uint32_t rendered, const lv_area_t *area)
+{
+    uint32_t i;
+
+    for (i = 0; i < tracker->buf_count; i++) {
+        if (i != rendered) {
+            damage_add(&tracker->stale[i], area);
+        }
+    }
+}
+
+uint32_t damage_tracker_sync(damage_tracker_t *tracker, uint32_t idx, uint8_t *dst, const uint8_t *src,
+                             uint32_t stride, uint32_t px_size)
+{
+    damage_t *stale = &tracker->stale[idx];
+    const lv_area_t *a;
+    uint32_t copied = 0;
+    uint32_t offset;
+    uint32_t len;
+    uint32_t i;
+    int32_t y;
+
+    if (stale->full) {
+        copied = stride * tracker->height;
+        memcpy(dst, src, copied);
+    } else {
+        for (i = 0; i < stale->count; i++) {
+            a = &stale->areas[i];
+            len = (uint32_t)(a->x2 - a->x1 + 1) * px_size;
+
+            for (y = a->y1; y <= a->y2; y++) {
+                offset = (uint32_t)y * stride + (uint32_t)a->x1 * px_size;
+                memcpy(dst + offset, src + offset, len);
+            }
+
+            copied += len * (uint32_t)(a->y2 - a->y1 + 1);
+        }
+    }
+
+    stale->count = 0;
+    stale->full = false;
+    return copied;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Merge an area into another if they overlap or touch and the union does
+ * not cover more pixels than the two areas
+ */
+static bool try_merge(lv_area_t *dst, const lv_area_t *area)
+{
+    lv_area_t u;
+
+    if (area->x1 > dst->x2 + 1 || area->x2 + 1 < dst->x1 ||
+        area->y1 > dst->y2 + 1 || area->y2 + 1 < dst->y1) {
+        return false;
+    }
+
+    u.x1 = area->x1 < dst->x1 ? area->x1 : dst->x1;
+    u.y1 = area->y1 < dst->y1 ? area->y1 : dst->y1;
+    u.x2 = area->x2 > dst->x2 ? area->x2 : dst->x2;
+    u.y2 = area->y2 > dst->y2 ? area->y2 : dst->y2;
+
+    if (area_size(&u) > area_size(dst) + area_size(area)) {
+        return false;
+    }
+
+    *dst = u;
+    return true;
+}
+
+static uint64_t area_size(const lv_area_t *area)
+{
+    return (uint64_t)(area->x2 - area->x1 + 1) * (uint64_t)(area->y2 - area->y1 + 1);
+}
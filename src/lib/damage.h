@@ -0,0 +1,105 @@
+/**
+ * @file damage.h
+ *
+ * Damage tracking for displays with several full frame buffers
+ *
+ * A buffer rendered in LV_DISPLAY_RENDER_MODE_DIRECT only receives the
+ * areas invalidated during its frame. Before it is rendered again, the
+ * areas drawn into the other buffers in the meantime have to be copied
+ * back into it from the buffer holding the latest frame.
+ */
+
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Areas kept per buffer, the whole buffer is copied beyond */
+#define DAMAGE_MAX_AREAS    16
+
+#define DAMAGE_MAX_BUFFERS  3
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* A set of areas */
+typedef struct {
+    lv_area_t areas[DAMAGE_MAX_AREAS];
+    uint32_t count;
+    bool full;                          /* too many areas, covers the whole buffer */
+} damage_t;
+
+/* The areas each buffer missed since it was last rendered */
+typedef struct {
+    damage_t stale[DAMAGE_MAX_BUFFERS];
+    uint32_t buf_count;
+    uint32_t height;                    /* rows of a buffer, for the full copies */
+} damage_tracker_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Add an area to a set
+ * @description the area is merged with an area it overlaps or touches
+ * when the union is not larger than the two areas
+ * @param damage the set
+ * @param area the area to add
+ */
+void damage_add(damage_t *damage, const lv_area_t *area);
+
+/**
+ * Initialize a tracker
+ * @param tracker the tracker
+ * @param buf_count the number of buffers, at most DAMAGE_MAX_BUFFERS
+ * @param height the number of rows of the buffers
+ */
+void damage_tracker_init(damage_tracker_t *tracker, uint32_t buf_count, uint32_t height);
+
+/**
+ * Record an area rendered into a buffer
+ * @description the area becomes stale in all the other buffers
+ * @param tracker the tracker
+ * @param rendered the index of the buffer the area was rendered into
+ * @param area the area
+ */
+void damage_tracker_add(damage_tracker_t *tracker, uint32_t rendered, const lv_area_t *area);
+
+/**
+ * Bring a buffer up to date before rendering into it
+ * @param tracker the tracker
+ * @param idx the index of the buffer to update
+ * @param dst the pixels of the buffer to update
+ * @param src the pixels of the buffer holding the latest frame
+ * @param stride the number of bytes per row of both buffers
+ * @param px_size the number of bytes per pixel
+ * @return the number of bytes copied
+ */
+uint32_t damage_tracker_sync(damage_tracker_t *tracker, uint32_t idx, uint8_t *dst, const uint8_t *src,
+                             uint32_t stride, uint32_t px_size);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*DAMAGE_H*/
@@ -19,12 +19,19 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
 
 #include "lvgl/lvgl.h"
 #if LV_USE_LINUX_DRM
+#include <xf86drm.h>
+#include <xf86drmMode.h>
 #include "../simulator_util.h"
 #include "../simulator_settings.h"
 #include "../backends.h"
+#include "../drm_atomic.h"
+#include "../drm_cursor.h"
 
 /*********************
  *      DEFINES
@@ -37,8 +44,18 @@
 /**********************
  *  STATIC PROTOTYPES
  **********************/
-static void run_loop_drm(void);
 static lv_display_t *init_drm(void);
+static int get_fds_drm(backend_fd_t *fds, int max);
+static void flush_done_drm(void);
+static int vsync_open_drm(lv_display_t *display);
+static bool vsync_request_drm(void);
+static bool vsync_read_drm(uint64_t *time_us);
+static void vsync_close_drm(void);
+static uint32_t vblank_pipe_flags(int fd);
+static bool set_cursor_drm(lv_indev_t *indev, const lv_image_dsc_t *icon);
+static bool hw_rotation_drm(void);
+static void vblank_handler(int fd, unsigned int sequence, unsigned int tv_sec,
+                           unsigned int tv_usec, void *user_data);
 
 
 /**********************
@@ -46,6 +63,23 @@ static lv_display_t *init_drm(void);
  **********************/
 static char *backend_name = "DRM";
 
+extern simulator_settings_t settings;
+
+/* The vblank events are requested on a fd of our own, so
+ * that they are not mixed with the page flip events of the driver */
+static const vsync_source_t vsync_drm = {
+    .open = vsync_open_drm,
+    .request = vsync_request_drm,
+    .read = vsync_read_drm,
+    .close = vsync_close_drm,
+};
+
+static int vsync_fd = -1;
+static uint32_t vsync_pipe;
+static bool use_atomic;
+static bool vblank_received;
+static uint64_t vblank_time_us;
+
 /**********************
  *      MACROS
  **********************/
@@ -64,11 +98,15 @@ int backend_init_drm(backend_t *backend)
 {
     LV_ASSERT_NULL(backend);
 
-    backend->handle->display = malloc(sizeof(display_backend_t));
+    backend->handle->display = calloc(1, sizeof(display_backend_t));
     LV_ASSERT_NULL(backend->handle->display);
 
     backend->handle->display->init_display = init_drm;
-    backend->handle->display->run_loop = run_loop_drm;
+    backend->handle->display->get_fds = get_fds_drm;
+    backend->handle->display->flush_done = flush_done_drm;
+    backend->handle->display->vsync = &vsync_drm;
+    backend->handle->display->set_cursor = set_cursor_drm;
+    backend->handle->display->hw_rotation = hw_rotation_drm;
     backend->name = backend_name;
     backend->type = BACKEND_DISPLAY;
 
@@ -87,7 +125,15 @@ int backend_init_drm(backend_t *backend)
 static lv_display_t *init_drm(void)
 {
     const char *device = getenv_default("LV_LINUX_DRM_CARD", "/dev/dri/card0");
-    lv_display_t * disp = lv_linux_drm_create();
+    lv_display_t * disp;
+
+    use_atomic = strcmp(getenv_default("LV_LINUX_DRM_ATOMIC", "0"), "1") == 0;
+    if (use_atomic) {
+        return drm_atomic_create(device, strcmp(getenv_default("LV_LINUX_DRM_XRGB8888", "0"), "1") == 0,
+                                 settings.rotation);
+    }
+
+    disp = lv_linux_drm_create();
 
     if (disp == NULL) {
         return NULL;
@@ -98,20 +144,214 @@ static lv_display_t *init_drm(void)
     return disp;
 }
 
+/**
+ * Get the fd of the DRM device
+ *
+ * @note the LVGL driver does not expose it, the page flip events
+ * are consumed by the driver itself, only wake up when one arrives.
+ * In atomic mode they are read by flush_done_drm
+ */
+static int get_fds_drm(backend_fd_t *fds, int max)
+{
+    int fd;
+
+    if (max < 1) {
+        return 0;
+    }
+
+    if (use_atomic) {
+        fds[0].fd = drm_atomic_get_fd();
+        fds[0].edge = false;
+        return fds[0].fd >= 0 ? 1 : 0;
+    }
+
+    if (find_open_fds("/dev/dri/card", &fd, 1) == 0) {
+        return 0;
+    }
+
+    fds[0].fd = fd;
+    fds[0].edge = true;
+
+    return 1;
+}
 
 /**
- * The run loop of the DRM driver
+ * Complete the page flips of the atomic mode
  */
-static void run_loop_drm(void)
+static void flush_done_drm(void)
 {
-    uint32_t idle_time;
+    if (use_atomic) {
+        drm_atomic_handle_events();
+    }
+}
+
+/**
+ * Open the vsync source
+ *
+ * @note the vblanks are the ones of the CRTC driving the display, the
+ * first active one when the CRTC of the LVGL driver is not known
+ * @return the fd the vblank events are read from, -1 if not supported
+ */
+static int vsync_open_drm(lv_display_t *display)
+{
+    const char *device = getenv_default("LV_LINUX_DRM_CARD", "/dev/dri/card0");
+    drmVBlank vbl;
+
+    LV_UNUSED(display);
+
+    vsync_fd = open(device, O_RDWR | O_CLOEXEC | O_NONBLOCK);
+    if (vsync_fd < 0) {
+        return -1;
+    }
+
+    vsync_pipe = vblank_pipe_flags(vsync_fd);
+
+    /* Query the current vblank to check that the CRTC has interrupts */
+    memset(&vbl, 0, sizeof(vbl));
+    vbl.request.type = DRM_VBLANK_RELATIVE | vsync_pipe;
+    vbl.request.sequence = 0;
+
+    if (drmWaitVBlank(vsync_fd, &vbl) != 0) {
+        LV_LOG_WARN("%s does not report vblanks", device);
+        close(vsync_fd);
+        vsync_fd = -1;
+    }
+
+    return vsync_fd;
+}
+
+static bool vsync_request_drm(void)
+{
+    drmVBlank vbl;
+
+    memset(&vbl, 0, sizeof(vbl));
+    vbl.request.type = DRM_VBLANK_RELATIVE | DRM_VBLANK_EVENT | vsync_pipe;
+    vbl.request.sequence = 1;
+
+    return drmWaitVBlank(vsync_fd, &vbl) == 0;
+}
+
+static bool vsync_read_drm(uint64_t *time_us)
+{
+    drmEventContext ctx;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.version = 2;
+    ctx.vblank_handler = vblank_handler;
+
+    vblank_received = false;
+    drmHandleEvent(vsync_fd, &ctx);
 
-    /* Handle LVGL tasks */
-    while (true) {
-        /* Returns the time to the next timer execution */
-        idle_time = lv_timer_handler();
-        usleep(idle_time * 1000);
+    if (vblank_received) {
+        *time_us = vblank_time_us;
     }
+
+    return vblank_received;
+}
+
+static void vsync_close_drm(void)
+{
+    close(vsync_fd);
+    vsync_fd = -1;
+}
+
+/**
+ * Get the request flags selecting the pipe of the display
+ *
+ * @description the pipe is the index of the CRTC in the resources of the card,
+ * drmWaitVBlank() targets the first pipe when it is not encoded in the request
+ * @param fd the fd of the card
+ * @return the DRM_VBLANK_SECONDARY or DRM_VBLANK_HIGH_CRTC_MASK bits of the pipe
+ */
+static uint32_t vblank_pipe_flags(int fd)
+{
+    uint32_t crtc_id = use_atomic ? drm_atomic_get_crtc_id() : 0;
+    drmModeRes *res;
+    drmModeCrtc *crtc;
+    int pipe = 0;
+    int i;
+
+    res = drmModeGetResources(fd);
+    if (res == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < res->count_crtcs; i++) {
+        if (crtc_id != 0) {
+            if (res->crtcs[i] == crtc_id) {
+                pipe = i;
+                break;
+            }
+            continue;
+        }
+
+        /* The CRTC of the LVGL driver is the one scanning out */
+        crtc = drmModeGetCrtc(fd, res->crtcs[i]);
+        if (crtc != NULL && crtc->mode_valid && crtc->buffer_id != 0) {
+            pipe = i;
+            drmModeFreeCrtc(crtc);
+            break;
+        }
+        drmModeFreeCrtc(crtc);
+    }
+
+    drmModeFreeResources(res);
+
+    if (pipe == 1) {
+        return DRM_VBLANK_SECONDARY;
+    }
+
+    return ((uint32_t)pipe << DRM_VBLANK_HIGH_CRTC_SHIFT) & DRM_VBLANK_HIGH_CRTC_MASK;
+}
+
+/**
+ * Show the mouse cursor on the cursor plane
+ *
+ * @note the cursor ioctls need the DRM master, the fd of the
+ * driver is used. Disabled with LV_LINUX_DRM_HW_CURSOR=0
+ */
+static bool set_cursor_drm(lv_indev_t *indev, const lv_image_dsc_t *icon)
+{
+    int fd;
+
+    if (strcmp(getenv_default("LV_LINUX_DRM_HW_CURSOR", "1"), "0") == 0) {
+        return false;
+    }
+
+    if (use_atomic) {
+        return drm_cursor_attach(drm_atomic_get_fd(), drm_atomic_get_crtc_id(), indev, icon,
+                                 hw_rotation_drm() ? settings.rotation : LV_DISPLAY_ROTATION_0);
+    }
+
+    if (find_open_fds("/dev/dri/card", &fd, 1) == 0) {
+        return false;
+    }
+
+    return drm_cursor_attach(fd, 0, indev, icon, LV_DISPLAY_ROTATION_0);
+}
+
+/**
+ * Tell if the plane rotates the display
+ *
+ * @note only the atomic mode asks the plane for a rotation
+ */
+static bool hw_rotation_drm(void)
+{
+    return use_atomic && drm_atomic_has_hw_rotation();
+}
+
+/**
+ * Called by drmHandleEvent, the time of the event is CLOCK_MONOTONIC
+ */
+static void vblank_handler(int fd, unsigned int sequence, unsigned int tv_sec,
+                           unsigned int tv_usec, void *user_data)
+{
+    LV_UNUSED(fd);
+    LV_UNUSED(sequence);
+    LV_UNUSED(user_data);
+
+    vblank_time_us = (uint64_t)tv_sec * 1000000u + tv_usec;
+    vblank_received = true;
 }
 
 #endif /*#if LV_USE_LINUX_DRM*/
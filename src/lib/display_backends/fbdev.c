@@ -18,11 +18,20 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <linux/fb.h>
 
 #include "lvgl/lvgl.h"
 #if LV_USE_LINUX_FBDEV
 #include "../simulator_util.h"
 #include "../backends.h"
+#include "../fbdev_pan.h"
 
 /*********************
  *      DEFINES
@@ -37,7 +46,11 @@
  **********************/
 
 static lv_display_t *init_fbdev(void);
-static void run_loop_fbdev(void);
+static int vsync_open_fbdev(lv_display_t *display);
+static bool vsync_request_fbdev(void);
+static bool vsync_read_fbdev(uint64_t *time_us);
+static void vsync_close_fbdev(void);
+static void *vsync_thread_fbdev(void *arg);
 
 /**********************
  *  STATIC VARIABLES
@@ -45,6 +58,22 @@ static void run_loop_fbdev(void);
 
 static char *backend_name = "FBDEV";
 
+/* FBIO_WAITFORVSYNC blocks, it is called from a thread which
+ * notifies the scheduler through an eventfd */
+static const vsync_source_t vsync_fbdev = {
+    .open = vsync_open_fbdev,
+    .request = vsync_request_fbdev,
+    .read = vsync_read_fbdev,
+    .close = vsync_close_fbdev,
+};
+
+static int vsync_fb_fd = -1;
+static int vsync_request_fd = -1;      /* wakes up the thread */
+static int vsync_event_fd = -1;        /* readable after a vblank */
+static pthread_t vsync_thread;
+static bool vsync_stop;
+static uint64_t vblank_time_us;
+
 /**********************
  *      MACROS
  **********************/
@@ -63,11 +92,11 @@ int backend_init_fbdev(backend_t *backend)
 {
     LV_ASSERT_NULL(backend);
 
-    backend->handle->display = malloc(sizeof(display_backend_t));
+    backend->handle->display = calloc(1, sizeof(display_backend_t));
     LV_ASSERT_NULL(backend->handle->display);
 
     backend->handle->display->init_display = init_fbdev;
-    backend->handle->display->run_loop = run_loop_fbdev;
+    backend->handle->display->vsync = &vsync_fbdev;
     backend->name = backend_name;
     backend->type = BACKEND_DISPLAY;
 
@@ -86,7 +115,17 @@ int backend_init_fbdev(backend_t *backend)
 static lv_display_t *init_fbdev(void)
 {
     const char *device = getenv_default("LV_LINUX_FBDEV_DEVICE", "/dev/fb0");
-    lv_display_t *disp = lv_linux_fbdev_create();
+    lv_display_t *disp;
+
+    if (strcmp(getenv_default("LV_LINUX_FBDEV_PAN", "0"), "1") == 0) {
+        disp = fbdev_pan_create(device);
+        if (disp != NULL) {
+            return disp;
+        }
+        LV_LOG_WARN("Falling back to the LVGL fbdev driver");
+    }
+
+    disp = lv_linux_fbdev_create();
 
     if (disp == NULL) {
         return NULL;
@@ -98,19 +137,119 @@ static lv_display_t *init_fbdev(void)
 }
 
 /**
- * The run loop of the fbdev driver
+ * Open the vsync source
+ *
+ * @note most fbdev drivers do not implement FBIO_WAITFORVSYNC,
+ * the frames are then rendered by the LVGL refresh timer
+ * @return the fd readable after a vblank, -1 if not supported
+ */
+static int vsync_open_fbdev(lv_display_t *display)
+{
+    const char *device = getenv_default("LV_LINUX_FBDEV_DEVICE", "/dev/fb0");
+    uint32_t crtc = 0;
+
+    LV_UNUSED(display);
+
+    vsync_fb_fd = open(device, O_RDWR | O_CLOEXEC);
+    if (vsync_fb_fd < 0) {
+        return -1;
+    }
+
+    if (ioctl(vsync_fb_fd, FBIO_WAITFORVSYNC, &crtc) != 0) {
+        LV_LOG_WARN("%s does not support FBIO_WAITFORVSYNC", device);
+        goto err_close_fb;
+    }
+
+    vsync_request_fd = eventfd(0, EFD_CLOEXEC);
+    vsync_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (vsync_request_fd < 0 || vsync_event_fd < 0) {
+        goto err_close_events;
+    }
+
+    vsync_stop = false;
+    if (pthread_create(&vsync_thread, NULL, vsync_thread_fbdev, NULL) != 0) {
+        goto err_close_events;
+    }
+
+    return vsync_event_fd;
+
+err_close_events:
+    if (vsync_request_fd >= 0) {
+        close(vsync_request_fd);
+    }
+    if (vsync_event_fd >= 0) {
+        close(vsync_event_fd);
+    }
+    vsync_request_fd = vsync_event_fd = -1;
+
+err_close_fb:
+    close(vsync_fb_fd);
+    vsync_fb_fd = -1;
+    return -1;
+}
+
+static bool vsync_request_fbdev(void)
+{
+    uint64_t one = 1;
+
+    return write(vsync_request_fd, &one, sizeof(one)) == sizeof(one);
+}
+
+static bool vsync_read_fbdev(uint64_t *time_us)
+{
+    uint64_t count;
+
+    if (read(vsync_event_fd, &count, sizeof(count)) != sizeof(count)) {
+        return false;
+    }
+
+    *time_us = __atomic_load_n(&vblank_time_us, __ATOMIC_ACQUIRE);
+    return true;
+}
+
+static void vsync_close_fbdev(void)
+{
+    __atomic_store_n(&vsync_stop, true, __ATOMIC_RELEASE);
+    vsync_request_fbdev();
+    pthread_join(vsync_thread, NULL);
+
+    close(vsync_request_fd);
+    close(vsync_event_fd);
+    close(vsync_fb_fd);
+    vsync_fb_fd = vsync_request_fd = vsync_event_fd = -1;
+}
+
+/**
+ * Wait for a vblank each time one is requested
  */
-static void run_loop_fbdev(void)
+static void *vsync_thread_fbdev(void *arg)
 {
-    uint32_t idle_time;
+    struct timespec ts;
+    uint64_t count;
+    uint64_t one = 1;
+    uint32_t crtc = 0;
 
-    /* Handle LVGL tasks */
-    while (true) {
+    LV_UNUSED(arg);
 
-        /* Returns the time to the next timer execution */
-        idle_time = lv_timer_handler();
-        usleep(idle_time * 1000);
+    while (read(vsync_request_fd, &count, sizeof(count)) == sizeof(count)) {
+
+        if (__atomic_load_n(&vsync_stop, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        /* Notify even if the wait fails, the frame must not be lost */
+        ioctl(vsync_fb_fd, FBIO_WAITFORVSYNC, &crtc);
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        __atomic_store_n(&vblank_time_us, (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u,
+                         __ATOMIC_RELEASE);
+
+        if (write(vsync_event_fd, &one, sizeof(one)) != sizeof(one)) {
+            break;
+        }
     }
+
+    return NULL;
 }
 
 #endif /*LV_USE_LINUX_FBDEV*/
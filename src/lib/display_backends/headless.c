@@ -0,0 +1,500 @@
+/**
+ * @file headless.c
+ *
+ * The headless backend
+ *
+ * Renders into a frame held in RAM, without any display, compositor
+ * or X server. The frames, flushed areas and pixels are counted and
+ * reported on exit, selected frames can be dumped as raw or PNG files.
+ * Gives a repeatable rendering baseline on build servers and in
+ * containers.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "lvgl/lvgl.h"
+#include "../simulator_util.h"
+#include "../simulator_settings.h"
+#include "../backends.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Maximum number of frames listed in LV_SIM_HEADLESS_DUMP */
+#define HEADLESS_MAX_DUMPS  64
+
+/* Maximum size of a stored deflate block */
+#define DEFLATE_BLOCK_MAX   65535u
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef enum {
+    DUMP_PNG,
+    DUMP_RAW,
+} dump_format_t;
+
+typedef struct {
+    lv_display_t *disp;
+    lv_draw_buf_t *buf;                 /* holds the whole frame, rendered in direct mode */
+    uint32_t max_frames;                /* 0 to run until interrupted */
+    uint32_t dumps[HEADLESS_MAX_DUMPS]; /* numbers of the frames to dump, the first one is 1 */
+    uint32_t dump_count;
+    dump_format_t dump_format;
+    const char *dump_dir;
+    uint64_t render_start_us;
+    /* Counters reported on exit */
+    uint32_t frames;
+    uint64_t areas;
+    uint64_t pixels;
+    uint64_t render_us;
+} headless_t;
+
+/* A PNG file being written, the CRC covers the current chunk */
+typedef struct {
+    FILE *f;
+    uint32_t crc;
+} png_writer_t;
+
+/**********************
+ *  EXTERNAL VARIABLES
+ **********************/
+extern simulator_settings_t settings;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static lv_display_t *init_headless(void);
+static bool is_running_headless(void);
+static void parse_dumps(const char *list);
+static bool is_dumped(uint32_t frame);
+static void flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void render_start_cb(lv_event_t *e);
+static void delete_cb(lv_event_t *e);
+static int dump_frame(uint32_t frame);
+static int dump_raw(const char *path);
+static int dump_png(const char *path);
+static bool to_rgb888(uint8_t *dst, const uint8_t *src, uint32_t count, lv_color_format_t cf);
+static void png_write(png_writer_t *png, const void *data, size_t size);
+static void png_write_u32(png_writer_t *png, uint32_t value);
+static void png_chunk_start(png_writer_t *png, const char *type, uint32_t size);
+static void png_chunk_end(png_writer_t *png);
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t size);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static char *backend_name = "HEADLESS";
+
+static headless_t hl;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * Register the backend
+ *
+ * @param backend the backend descriptor
+ * @description configures the descriptor
+ */
+int backend_init_headless(backend_t *backend)
+{
+    LV_ASSERT_NULL(backend);
+    backend->handle->display = calloc(1, sizeof(display_backend_t));
+    LV_ASSERT_NULL(backend->handle->display);
+
+    backend->name = backend_name;
+    backend->handle->display->init_display = init_headless;
+    backend->handle->display->is_running = is_running_headless;
+    backend->type = BACKEND_DISPLAY;
+
+    return 0;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Initialize the headless display
+ *
+ * @return the LVGL display
+ */
+static lv_display_t *init_headless(void)
+{
+    const char *format = getenv_default("LV_SIM_HEADLESS_DUMP_FORMAT", "png");
+
+    memset(&hl, 0, sizeof(hl));
+
+    hl.max_frames = (uint32_t)strtoul(getenv_default("LV_SIM_HEADLESS_FRAMES", "0"), NULL, 10);
+    hl.dump_dir = getenv_default("LV_SIM_HEADLESS_DUMP_DIR", ".");
+    parse_dumps(getenv_default("LV_SIM_HEADLESS_DUMP", ""));
+
+    if (strcmp(format, "png") == 0) {
+        hl.dump_format = DUMP_PNG;
+    } else if (strcmp(format, "raw") == 0) {
+        hl.dump_format = DUMP_RAW;
+    } else {
+        LV_LOG_ERROR("Unknown dump format %s, expected png or raw", format);
+        return NULL;
+    }
+
+    hl.disp = lv_display_create((int32_t)settings.window_width, (int32_t)settings.window_height);
+    if (hl.disp == NULL) {
+        return NULL;
+    }
+
+    hl.buf = lv_draw_buf_create(settings.window_width, settings.window_height,
+                                lv_display_get_color_format(hl.disp), LV_STRIDE_AUTO);
+    if (hl.buf == NULL) {
+        lv_display_delete(hl.disp);
+        hl.disp = NULL;
+        return NULL;
+    }
+
+    /* Only the invalidated areas are rendered, the buffer always holds the last frame */
+    lv_display_set_draw_buffers(hl.disp, hl.buf, NULL);
+    lv_display_set_render_mode(hl.disp, LV_DISPLAY_RENDER_MODE_DIRECT);
+    lv_display_set_flush_cb(hl.disp, flush_cb);
+    lv_display_add_event_cb(hl.disp, render_start_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(hl.disp, delete_cb, LV_EVENT_DELETE, NULL);
+
+    LV_LOG_USER("Headless display %ux%u, %u frames", (unsigned)settings.window_width,
+                (unsigned)settings.window_height, (unsigned)hl.max_frames);
+
+    return hl.disp;
+}
+
+/**
+ * Stop once the requested number of frames is rendered
+ */
+static bool is_running_headless(void)
+{
+    return hl.max_frames == 0 || hl.frames < hl.max_frames;
+}
+
+/**
+ * Parse the frames to dump, i.e "1,60,120"
+ */
+static void parse_dumps(const char *list)
+{
+    char *end;
+    unsigned long frame;
+
+    while (*list != '\0' && hl.dump_count < HEADLESS_MAX_DUMPS) {
+        frame = strtoul(list, &end, 10);
+        if (end == list) {
+            LV_LOG_WARN("Invalid frame list: %s", list);
+            return;
+        }
+
+        if (frame > 0) {
+            hl.dumps[hl.dump_count++] = (uint32_t)frame;
+        }
+
+        list = *end == ',' ? end + 1 : end;
+    }
+}
+
+static bool is_dumped(uint32_t frame)
+{
+    uint32_t i;
+
+    for (i = 0; i < hl.dump_count; i++) {
+        if (hl.dumps[i] == frame) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    LV_UNUSED(px_map);
+
+    hl.areas++;
+    hl.pixels += lv_area_get_size(area);
+
+    if (lv_display_flush_is_last(disp)) {
+        hl.frames++;
+        hl.render_us += now_us() - hl.render_start_us;
+
+        if (is_dumped(hl.frames) && dump_frame(hl.frames) != 0) {
+            LV_LOG_ERROR("Failed to dump frame %u: %s", (unsigned)hl.frames, strerror(errno));
+        }
+    }
+
+    lv_display_flush_ready(disp);
+}
+
+static void render_start_cb(lv_event_t *e)
+{
+    LV_UNUSED(e);
+    hl.render_start_us = now_us();
+}
+
+static void delete_cb(lv_event_t *e)
+{
+    LV_UNUSED(e);
+
+    fprintf(stderr, "Headless: %u frames, %llu areas, %llu pixels flushed, %.1f us per frame\n",
+            (unsigned)hl.frames, (unsigned long long)hl.areas, (unsigned long long)hl.pixels,
+            hl.frames > 0 ? (double)hl.render_us / hl.frames : 0.0);
+
+    lv_draw_buf_destroy(hl.buf);
+    memset(&hl, 0, sizeof(hl));
+}
+
+/**
+ * Write the frame into LV_SIM_HEADLESS_DUMP_DIR
+ * @return 0 on success, -1 with errno set on error
+ */
+static int dump_frame(uint32_t frame)
+{
+    char path[256];
+    int ret;
+
+    snprintf(path, sizeof(path), "%s/frame-%06u.%s", hl.dump_dir, (unsigned)frame,
+             hl.dump_format == DUMP_PNG ? "png" : "raw");
+
+    ret = hl.dump_format == DUMP_PNG ? dump_png(path) : dump_raw(path);
+    if (ret == 0) {
+        LV_LOG_USER("Frame %u written to %s", (unsigned)frame, path);
+    }
+
+    return ret;
+}
+
+/**
+ * Write the pixels as they are rendered, without the padding of the rows
+ */
+static int dump_raw(const char *path)
+{
+    const lv_image_header_t *header = &hl.buf->header;
+    uint32_t row_size = header->w * lv_color_format_get_size(header->cf);
+    uint32_t y;
+    FILE *f;
+    int ret = 0;
+
+    f = fopen(path, "wb");
+    if (f == NULL) {
+        return -1;
+    }
+
+    for (y = 0; y < header->h && ret == 0; y++) {
+        if (fwrite(hl.buf->data + y * header->stride, 1, row_size, f) != row_size) {
+            ret = -1;
+        }
+    }
+
+    if (fclose(f) != 0) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/**
+ * Write an RGB PNG file, the image data is stored without compression
+ * so that no zlib is needed
+ */
+static int dump_png(const char *path)
+{
+    const lv_image_header_t *header = &hl.buf->header;
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    /* Deflate, 32K window, no preset dictionary, check bits */
+    static const uint8_t zlib_header[2] = {0x78, 0x01};
+    /* 8 bits RGB, deflate, adaptive filters, not interlaced */
+    static const uint8_t ihdr[5] = {8, 2, 0, 0, 0};
+    uint32_t row_size = 1 + header->w * 3;
+    uint32_t data_size = row_size * header->h;
+    uint32_t blocks = (data_size + DEFLATE_BLOCK_MAX - 1) / DEFLATE_BLOCK_MAX;
+    uint32_t adler_a = 1;
+    uint32_t adler_b = 0;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t i;
+    uint32_t y;
+    uint8_t block_header[5];
+    uint8_t *data;
+    png_writer_t png;
+    int ret = 0;
+
+    /* Each row starts with the filter type, 0 for none */
+    data = malloc(data_size);
+    if (data == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (y = 0; y < header->h; y++) {
+        data[y * row_size] = 0;
+        if (!to_rgb888(data + y * row_size + 1, hl.buf->data + y * header->stride, header->w, header->cf)) {
+            LV_LOG_ERROR("The color format %d can not be written as PNG", (int)header->cf);
+            free(data);
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    png.f = fopen(path, "wb");
+    if (png.f == NULL) {
+        free(data);
+        return -1;
+    }
+
+    png_write(&png, signature, sizeof(signature));
+
+    png_chunk_start(&png, "IHDR", 8 + sizeof(ihdr));
+    png_write_u32(&png, header->w);
+    png_write_u32(&png, header->h);
+    png_write(&png, ihdr, sizeof(ihdr));
+    png_chunk_end(&png);
+
+    png_chunk_start(&png, "IDAT", sizeof(zlib_header) + blocks * sizeof(block_header) + data_size + 4);
+    png_write(&png, zlib_header, sizeof(zlib_header));
+
+    for (offset = 0; offset < data_size; offset += size) {
+        size = LV_MIN(data_size - offset, DEFLATE_BLOCK_MAX);
+
+        /* Stored block, the last one has the final bit set */
+        block_header[0] = offset + size == data_size ? 1 : 0;
+        block_header[1] = size & 0xff;
+        block_header[2] = size >> 8;
+        block_header[3] = ~size & 0xff;
+        block_header[4] = (~size >> 8) & 0xff;
+        png_write(&png, block_header, sizeof(block_header));
+        png_write(&png, data + offset, size);
+
+        for (i = 0; i < size; i++) {
+            adler_a = (adler_a + data[offset + i]) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+    }
+
+    png_write_u32(&png, (adler_b << 16) | adler_a);
+    png_chunk_end(&png);
+
+    png_chunk_start(&png, "IEND", 0);
+    png_chunk_end(&png);
+
+    if (ferror(png.f)) {
+        ret = -1;
+    }
+
+    if (fclose(png.f) != 0) {
+        ret = -1;
+    }
+
+    free(data);
+    return ret;
+}
+
+/**
+ * Convert rendered pixels to the byte order of PNG
+ * @return false if the color format is not supported
+ */
+static bool to_rgb888(uint8_t *dst, const uint8_t *src, uint32_t count, lv_color_format_t cf)
+{
+    uint32_t i;
+    uint16_t px;
+
+    switch (cf) {
+    case LV_COLOR_FORMAT_RGB565:
+        for (i = 0; i < count; i++) {
+            px = (uint16_t)(src[2 * i] | (src[2 * i + 1] << 8));
+            dst[3 * i] = (uint8_t)(((px >> 11) << 3) | (px >> 13));
+            dst[3 * i + 1] = (uint8_t)((((px >> 5) & 0x3f) << 2) | ((px >> 9) & 0x3));
+            dst[3 * i + 2] = (uint8_t)(((px & 0x1f) << 3) | ((px >> 2) & 0x7));
+        }
+        return true;
+    case LV_COLOR_FORMAT_RGB888:
+    case LV_COLOR_FORMAT_XRGB8888:
+    case LV_COLOR_FORMAT_ARGB8888: {
+        /* LVGL stores the blue first */
+        uint32_t px_size = lv_color_format_get_size(cf);
+
+        for (i = 0; i < count; i++) {
+            dst[3 * i] = src[px_size * i + 2];
+            dst[3 * i + 1] = src[px_size * i + 1];
+            dst[3 * i + 2] = src[px_size * i];
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static void png_write(png_writer_t *png, const void *data, size_t size)
+{
+    png->crc = crc32_update(png->crc, data, size);
+    fwrite(data, 1, size, png->f);
+}
+
+/* The integers of PNG are big endian */
+static void png_write_u32(png_writer_t *png, uint32_t value)
+{
+    uint8_t bytes[4] = {(uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+
+    png_write(png, bytes, sizeof(bytes));
+}
+
+/**
+ * Write the size and the type of a chunk, the CRC starts at the type
+ */
+static void png_chunk_start(png_writer_t *png, const char *type, uint32_t size)
+{
+    png_write_u32(png, size);
+    png->crc = 0;
+    png_write(png, type, 4);
+}
+
+static void png_chunk_end(png_writer_t *png)
+{
+    png_write_u32(png, png->crc);
+}
+
+/**
+ * The CRC-32 of zlib and PNG, pre and post conditioned
+ */
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t size)
+{
+    static uint32_t table[256];
+    uint32_t c;
+    uint32_t n;
+    int k;
+
+    if (table[1] == 0) {
+        for (n = 0; n < 256; n++) {
+            c = n;
+            for (k = 0; k < 8; k++) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+    }
+
+    crc = ~crc;
+    while (size--) {
+        crc = table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
@@ -41,7 +41,6 @@ extern simulator_settings_t settings;
 /**********************
  *  STATIC PROTOTYPES
  **********************/
-static void run_loop_sdl(void);
 static lv_display_t *init_sdl(void);
 
 /**********************
@@ -67,11 +66,10 @@ int backend_init_sdl(backend_t *backend)
 {
     LV_ASSERT_NULL(backend);
 
-    backend->handle->display = malloc(sizeof(display_backend_t));
+    backend->handle->display = calloc(1, sizeof(display_backend_t));
     LV_ASSERT_NULL(backend->handle->display);
 
     backend->handle->display->init_display = init_sdl;
-    backend->handle->display->run_loop = run_loop_sdl;
     backend->name = backend_name;
     backend->type = BACKEND_DISPLAY;
 
@@ -99,19 +97,4 @@ static lv_display_t *init_sdl(void)
 
     return disp;
 }
-
-/**
- * The run loop of the SDL driver
- */
-static void run_loop_sdl(void)
-{
-    uint32_t idle_time;
-
-    /* Handle LVGL tasks */
-    while (true) {
-        /* Returns the time to the next timer execution */
-        idle_time = lv_timer_handler();
-        usleep(idle_time * 1000);
-    }
-}
 #endif /*#if LV_USE_SDL*/
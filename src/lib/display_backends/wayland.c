@@ -37,7 +37,8 @@
  *  STATIC PROTOTYPES
  **********************/
 static lv_display_t *init_wayland(void);
-static void run_loop_wayland(void);
+static int get_fds_wayland(backend_fd_t *fds, int max);
+static bool is_running_wayland(void);
 
 /**********************
  *  STATIC VARIABLES
@@ -66,11 +67,13 @@ extern simulator_settings_t settings;
 int backend_init_wayland(backend_t *backend)
 {
     LV_ASSERT_NULL(backend);
-    backend->handle->display = malloc(sizeof(display_backend_t));
+    backend->handle->display = calloc(1, sizeof(display_backend_t));
     LV_ASSERT_NULL(backend->handle->display);
 
     backend->handle->display->init_display = init_wayland;
-    backend->handle->display->run_loop = run_loop_wayland;
+    backend->handle->display->get_fds = get_fds_wayland;
+    backend->handle->display->timer_handler = lv_wayland_timer_handler;
+    backend->handle->display->is_running = is_running_wayland;
     backend->name = backend_name;
     backend->type = BACKEND_DISPLAY;
 
@@ -114,30 +117,29 @@ static lv_display_t *init_wayland(void)
 }
 
 /**
- * The run loop of the DRM driver
+ * Get the fd of the connection to the compositor
  *
- * @note Currently, the wayland driver calls lv_timer_handler internaly
- * The wayland driver needs to be re-written to match the other backends
+ * @note the events are read and dispatched by lv_wayland_timer_handler
+ * which is called by the scheduler instead of lv_timer_handler
  */
-static void run_loop_wayland(void)
+static int get_fds_wayland(backend_fd_t *fds, int max)
 {
+    if (max < 1) {
+        return 0;
+    }
 
-    uint32_t idle_time;
-
-    /* Handle LVGL tasks */
-    while (true) {
-
-        idle_time = lv_wayland_timer_handler();
+    fds[0].fd = lv_wayland_get_fd();
+    fds[0].edge = true;
 
-        if(idle_time != 0) {
-            usleep(idle_time * 1000);
-        }
+    return fds[0].fd >= 0 ? 1 : 0;
+}
 
-        /* Run until the last window closes */
-        if (!lv_wayland_window_is_open(NULL)) {
-            break;
-        }
-    }
+/**
+ * Run until the last window closes
+ */
+static bool is_running_wayland(void)
+{
+    return lv_wayland_window_is_open(NULL);
 }
 
 #endif /*#if LV_USE_WAYLAND*/
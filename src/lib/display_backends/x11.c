@@ -43,7 +43,6 @@ extern simulator_settings_t settings;
  *  STATIC PROTOTYPES
  **********************/
 static lv_display_t *init_x11(void);
-static void run_loop_x11(void);
 
 /**********************
  *  STATIC VARIABLES
@@ -67,12 +66,11 @@ static char *backend_name = "X11";
 int backend_init_x11(backend_t *backend)
 {
     LV_ASSERT_NULL(backend);
-    backend->handle->display = malloc(sizeof(display_backend_t));
+    backend->handle->display = calloc(1, sizeof(display_backend_t));
     LV_ASSERT_NULL(backend->handle->display);
 
     backend->name = backend_name;
     backend->handle->display->init_display = init_x11;
-    backend->handle->display->run_loop = run_loop_x11;
     backend->type = BACKEND_DISPLAY;
 
     return 0;
@@ -106,19 +104,4 @@ static lv_display_t *init_x11(void)
     return disp;
 }
 
-/**
- * The run loop of the X11 driver
- */
-void run_loop_x11(void)
-{
-    uint32_t idle_time;
-
-    /* Handle LVGL tasks */
-    while (true) {
-        /* Returns the time to the next timer execution */
-        idle_time = lv_timer_handler();
-        usleep(idle_time * 1000);
-    }
-}
-
 #endif /*#if LV_USE_X11*/
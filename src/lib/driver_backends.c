@@ -18,12 +18,22 @@
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <time.h>
 
 #include "lvgl/lvgl.h"
+#include "lvgl/src/display/lv_display_private.h"
 
 #include "simulator_util.h"
 #include "simulator_settings.h"
 #include "driver_backends.h"
+#include "frame_hist.h"
+#include "mem_alloc.h"
+#include "realtime.h"
 
 #include "backends.h"
 
@@ -42,13 +52,47 @@
 #error Unsupported configuration - Please select at least one graphics backend in lv_conf.h
 #endif
 
+/* Maximum number of fds watched by the scheduler, besides its own */
+#define SCHED_MAX_FDS       BACKEND_MAX_FDS
+
+/* The display and indev fds, the timerfd and the signalfd */
+#define SCHED_MAX_EVENTS    (2 * SCHED_MAX_FDS + 2)
+
+/* Maximum number of input devices created by the display backend */
+#define SCHED_MAX_INDEVS    8
+
 /**********************
  *      TYPEDEFS
  **********************/
 
+/* A pointer input device and its read callback, see rotate_indev() */
+typedef struct {
+    lv_indev_t *indev;
+    lv_indev_read_cb_t read_cb;
+} rotated_indev_t;
+
 /**********************
  *  STATIC PROTOTYPES
  **********************/
+static void mark_backend_indevs(void);
+static bool is_backend_indev(lv_indev_t *indev);
+static void prefault_display(lv_display_t *disp);
+static void rotate_indevs(void);
+static void rotate_indev(lv_indev_t *indev);
+static rotated_indev_t *find_rotated_indev(lv_indev_t *indev);
+static void rotated_read_cb(lv_indev_t *indev, lv_indev_data_t *data);
+static void rotated_indev_deleted_cb(lv_event_t *e);
+static bool has_event_indevs(void);
+static void unwatch_fd(int fd);
+static void watch_fds(display_backend_t *dispb);
+static void update_indevs(display_backend_t *dispb);
+static bool read_event_indevs(void);
+static void arm_timer(uint32_t ms);
+static void start_pacing(display_backend_t *dispb);
+static void stop_pacing(display_backend_t *dispb);
+static void request_frame(void);
+static void render_frame(uint64_t vblank_us, bool on_vblank);
+static void invalidate_area_cb(lv_event_t *e);
 
 /**********************
  *  STATIC VARIABLES
@@ -84,6 +128,9 @@ backend_init_t available_backends[] = {
     backend_init_glfw3,
 #endif
 
+    /* Needs no display, never the default backend */
+    backend_init_headless,
+
 #if LV_USE_EVDEV
     backend_init_evdev,
 #endif
@@ -96,6 +143,35 @@ static backend_t *backends[sizeof(available_backends) / sizeof(available_backend
 /* Set once the user selects a backend - or it is set to the default backend */
 static backend_t *sel_display_backend = NULL;
 
+/* The indev backends that were initialized */
+static indev_backend_t *sel_indev_backends[sizeof(available_backends) / sizeof(available_backends[0])];
+static int sel_indev_count;
+
+/* Scheduler state */
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static int signal_fd = -1;
+static int display_fds[SCHED_MAX_FDS];
+static int display_fd_count;
+static int indev_fds[SCHED_MAX_FDS];
+static int indev_fd_count;
+static lv_indev_t *backend_indevs[SCHED_MAX_INDEVS];
+static uint32_t backend_indev_count;
+static uint32_t indev_count;
+
+/* Rotation applied by the display hardware, the pointers are rotated here */
+static lv_display_rotation_t hw_rotation = LV_DISPLAY_ROTATION_0;
+static rotated_indev_t rotated_indevs[SCHED_MAX_INDEVS];
+
+/* Frame pacing state */
+static const vsync_source_t *vsync;     /* NULL when the frames are not paced */
+static int vsync_fd = -1;
+static bool vsync_requested;
+static bool frame_pending;              /* The display has invalidated areas */
+static uint64_t last_vblank_us;
+static uint32_t frame_budget_us;        /* 0 to use the refresh period */
+static driver_backends_frame_stats_t frame_stats;
+
 /**********************
  *  GLOBAL VARIABLES
  **********************/
@@ -144,6 +220,7 @@ int driver_backends_init_backend(char *backend_name)
     int i;
     display_backend_t *dispb;
     indev_backend_t *indevb;
+    mem_tag_t tag;
 
     if (backends[0] == NULL) {
         LV_LOG_ERROR("Please call driver_backends_register first");
@@ -178,14 +255,36 @@ int driver_backends_init_backend(char *backend_name)
 
                 dispb = b->handle->display;
                 LV_ASSERT_NULL(dispb->init_display);
+
+                /* Most of it is the draw and frame buffers of the backend */
+                tag = mem_tag_set(MEM_TAG_DRAW_BUF);
                 dispb->display = dispb->init_display();
+                mem_tag_set(tag);
 
                 if (dispb->display == NULL) {
                     LV_LOG_ERROR("Failed to init display with %s backend", b->name);
                     return -1;
                 }
 
+                /*
+                 * Rotated by LVGL and the backend unless the hardware does it,
+                 * the pointers are then rotated like LVGL would
+                 */
+                if (settings.rotation != LV_DISPLAY_ROTATION_0) {
+                    if (dispb->hw_rotation == NULL || !dispb->hw_rotation()) {
+                        lv_display_set_rotation(dispb->display, settings.rotation);
+                    } else {
+                        hw_rotation = settings.rotation;
+                    }
+                }
+
+                /* The first frames do not fault the buffers in */
+                if (settings.realtime) {
+                    prefault_display(dispb->display);
+                }
+
                 sel_display_backend = b;
+                mark_backend_indevs();
                 LV_LOG_INFO("Initialized %s display backend", b->name);
                 break;
 
@@ -209,6 +308,8 @@ int driver_backends_init_backend(char *backend_name)
 
                 LV_ASSERT_NULL(dispb->display);
                 indevb->init_indev(dispb->display);
+                sel_indev_backends[sel_indev_count++] = indevb;
+                rotate_indevs();
                 break;
             }
         }
@@ -264,21 +365,650 @@ int driver_backends_is_supported(char *backend_name)
     return 0;
 }
 
+int driver_backends_init_run_loop(void)
+{
+    struct epoll_event ev = {.events = EPOLLIN};
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (signal_fd < 0 || timer_fd < 0 || epoll_fd < 0) {
+        driver_backends_deinit_run_loop();
+        return -1;
+    }
+
+    ev.data.fd = signal_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev) != 0) {
+        LV_LOG_ERROR("Failed to watch the signal fd: %s", strerror(errno));
+        driver_backends_deinit_run_loop();
+        return -1;
+    }
+
+    ev.data.fd = timer_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) != 0) {
+        LV_LOG_ERROR("Failed to watch the timer fd: %s", strerror(errno));
+        driver_backends_deinit_run_loop();
+        return -1;
+    }
+
+    return 0;
+}
+
 void driver_backends_run_loop(void)
 {
+    struct epoll_event events[SCHED_MAX_EVENTS];
+    struct signalfd_siginfo si;
     display_backend_t *dispb;
+    uint64_t expirations;
+    uint32_t time_till_next;
+    bool keep_running = true;
+    bool polling = false;
+    bool display_ready;
+    bool input_ready;
+    bool vsync_ready;
+    uint64_t vblank_us;
+    int n;
+    int i;
+    int j;
 
-    if (sel_display_backend != NULL && sel_display_backend->handle->display != NULL) {
+    if (sel_display_backend == NULL || sel_display_backend->handle->display == NULL) {
+        LV_LOG_ERROR("No backend has been selected - initialize the backend first");
+        return;
+    }
 
-        dispb = sel_display_backend->handle->display;
-        dispb->run_loop();
+    if (epoll_fd < 0) {
+        LV_LOG_ERROR("Please call driver_backends_init_run_loop first");
+        return;
+    }
 
-    } else {
-        LV_LOG_ERROR("No backend has been selected - initialize the backend first");
+    dispb = sel_display_backend->handle->display;
+
+    /* Forces the first scan of the fds */
+    indev_count = UINT32_MAX;
+
+    start_pacing(dispb);
+
+    if (frame_hist_start(dispb->display) != 0) {
+        LV_LOG_WARN("The frame histograms are not exported");
+    }
+
+    while (keep_running) {
+
+        frame_hist_timer_begin();
+        time_till_next = dispb->timer_handler != NULL ? dispb->timer_handler() : lv_timer_handler();
+        frame_hist_timer_end();
+
+        if (dispb->is_running != NULL && !dispb->is_running()) {
+            break;
+        }
+
+        update_indevs(dispb);
+
+        if (vsync != NULL && frame_pending && !vsync_requested) {
+            request_frame();
+        }
+
+        /* A pressed pointer is read at the refresh rate, for dragging and scroll throw */
+        if (polling && time_till_next > LV_DEF_REFR_PERIOD) {
+            time_till_next = LV_DEF_REFR_PERIOD;
+        }
+        arm_timer(time_till_next);
+
+        n = epoll_wait(epoll_fd, events, SCHED_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LV_LOG_ERROR("epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        display_ready = false;
+        input_ready = false;
+        vsync_ready = false;
+        for (i = 0; i < n; i++) {
+            if (events[i].data.fd == signal_fd) {
+                while (read(signal_fd, &si, sizeof(si)) == sizeof(si)) {
+                    keep_running = false;
+                }
+            } else if (events[i].data.fd == timer_fd) {
+                while (read(timer_fd, &expirations, sizeof(expirations)) > 0) {
+                }
+            } else if (vsync != NULL && events[i].data.fd == vsync_fd) {
+                vsync_ready = true;
+            } else {
+                for (j = 0; j < display_fd_count; j++) {
+                    if (display_fds[j] == events[i].data.fd) {
+                        display_ready = true;
+                        break;
+                    }
+                }
+                input_ready |= j == display_fd_count;
+            }
+        }
+
+        if (display_ready && dispb->flush_done != NULL) {
+            dispb->flush_done();
+        }
+
+        if (input_ready || polling) {
+            polling = read_event_indevs();
+        }
+
+        /* Rendered last, the frame includes the input that came with the vblank */
+        if (vsync_ready) {
+            vsync_requested = false;
+            if (vsync->read(&vblank_us)) {
+                render_frame(vblank_us, true);
+            }
+        }
     }
+
+    frame_hist_stop();
+    stop_pacing(dispb);
+}
+
+void driver_backends_deinit_run_loop(void)
+{
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+
+    if (timer_fd >= 0) {
+        close(timer_fd);
+    }
+
+    if (signal_fd >= 0) {
+        close(signal_fd);
+    }
+
+    epoll_fd = timer_fd = signal_fd = -1;
+    display_fd_count = indev_fd_count = 0;
+}
+
+void driver_backends_get_frame_stats(driver_backends_frame_stats_t *stats)
+{
+    *stats = frame_stats;
+}
+
+bool driver_backends_set_hw_cursor(lv_indev_t *indev, const lv_image_dsc_t *icon)
+{
+    display_backend_t *dispb;
+
+    if (sel_display_backend == NULL) {
+        return false;
+    }
+
+    dispb = sel_display_backend->handle->display;
+
+    if (dispb->set_cursor == NULL) {
+        return false;
+    }
+
+    /* The cursor is placed from the rotated point */
+    rotate_indev(indev);
+
+    return dispb->set_cursor(indev, icon);
 }
 
 /**********************
  *   STATIC FUNCTIONS
  **********************/
 
+/**
+ * Remember the input devices created by the display backend
+ * @description these read their events from the display connection (SDL,
+ * X11, Wayland ...), they keep being polled by their LVGL read timer
+ */
+static void mark_backend_indevs(void)
+{
+    lv_indev_t *indev = NULL;
+
+    backend_indev_count = 0;
+    while ((indev = lv_indev_get_next(indev)) != NULL &&
+           backend_indev_count < SCHED_MAX_INDEVS) {
+        backend_indevs[backend_indev_count++] = indev;
+    }
+}
+
+static bool is_backend_indev(lv_indev_t *indev)
+{
+    uint32_t i;
+
+    for (i = 0; i < backend_indev_count; i++) {
+        if (backend_indevs[i] == indev) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Fault in the draw buffers of a display in the real-time mode
+ * @description the locked memory may only cover the pages mapped before
+ * the display was created, see realtime_lock_memory()
+ */
+static void prefault_display(lv_display_t *disp)
+{
+    if (disp->buf_1 != NULL) {
+        realtime_prefault(disp->buf_1->data, disp->buf_1->data_size);
+    }
+    if (disp->buf_2 != NULL) {
+        realtime_prefault(disp->buf_2->data, disp->buf_2->data_size);
+    }
+}
+
+/**
+ * Rotate the pointers of the indev backends when the hardware rotates the display
+ * @description called after the indev backends are initialized and when
+ * the evdev discovery adds devices
+ */
+static void rotate_indevs(void)
+{
+    lv_indev_t *indev = NULL;
+
+    if (hw_rotation == LV_DISPLAY_ROTATION_0) {
+        return;
+    }
+
+    while ((indev = lv_indev_get_next(indev)) != NULL) {
+        if (!is_backend_indev(indev)) {
+            rotate_indev(indev);
+        }
+    }
+}
+
+/**
+ * Wrap the read callback of a pointer to rotate its point
+ * @description LVGL does it for the displays it rotates, with a plane
+ * rotation its display stays unrotated. Called once per input device.
+ */
+static void rotate_indev(lv_indev_t *indev)
+{
+    rotated_indev_t *ri;
+
+    if (hw_rotation == LV_DISPLAY_ROTATION_0 ||
+        lv_indev_get_type(indev) != LV_INDEV_TYPE_POINTER ||
+        find_rotated_indev(indev) != NULL) {
+        return;
+    }
+
+    ri = find_rotated_indev(NULL);
+    if (ri == NULL) {
+        LV_LOG_WARN("Too many pointers, the input is not rotated");
+        return;
+    }
+
+    ri->indev = indev;
+    ri->read_cb = lv_indev_get_read_cb(indev);
+    lv_indev_set_read_cb(indev, rotated_read_cb);
+    lv_indev_add_event_cb(indev, rotated_indev_deleted_cb, LV_EVENT_DELETE, NULL);
+}
+
+static rotated_indev_t *find_rotated_indev(lv_indev_t *indev)
+{
+    uint32_t i;
+
+    for (i = 0; i < SCHED_MAX_INDEVS; i++) {
+        if (rotated_indevs[i].indev == indev) {
+            return &rotated_indevs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Read the pointer with the driver, then rotate its point
+ * @description the driver maps the device on the resolution of the
+ * display, the point is scaled back to the unrotated panel and rotated
+ * the way indev_pointer_proc() of LVGL does
+ */
+static void rotated_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    rotated_indev_t *ri = find_rotated_indev(indev);
+    lv_display_t *disp;
+    int32_t hor_res;
+    int32_t ver_res;
+    int32_t phys_hor_res;
+    int32_t phys_ver_res;
+    int32_t x;
+    int32_t y;
+    int32_t tmp;
+
+    if (ri == NULL || ri->read_cb == NULL) {
+        return;
+    }
+
+    ri->read_cb(indev, data);
+
+    disp = lv_indev_get_display(indev);
+    if (disp == NULL) {
+        disp = lv_display_get_default();
+    }
+
+    hor_res = lv_display_get_horizontal_resolution(disp);
+    ver_res = lv_display_get_vertical_resolution(disp);
+
+    if (hor_res <= 0 || ver_res <= 0) {
+        return;
+    }
+
+    if (hw_rotation == LV_DISPLAY_ROTATION_90 || hw_rotation == LV_DISPLAY_ROTATION_270) {
+        phys_hor_res = ver_res;
+        phys_ver_res = hor_res;
+    } else {
+        phys_hor_res = hor_res;
+        phys_ver_res = ver_res;
+    }
+
+    x = data->point.x * phys_hor_res / hor_res;
+    y = data->point.y * phys_ver_res / ver_res;
+
+    if (hw_rotation == LV_DISPLAY_ROTATION_180 || hw_rotation == LV_DISPLAY_ROTATION_270) {
+        x = phys_hor_res - x - 1;
+        y = phys_ver_res - y - 1;
+    }
+
+    if (hw_rotation == LV_DISPLAY_ROTATION_90 || hw_rotation == LV_DISPLAY_ROTATION_270) {
+        tmp = y;
+        y = x;
+        x = phys_ver_res - tmp - 1;
+    }
+
+    data->point.x = x;
+    data->point.y = y;
+}
+
+static void rotated_indev_deleted_cb(lv_event_t *e)
+{
+    rotated_indev_t *ri = find_rotated_indev(lv_event_get_target(e));
+
+    if (ri != NULL) {
+        ri->indev = NULL;
+        ri->read_cb = NULL;
+    }
+}
+
+/**
+ * Check if the input devices of the indev backends can be read in event mode
+ */
+static bool has_event_indevs(void)
+{
+    int i;
+
+    for (i = 0; i < sel_indev_count; i++) {
+        if (sel_indev_backends[i]->get_fds != NULL) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Remove a fd from the epoll set
+ * @description a fd the driver has already closed has left the set on its
+ * own, only the other failures are reported
+ */
+static void unwatch_fd(int fd)
+{
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) != 0 && errno != EBADF && errno != ENOENT) {
+        LV_LOG_WARN("Failed to unwatch fd %d: %s", fd, strerror(errno));
+    }
+}
+
+/**
+ * Register the fds of the display and indev backends in the epoll set
+ * @description the previous fds are removed first, the drivers open and
+ * close their devices at any time
+ */
+static void watch_fds(display_backend_t *dispb)
+{
+    backend_fd_t fds[SCHED_MAX_FDS];
+    struct epoll_event ev;
+    int count;
+    int i;
+    int j;
+
+    for (i = 0; i < display_fd_count; i++) {
+        unwatch_fd(display_fds[i]);
+    }
+    for (i = 0; i < indev_fd_count; i++) {
+        unwatch_fd(indev_fds[i]);
+    }
+    display_fd_count = indev_fd_count = 0;
+
+    count = dispb->get_fds != NULL ? dispb->get_fds(fds, SCHED_MAX_FDS) : 0;
+    for (i = 0; i < count; i++) {
+        ev.events = fds[i].edge ? EPOLLIN | EPOLLET : EPOLLIN;
+        ev.data.fd = fds[i].fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fds[i].fd, &ev) == 0) {
+            display_fds[display_fd_count++] = fds[i].fd;
+        }
+    }
+
+    for (j = 0; j < sel_indev_count; j++) {
+
+        if (sel_indev_backends[j]->get_fds == NULL) {
+            continue;
+        }
+
+        count = sel_indev_backends[j]->get_fds(fds, SCHED_MAX_FDS - indev_fd_count);
+        for (i = 0; i < count; i++) {
+            ev.events = fds[i].edge ? EPOLLIN | EPOLLET : EPOLLIN;
+            ev.data.fd = fds[i].fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fds[i].fd, &ev) == 0) {
+                indev_fds[indev_fd_count++] = fds[i].fd;
+            }
+        }
+    }
+}
+
+/**
+ * Switch the new input devices of the indev backends to event mode
+ * @description called after every timer run, input devices are created by
+ * the evdev discovery at any time
+ */
+static void update_indevs(display_backend_t *dispb)
+{
+    lv_indev_t *indev = NULL;
+    uint32_t count = 0;
+
+    while ((indev = lv_indev_get_next(indev)) != NULL) {
+        count++;
+    }
+
+    if (count == indev_count) {
+        return;
+    }
+    indev_count = count;
+
+    rotate_indevs();
+
+    if (has_event_indevs()) {
+        while ((indev = lv_indev_get_next(indev)) != NULL) {
+            if (!is_backend_indev(indev) && lv_indev_get_mode(indev) != LV_INDEV_MODE_EVENT) {
+                lv_indev_set_mode(indev, LV_INDEV_MODE_EVENT);
+            }
+        }
+    }
+
+    watch_fds(dispb);
+}
+
+/**
+ * Read the input devices in event mode
+ * @return true if a pointer is pressed or a scroll is still running, the
+ * device must then be read periodically like in timer mode
+ */
+static bool read_event_indevs(void)
+{
+    lv_indev_t *indev = NULL;
+    bool active = false;
+
+    while ((indev = lv_indev_get_next(indev)) != NULL) {
+
+        if (lv_indev_get_mode(indev) != LV_INDEV_MODE_EVENT) {
+            continue;
+        }
+
+        lv_indev_read(indev);
+
+        if (lv_indev_get_state(indev) == LV_INDEV_STATE_PRESSED ||
+            lv_indev_get_scroll_obj(indev) != NULL) {
+            active = true;
+        }
+    }
+
+    return active;
+}
+
+/**
+ * Arm the timer for the next LVGL timer deadline
+ * @param ms the time until the deadline, LV_NO_TIMER_READY to disarm
+ */
+static void arm_timer(uint32_t ms)
+{
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+
+    if (ms != LV_NO_TIMER_READY) {
+        its.it_value.tv_sec = ms / 1000;
+        its.it_value.tv_nsec = (long)(ms % 1000) * 1000000L;
+
+        /* An all zero value disarms the timer */
+        if (ms == 0) {
+            its.it_value.tv_nsec = 1;
+        }
+    }
+
+    timerfd_settime(timer_fd, 0, &its, NULL);
+}
+
+/**
+ * Render on the vblanks of the display instead of the LVGL refresh timer
+ * @description the refresh timer is deleted, a vblank notification is
+ * requested when an area is invalidated and the frame is rendered when it
+ * arrives. At most one frame is rendered per refresh period.
+ * Set LV_SIM_VSYNC=0 to keep the refresh timer, LV_SIM_FRAME_BUDGET_US
+ * sets the time allowed to render a frame, the refresh period by default
+ */
+static void start_pacing(display_backend_t *dispb)
+{
+    struct epoll_event ev = {.events = EPOLLIN};
+
+    memset(&frame_stats, 0, sizeof(frame_stats));
+    frame_stats.period_us = LV_DEF_REFR_PERIOD * 1000;
+
+    if (dispb->vsync == NULL || strcmp(getenv_default("LV_SIM_VSYNC", "1"), "0") == 0) {
+        return;
+    }
+
+    vsync_fd = dispb->vsync->open(dispb->display);
+    if (vsync_fd < 0) {
+        LV_LOG_WARN("No vsync source, the frames are not paced");
+        return;
+    }
+
+    ev.data.fd = vsync_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, vsync_fd, &ev) != 0) {
+        dispb->vsync->close();
+        vsync_fd = -1;
+        return;
+    }
+
+    vsync = dispb->vsync;
+    vsync_requested = false;
+    last_vblank_us = 0;
+    frame_budget_us = (uint32_t)atoi(getenv_default("LV_SIM_FRAME_BUDGET_US", "0"));
+
+    lv_display_delete_refr_timer(dispb->display);
+    lv_display_add_event_cb(dispb->display, invalidate_area_cb, LV_EVENT_INVALIDATE_AREA, NULL);
+
+    /* The first frame */
+    frame_pending = true;
+
+    LV_LOG_USER("Frames are paced on the vblanks");
+}
+
+static void stop_pacing(display_backend_t *dispb)
+{
+    if (vsync == NULL) {
+        return;
+    }
+
+    lv_display_remove_event_cb_with_user_data(dispb->display, invalidate_area_cb, NULL);
+    unwatch_fd(vsync_fd);
+    vsync->close();
+
+    vsync = NULL;
+    vsync_fd = -1;
+    frame_pending = false;
+}
+
+/**
+ * Schedule the rendering of the pending frame
+ */
+static void request_frame(void)
+{
+    vsync_requested = vsync->request();
+
+    /* The source failed, render now rather than never */
+    if (!vsync_requested) {
+        render_frame(now_us(), false);
+    }
+}
+
+/**
+ * Render a frame and check it against its deadline
+ * @param vblank_us the time of the vblank the frame was started at
+ * @param on_vblank false if vblank_us is the current time because the
+ * vsync source failed, the refresh period is not estimated from it then
+ */
+static void render_frame(uint64_t vblank_us, bool on_vblank)
+{
+    uint64_t period;
+    uint64_t elapsed;
+
+    /* Vblanks requested back to back are one refresh period apart */
+    if (on_vblank && last_vblank_us != 0 && vblank_us > last_vblank_us) {
+        period = vblank_us - last_vblank_us;
+
+        if (period < (uint64_t)frame_stats.period_us * 3 / 4) {
+            frame_stats.period_us = (uint32_t)period;
+        } else if (period < (uint64_t)frame_stats.period_us * 5 / 4) {
+            frame_stats.period_us = (uint32_t)((frame_stats.period_us * 7ULL + period) / 8);
+        }
+    }
+    last_vblank_us = on_vblank ? vblank_us : 0;
+
+    frame_stats.budget_us = frame_budget_us != 0 ? frame_budget_us : frame_stats.period_us;
+
+    /* Areas invalidated while rendering go into the next frame */
+    frame_pending = false;
+    lv_display_refr_timer(NULL);
+
+    elapsed = now_us() - vblank_us;
+    frame_stats.frames++;
+    if (elapsed > frame_stats.budget_us) {
+        frame_stats.missed++;
+        LV_LOG_TRACE("Frame %u missed its deadline by %u us", (unsigned)frame_stats.frames,
+                     (unsigned)(elapsed - frame_stats.budget_us));
+    }
+}
+
+static void invalidate_area_cb(lv_event_t *e)
+{
+    LV_UNUSED(e);
+    frame_pending = true;
+}
@@ -26,6 +26,8 @@ extern "C" {
 /*********************
  *      INCLUDES
  *********************/
+#include <stdint.h>
+#include <stdbool.h>
 
 /*********************
  *      DEFINES
@@ -35,6 +37,14 @@ extern "C" {
  *      TYPEDEFS
  **********************/
 
+/* Frame pacing statistics, see driver_backends_get_frame_stats() */
+typedef struct {
+    uint32_t frames;            /* Frames rendered at a vblank */
+    uint32_t missed;            /* Frames that were not rendered within the budget */
+    uint32_t budget_us;         /* Time allowed to render a frame after the vblank */
+    uint32_t period_us;         /* Estimated refresh period of the display */
+} driver_backends_frame_stats_t;
+
 /**********************
  * GLOBAL PROTOTYPES
  **********************/
@@ -72,12 +82,49 @@ int driver_backends_is_supported(char *backend_name);
  */
 int driver_backends_print_supported(void);
 
+/**
+ * @brief Create the scheduler
+ * @description SIGINT and SIGTERM are blocked and received through a
+ * signalfd, this must be called before any thread is created so that
+ * every thread inherits the mask
+ *
+ * @return 0 on success, -1 on error
+ */
+int driver_backends_init_run_loop(void);
+
 /**
  * @brief Enter the run loop
- * @description enter the run loop of the selected backend
+ * @description runs the LVGL timers of the selected backend, sleeps until
+ * the next timer is due, one of the fds of the backends is readable or a
+ * signal is received. Returns on SIGINT, SIGTERM or once the display
+ * backend reports it is no longer running
  */
 void driver_backends_run_loop(void);
 
+/**
+ * @brief Release the scheduler
+ */
+void driver_backends_deinit_run_loop(void);
+
+/**
+ * @brief Get the frame pacing statistics
+ * @description frames are paced only if the display backend has a vsync
+ * source, all the counters are 0 otherwise
+ * @param stats the statistics since the run loop started
+ */
+void driver_backends_get_frame_stats(driver_backends_frame_stats_t *stats);
+
+/**
+ * @brief Show the cursor of a pointer with the display hardware
+ * @description the cursor is not an LVGL object then, moving it does
+ * not redraw the screen
+ * @param indev the pointer input device
+ * @param icon the cursor icon
+ * @return false if the display backend has no hardware cursor, the
+ * cursor has to be drawn by LVGL then
+ */
+bool driver_backends_set_hw_cursor(lv_indev_t *indev, const lv_image_dsc_t *icon);
+
 /**********************
  *      MACROS
  **********************/
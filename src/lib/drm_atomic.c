@@ -0,0 +1,893 @@
+/**
+ * @file drm_atomic.c
+ *
+ * DRM/KMS display driver using atomic modesetting
+ *
+ * Three buffers rotate between the roles of front (scanned out), pending
+ * (flip in flight) and back (being rendered). A frame rendered while a
+ * flip is in flight is queued and committed from the flip complete event,
+ * a queued frame that was not committed yet is rendered over by the next
+ * frame, so that the latest frame is always the one shown.
+ *
+ * When the primary plane can not scan out the RGB565 frames of
+ * LV_COLOR_DEPTH 16, the frames are rendered into a shadow buffer and the
+ * rendered areas are converted to XRGB8888 at flush time.
+ *
+ * A rotation is applied by the plane when it supports it. Otherwise
+ * the display is rotated by LVGL, the frames are rendered into a shadow
+ * buffer and the rendered areas are rotated at flush time.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lvgl/lvgl.h"
+
+#if LV_USE_LINUX_DRM
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <drm_fourcc.h>
+
+#include "damage.h"
+#include "pixel_convert.h"
+#include "pixel_rotate.h"
+#include "drm_atomic.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define DRM_ATOMIC_BUFFERS      3
+
+/* Clips passed per commit, the whole plane is marked as damaged beyond */
+#define DRM_ATOMIC_MAX_CLIPS    32
+
+/* Period of the retries of a commit refused with EBUSY */
+#define DRM_ATOMIC_RETRY_MS     4
+
+#if LV_COLOR_DEPTH == 16
+#define DRM_ATOMIC_CF           LV_COLOR_FORMAT_RGB565
+#define DRM_ATOMIC_FOURCC       DRM_FORMAT_RGB565
+#define DRM_ATOMIC_BPP          16
+#else
+#define DRM_ATOMIC_CF           LV_COLOR_FORMAT_XRGB8888
+#define DRM_ATOMIC_FOURCC       DRM_FORMAT_XRGB8888
+#define DRM_ATOMIC_BPP          32
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* A dumb buffer */
+typedef struct {
+    uint32_t handle;
+    uint32_t fb_id;
+    uint32_t pitch;
+    uint64_t size;
+    uint8_t *map;
+    lv_draw_buf_t draw_buf;
+} drm_buffer_t;
+
+/* Ids of the properties set by the commits */
+typedef struct {
+    uint32_t conn_crtc_id;
+    uint32_t crtc_mode_id;
+    uint32_t crtc_active;
+    uint32_t plane_fb_id;
+    uint32_t plane_crtc_id;
+    uint32_t plane_src_x;
+    uint32_t plane_src_y;
+    uint32_t plane_src_w;
+    uint32_t plane_src_h;
+    uint32_t plane_crtc_x;
+    uint32_t plane_crtc_y;
+    uint32_t plane_crtc_w;
+    uint32_t plane_crtc_h;
+    uint32_t plane_damage_clips;        /* 0 if the driver does not support damage clips */
+    uint32_t plane_rotation;            /* 0 if the plane can not rotate */
+} drm_props_t;
+
+typedef struct {
+    int fd;
+    lv_display_t *disp;
+    uint32_t conn_id;
+    uint32_t crtc_id;
+    uint32_t plane_id;
+    uint32_t mode_blob;
+    drmModeModeInfo mode;
+    bool native;                        /* the plane supports DRM_ATOMIC_FOURCC */
+    uint32_t fourcc;                    /* format of the dumb buffers */
+    uint32_t bpp;
+    uint32_t fb_w;                      /* size of the dumb buffers */
+    uint32_t fb_h;
+    uint64_t hw_rotation;               /* DRM_MODE_ROTATE_* applied by the plane */
+    lv_draw_buf_t *shadow;              /* rendered into when converting or rotating, NULL otherwise */
+    pixel_convert_fn_t convert;
+    pixel_rotate_t rot;                 /* from the shadow buffer to the dumb buffer rendered */
+    drm_props_t props;
+    drm_buffer_t bufs[DRM_ATOMIC_BUFFERS];
+    int32_t front;                      /* index of the buffer scanned out, -1 if none */
+    int32_t pending;                    /* flip in flight */
+    int32_t queued;                     /* rendered, waiting for the pending flip */
+    int32_t render;                     /* being rendered */
+    int32_t latest;                     /* holds the latest complete frame */
+    bool modeset;                       /* the CRTC was enabled by a first commit */
+    lv_timer_t *retry_timer;            /* commits the queued frame when no flip completes */
+    struct drm_mode_rect clips[DRM_ATOMIC_MAX_CLIPS];
+    uint32_t clip_count;
+    bool clips_overflow;
+    damage_tracker_t damage;
+} drm_atomic_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static int find_output(void);
+static bool has_format(const drmModePlane *plane, uint32_t fourcc);
+static uint32_t find_prop(uint32_t obj_id, uint32_t obj_type, const char *name, uint64_t *value);
+static int find_props(void);
+static uint64_t find_rotation(lv_display_rotation_t rotation);
+static int create_buffer(drm_buffer_t *buf, uint32_t w, uint32_t h);
+static void destroy_buffer(drm_buffer_t *buf);
+static int update_shadow(void);
+static void add_clip(const lv_area_t *area);
+static int submit(int32_t idx);
+static void submit_queued(void);
+static void retry_timer_cb(lv_timer_t *timer);
+static void flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void render_start_cb(lv_event_t *e);
+static void delete_cb(lv_event_t *e);
+static void page_flip_handler(int fd, unsigned int sequence, unsigned int tv_sec,
+                              unsigned int tv_usec, void *user_data);
+static void release(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static drm_atomic_t drm = {.fd = -1};
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+lv_display_t *drm_atomic_create(const char *device, bool xrgb8888, lv_display_rotation_t rotation)
+{
+    uint32_t w;
+    uint32_t h;
+    int i;
+
+    if (drm.fd >= 0) {
+        LV_LOG_ERROR("Only one atomic DRM display is supported");
+        return NULL;
+    }
+
+    drm.fd = open(device, O_RDWR | O_CLOEXEC);
+    if (drm.fd < 0) {
+        LV_LOG_ERROR("Failed to open %s: %s", device, strerror(errno));
+        return NULL;
+    }
+
+    if (drmSetClientCap(drm.fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) != 0 ||
+        drmSetClientCap(drm.fd, DRM_CLIENT_CAP_ATOMIC, 1) != 0) {
+        LV_LOG_ERROR("%s does not support atomic modesetting", device);
+        goto err;
+    }
+
+    if (find_output() != 0 || find_props() != 0) {
+        goto err;
+    }
+
+    if (drmModeCreatePropertyBlob(drm.fd, &drm.mode, sizeof(drm.mode), &drm.mode_blob) != 0) {
+        LV_LOG_ERROR("Failed to create the mode blob: %s", strerror(errno));
+        goto err;
+    }
+
+    w = drm.mode.hdisplay;
+    h = drm.mode.vdisplay;
+
+    /* The plane scans out buffers of the size of the rotated display */
+    drm.hw_rotation = find_rotation(rotation);
+    if (drm.hw_rotation == DRM_MODE_ROTATE_90 || drm.hw_rotation == DRM_MODE_ROTATE_270) {
+        w = drm.mode.vdisplay;
+        h = drm.mode.hdisplay;
+    }
+
+    drm.fb_w = w;
+    drm.fb_h = h;
+    drm.fourcc = DRM_ATOMIC_FOURCC;
+    drm.bpp = DRM_ATOMIC_BPP;
+
+    if (DRM_ATOMIC_FOURCC == DRM_FORMAT_RGB565 && (xrgb8888 || !drm.native)) {
+        drm.fourcc = DRM_FORMAT_XRGB8888;
+        drm.bpp = 32;
+        drm.convert = pixel_convert_get()->rgb565_to_xrgb8888;
+    }
+
+    for (i = 0; i < DRM_ATOMIC_BUFFERS; i++) {
+        if (create_buffer(&drm.bufs[i], w, h) != 0) {
+            goto err;
+        }
+    }
+
+    damage_tracker_init(&drm.damage, DRM_ATOMIC_BUFFERS, h);
+    drm.front = drm.pending = drm.queued = drm.latest = -1;
+    drm.render = 0;
+
+    /*
+     * Created before the display, the timers run newest first: resumed by a
+     * flush, it is still taken into account by the same lv_timer_handler()
+     */
+    drm.retry_timer = lv_timer_create(retry_timer_cb, DRM_ATOMIC_RETRY_MS, NULL);
+    if (drm.retry_timer == NULL) {
+        goto err;
+    }
+    lv_timer_pause(drm.retry_timer);
+
+    drm.disp = lv_display_create((int32_t)w, (int32_t)h);
+    if (drm.disp == NULL) {
+        goto err;
+    }
+
+    lv_display_set_color_format(drm.disp, DRM_ATOMIC_CF);
+    lv_display_set_draw_buffers(drm.disp, &drm.bufs[0].draw_buf, NULL);
+    if (update_shadow() != 0) {
+        goto err;
+    }
+
+    lv_display_set_render_mode(drm.disp, LV_DISPLAY_RENDER_MODE_DIRECT);
+    lv_display_set_flush_cb(drm.disp, flush_cb);
+    lv_display_add_event_cb(drm.disp, render_start_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(drm.disp, delete_cb, LV_EVENT_DELETE, NULL);
+
+    LV_LOG_USER("Atomic DRM display %ux%u@%u, damage clips %s", (unsigned)w, (unsigned)h,
+                (unsigned)drm.mode.vrefresh, drm.props.plane_damage_clips != 0 ? "on" : "not supported");
+
+    if (drm.convert != NULL) {
+        LV_LOG_USER("Frames converted to XRGB8888 with the %s kernels", pixel_convert_get()->name);
+    }
+
+    if (drm.hw_rotation != 0) {
+        LV_LOG_USER("Display rotated by the plane");
+    }
+
+    return drm.disp;
+
+err:
+    /* The delete callback is not registered yet, release() is only called once */
+    if (drm.disp != NULL) {
+        lv_display_delete(drm.disp);
+    }
+    release();
+    return NULL;
+}
+
+bool drm_atomic_has_hw_rotation(void)
+{
+    return drm.hw_rotation != 0;
+}
+
+int drm_atomic_get_fd(void)
+{
+    return drm.fd;
+}
+
+uint32_t drm_atomic_get_crtc_id(void)
+{
+    return drm.fd >= 0 ? drm.crtc_id : 0;
+}
+
+void drm_atomic_handle_events(void)
+{
+    drmEventContext ctx;
+
+    if (drm.fd < 0) {
+        return;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.version = 2;
+    ctx.page_flip_handler = page_flip_handler;
+
+    drmHandleEvent(drm.fd, &ctx);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Find the first connected connector, a CRTC it can be driven
+ * by and the primary plane of that CRTC
+ */
+static int find_output(void)
+{
+    drmModeConnector *conn = NULL;
+    drmModePlaneRes *planes;
+    drmModeEncoder *enc;
+    drmModePlane *plane;
+    drmModeRes *res;
+    uint64_t type;
+    int crtc_idx = -1;
+    int i;
+    int j;
+
+    res = drmModeGetResources(drm.fd);
+    if (res == NULL) {
+        LV_LOG_ERROR("Failed to get the DRM resources: %s", strerror(errno));
+        return -1;
+    }
+
+    for (i = 0; i < res->count_connectors; i++) {
+        conn = drmModeGetConnector(drm.fd, res->connectors[i]);
+        if (conn != NULL && conn->connection == DRM_MODE_CONNECTED && conn->count_modes > 0) {
+            break;
+        }
+        drmModeFreeConnector(conn);
+        conn = NULL;
+    }
+
+    if (conn == NULL) {
+        LV_LOG_ERROR("No connected connector");
+        drmModeFreeResources(res);
+        return -1;
+    }
+
+    drm.conn_id = conn->connector_id;
+    drm.mode = conn->modes[0];
+    for (i = 0; i < conn->count_modes; i++) {
+        if (conn->modes[i].type & DRM_MODE_TYPE_PREFERRED) {
+            drm.mode = conn->modes[i];
+            break;
+        }
+    }
+
+    for (i = 0; i < conn->count_encoders && crtc_idx < 0; i++) {
+        enc = drmModeGetEncoder(drm.fd, conn->encoders[i]);
+        if (enc == NULL) {
+            continue;
+        }
+
+        for (j = 0; j < res->count_crtcs; j++) {
+            if (enc->possible_crtcs & (1u << j)) {
+                crtc_idx = j;
+                break;
+            }
+        }
+        drmModeFreeEncoder(enc);
+    }
+
+    drmModeFreeConnector(conn);
+
+    if (crtc_idx < 0) {
+        LV_LOG_ERROR("No CRTC for the connector");
+        drmModeFreeResources(res);
+        return -1;
+    }
+
+    drm.crtc_id = res->crtcs[crtc_idx];
+    drmModeFreeResources(res);
+
+    planes = drmModeGetPlaneResources(drm.fd);
+    for (i = 0; planes != NULL && i < (int)planes->count_planes && drm.plane_id == 0; i++) {
+        plane = drmModeGetPlane(drm.fd, planes->planes[i]);
+
+        if (plane != NULL && (plane->possible_crtcs & (1u << crtc_idx)) &&
+            find_prop(plane->plane_id, DRM_MODE_OBJECT_PLANE, "type", &type) != 0 &&
+            type == DRM_PLANE_TYPE_PRIMARY) {
+            drm.plane_id = plane->plane_id;
+            drm.native = has_format(plane, DRM_ATOMIC_FOURCC);
+        }
+
+        drmModeFreePlane(plane);
+    }
+    drmModeFreePlaneResources(planes);
+
+    if (drm.plane_id == 0) {
+        LV_LOG_ERROR("No primary plane for the CRTC");
+        return -1;
+    }
+
+    return 0;
+}
+
+static bool has_format(const drmModePlane *plane, uint32_t fourcc)
+{
+    uint32_t i;
+
+    for (i = 0; i < plane->count_formats; i++) {
+        if (plane->formats[i] == fourcc) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Look up a property of a KMS object
+ * @return the id of the property, 0 if the object does not have it
+ */
+static uint32_t find_prop(uint32_t obj_id, uint32_t obj_type, const char *name, uint64_t *value)
+{
+    drmModeObjectProperties *props;
+    drmModePropertyRes *prop;
+    uint32_t id = 0;
+    uint32_t i;
+
+    props = drmModeObjectGetProperties(drm.fd, obj_id, obj_type);
+    if (props == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < props->count_props && id == 0; i++) {
+        prop = drmModeGetProperty(drm.fd, props->props[i]);
+
+        if (prop != NULL && strcmp(prop->name, name) == 0) {
+            id = prop->prop_id;
+            if (value != NULL) {
+                *value = props->prop_values[i];
+            }
+        }
+
+        drmModeFreeProperty(prop);
+    }
+
+    drmModeFreeObjectProperties(props);
+    return id;
+}
+
+static int find_props(void)
+{
+    drm_props_t *p = &drm.props;
+
+    p->conn_crtc_id = find_prop(drm.conn_id, DRM_MODE_OBJECT_CONNECTOR, "CRTC_ID", NULL);
+    p->crtc_mode_id = find_prop(drm.crtc_id, DRM_MODE_OBJECT_CRTC, "MODE_ID", NULL);
+    p->crtc_active = find_prop(drm.crtc_id, DRM_MODE_OBJECT_CRTC, "ACTIVE", NULL);
+    p->plane_fb_id = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "FB_ID", NULL);
+    p->plane_crtc_id = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_ID", NULL);
+    p->plane_src_x = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "SRC_X", NULL);
+    p->plane_src_y = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "SRC_Y", NULL);
+    p->plane_src_w = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "SRC_W", NULL);
+    p->plane_src_h = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "SRC_H", NULL);
+    p->plane_crtc_x = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_X", NULL);
+    p->plane_crtc_y = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_Y", NULL);
+    p->plane_crtc_w = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_W", NULL);
+    p->plane_crtc_h = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_H", NULL);
+    p->plane_damage_clips = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "FB_DAMAGE_CLIPS", NULL);
+    p->plane_rotation = find_prop(drm.plane_id, DRM_MODE_OBJECT_PLANE, "rotation", NULL);
+
+    if (p->conn_crtc_id == 0 || p->crtc_mode_id == 0 || p->crtc_active == 0 ||
+        p->plane_fb_id == 0 || p->plane_crtc_id == 0 ||
+        p->plane_src_x == 0 || p->plane_src_y == 0 || p->plane_src_w == 0 || p->plane_src_h == 0 ||
+        p->plane_crtc_x == 0 || p->plane_crtc_y == 0 || p->plane_crtc_w == 0 || p->plane_crtc_h == 0) {
+        LV_LOG_ERROR("Missing atomic KMS properties");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Check that the plane can apply a rotation
+ * @description the rotations of LVGL and DRM are both counter-clockwise
+ * @return the DRM_MODE_ROTATE_* value, 0 if the plane does not support it
+ */
+static uint64_t find_rotation(lv_display_rotation_t rotation)
+{
+    drmModePropertyRes *prop;
+    uint64_t value;
+    uint64_t found = 0;
+    int i;
+
+    switch (rotation) {
+    case LV_DISPLAY_ROTATION_90:
+        value = DRM_MODE_ROTATE_90;
+        break;
+    case LV_DISPLAY_ROTATION_180:
+        value = DRM_MODE_ROTATE_180;
+        break;
+    case LV_DISPLAY_ROTATION_270:
+        value = DRM_MODE_ROTATE_270;
+        break;
+    default:
+        return 0;
+    }
+
+    if (drm.props.plane_rotation == 0) {
+        return 0;
+    }
+
+    /* The values of a bitmask property are bit numbers */
+    prop = drmModeGetProperty(drm.fd, drm.props.plane_rotation);
+    for (i = 0; prop != NULL && i < prop->count_enums; i++) {
+        if ((1ull << prop->enums[i].value) == value) {
+            found = value;
+        }
+    }
+
+    drmModeFreeProperty(prop);
+    return found;
+}
+
+static int create_buffer(drm_buffer_t *buf, uint32_t w, uint32_t h)
+{
+    struct drm_mode_create_dumb create;
+    struct drm_mode_map_dumb map;
+    uint32_t handles[4] = {0};
+    uint32_t pitches[4] = {0};
+    uint32_t offsets[4] = {0};
+    void *addr;
+
+    memset(&create, 0, sizeof(create));
+    create.width = w;
+    create.height = h;
+    create.bpp = drm.bpp;
+
+    if (drmIoctl(drm.fd, DRM_IOCTL_MODE_CREATE_DUMB, &create) != 0) {
+        LV_LOG_ERROR("Failed to create a dumb buffer: %s", strerror(errno));
+        return -1;
+    }
+
+    buf->handle = create.handle;
+    buf->pitch = create.pitch;
+    buf->size = create.size;
+
+    handles[0] = buf->handle;
+    pitches[0] = buf->pitch;
+
+    if (drmModeAddFB2(drm.fd, w, h, drm.fourcc, handles, pitches, offsets, &buf->fb_id, 0) != 0) {
+        LV_LOG_ERROR("Failed to add a framebuffer: %s", strerror(errno));
+        return -1;
+    }
+
+    memset(&map, 0, sizeof(map));
+    map.handle = buf->handle;
+
+    if (drmIoctl(drm.fd, DRM_IOCTL_MODE_MAP_DUMB, &map) != 0) {
+        LV_LOG_ERROR("Failed to map a dumb buffer: %s", strerror(errno));
+        return -1;
+    }
+
+    addr = mmap(NULL, buf->size, PROT_READ | PROT_WRITE, MAP_SHARED, drm.fd, (off_t)map.offset);
+    if (addr == MAP_FAILED) {
+        LV_LOG_ERROR("Failed to map a dumb buffer: %s", strerror(errno));
+        return -1;
+    }
+
+    buf->map = addr;
+    memset(buf->map, 0, buf->size);
+
+    /* Rendered into only without conversion */
+    lv_draw_buf_init(&buf->draw_buf, w, h, DRM_ATOMIC_CF, buf->pitch, buf->map, (uint32_t)buf->size);
+
+    return 0;
+}
+
+static void destroy_buffer(drm_buffer_t *buf)
+{
+    struct drm_mode_destroy_dumb destroy;
+
+    if (buf->map != NULL) {
+        munmap(buf->map, buf->size);
+    }
+
+    if (buf->fb_id != 0) {
+        drmModeRmFB(drm.fd, buf->fb_id);
+    }
+
+    if (buf->handle != 0) {
+        memset(&destroy, 0, sizeof(destroy));
+        destroy.handle = buf->handle;
+        drmIoctl(drm.fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+    }
+
+    memset(buf, 0, sizeof(*buf));
+}
+
+/**
+ * Add a rendered area to the clips of the next commit
+ */
+static void add_clip(const lv_area_t *area)
+{
+    struct drm_mode_rect *clip;
+
+    if (drm.clip_count == DRM_ATOMIC_MAX_CLIPS) {
+        drm.clips_overflow = true;
+        return;
+    }
+
+    /* The rectangles of the kernel are exclusive of x2 and y2 */
+    clip = &drm.clips[drm.clip_count++];
+    clip->x1 = area->x1;
+    clip->y1 = area->y1;
+    clip->x2 = area->x2 + 1;
+    clip->y2 = area->y2 + 1;
+}
+
+/**
+ * Commit a buffer, the flip completes with a page flip event
+ * @return 0 on success, -1 with errno set on error
+ */
+static int submit(int32_t idx)
+{
+    drmModeAtomicReq *req;
+    uint32_t flags = DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT;
+    uint32_t blob = 0;
+    uint32_t w = drm.mode.hdisplay;
+    uint32_t h = drm.mode.vdisplay;
+    int ret;
+
+    req = drmModeAtomicAlloc();
+    if (req == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (!drm.modeset) {
+        drmModeAtomicAddProperty(req, drm.conn_id, drm.props.conn_crtc_id, drm.crtc_id);
+        drmModeAtomicAddProperty(req, drm.crtc_id, drm.props.crtc_mode_id, drm.mode_blob);
+        drmModeAtomicAddProperty(req, drm.crtc_id, drm.props.crtc_active, 1);
+        drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_crtc_id, drm.crtc_id);
+        drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_src_x, 0);
+        drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_src_y, 0);
+        drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_src_w, (uint64_t)drm.fb_w << 16);
+        drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_src_h, (uint64_t)drm.fb_h << 16);
+        drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_crtc_x, 0);
+        drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_crtc_y, 0);
+        drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_crtc_w, w);
+        drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_crtc_h, h);
+        if (drm.hw_rotation != 0) {
+            drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_rotation, drm.hw_rotation);
+        }
+        flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+    }
+
+    drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_fb_id, drm.bufs[idx].fb_id);
+
+    /* Without clips the driver considers the whole plane as damaged */
+    if (drm.modeset && drm.props.plane_damage_clips != 0 && !drm.clips_overflow && drm.clip_count > 0 &&
+        drmModeCreatePropertyBlob(drm.fd, drm.clips, sizeof(drm.clips[0]) * drm.clip_count, &blob) == 0) {
+        drmModeAtomicAddProperty(req, drm.plane_id, drm.props.plane_damage_clips, blob);
+    }
+
+    ret = drmModeAtomicCommit(drm.fd, req, flags, &drm.bufs[idx]);
+    drmModeAtomicFree(req);
+
+    /* The commit holds its own reference on the blob */
+    if (blob != 0) {
+        drmModeDestroyPropertyBlob(drm.fd, blob);
+    }
+
+    if (ret != 0) {
+        return -1;
+    }
+
+    drm.modeset = true;
+    drm.pending = idx;
+    drm.clip_count = 0;
+    drm.clips_overflow = false;
+
+    return 0;
+}
+
+/**
+ * Commit the queued frame unless a flip is in flight
+ * @description a commit refused with EBUSY is retried by the retry timer,
+ * an idle UI would otherwise never show its last frame
+ */
+static void submit_queued(void)
+{
+    if (drm.queued < 0 || drm.pending >= 0) {
+        return;
+    }
+
+    if (submit(drm.queued) == 0) {
+        drm.queued = -1;
+        lv_timer_pause(drm.retry_timer);
+    } else if (errno == EBUSY) {
+        lv_timer_resume(drm.retry_timer);
+    } else {
+        LV_LOG_ERROR("Atomic commit failed: %s", strerror(errno));
+        drm.queued = -1;
+        lv_timer_pause(drm.retry_timer);
+    }
+}
+
+static void retry_timer_cb(lv_timer_t *timer)
+{
+    LV_UNUSED(timer);
+
+    /* Paused while a flip is in flight, its completion commits the frame */
+    if (drm.queued < 0 || drm.pending >= 0) {
+        lv_timer_pause(drm.retry_timer);
+        return;
+    }
+
+    submit_queued();
+}
+
+static void flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    lv_area_t fb_area;
+
+    LV_UNUSED(px_map);
+
+    /* Only the rendered areas are copied into the dumb buffer */
+    if (drm.shadow != NULL) {
+        pixel_rotate_area(&drm.rot, area);
+        pixel_rotate_get_area(&drm.rot, area, &fb_area);
+        area = &fb_area;
+    }
+
+    damage_tracker_add(&drm.damage, (uint32_t)drm.render, area);
+    add_clip(area);
+
+    if (!lv_display_flush_is_last(disp)) {
+        lv_display_flush_ready(disp);
+        return;
+    }
+
+    drm.latest = drm.render;
+
+    /* One flip at a time, the frame is committed when the pending one completes */
+    drm.queued = drm.render;
+    submit_queued();
+
+    /* The next frame is rendered into another buffer, no need to wait for the flip */
+    lv_display_flush_ready(disp);
+}
+
+/**
+ * Select the buffer of the frame about to be rendered
+ */
+static void render_start_cb(lv_event_t *e)
+{
+    drm_buffer_t *latest;
+    drm_buffer_t *buf;
+    int32_t idx;
+
+    LV_UNUSED(e);
+
+    if (update_shadow() != 0) {
+        LV_LOG_ERROR("Failed to allocate the shadow buffer");
+    }
+
+    if (drm.queued >= 0) {
+        /* The queued frame was not shown yet, it is replaced */
+        idx = drm.queued;
+        drm.queued = -1;
+    } else {
+        for (idx = 0; idx < DRM_ATOMIC_BUFFERS; idx++) {
+            if (idx != drm.front && idx != drm.pending) {
+                break;
+            }
+        }
+    }
+
+    buf = &drm.bufs[idx];
+
+    if (drm.latest >= 0 && drm.latest != idx) {
+        latest = &drm.bufs[drm.latest];
+        damage_tracker_sync(&drm.damage, (uint32_t)idx, buf->map, latest->map, buf->pitch,
+                            drm.bpp / 8);
+    }
+
+    drm.render = idx;
+
+    /* The shadow buffer always holds the whole frame */
+    if (drm.shadow == NULL) {
+        lv_display_set_draw_buffers(drm.disp, &buf->draw_buf, NULL);
+    } else {
+        drm.rot.dst = buf->map;
+    }
+}
+
+/**
+ * Render into a shadow buffer when the frames are converted or rotated
+ * by software, the rotation is set by the caller after the creation
+ */
+static int update_shadow(void)
+{
+    lv_display_rotation_t rotation = lv_display_get_rotation(drm.disp);
+    bool needed = drm.convert != NULL || rotation != LV_DISPLAY_ROTATION_0;
+    uint32_t w = (uint32_t)lv_display_get_horizontal_resolution(drm.disp);
+    uint32_t h = (uint32_t)lv_display_get_vertical_resolution(drm.disp);
+
+    if (drm.shadow != NULL && drm.rot.rotation == rotation && drm.rot.w == w && drm.rot.h == h) {
+        return 0;
+    }
+
+    if (drm.shadow != NULL) {
+        lv_draw_buf_destroy(drm.shadow);
+        drm.shadow = NULL;
+    }
+
+    if (!needed) {
+        return 0;
+    }
+
+    drm.shadow = lv_draw_buf_create(w, h, DRM_ATOMIC_CF, 0);
+    if (drm.shadow == NULL) {
+        return -1;
+    }
+
+    drm.rot.src = drm.shadow->data;
+    drm.rot.src_stride = drm.shadow->header.stride;
+    drm.rot.src_px_size = DRM_ATOMIC_BPP / 8;
+    drm.rot.w = w;
+    drm.rot.h = h;
+    drm.rot.dst = drm.bufs[drm.render].map;
+    drm.rot.dst_stride = drm.bufs[drm.render].pitch;
+    drm.rot.dst_px_size = drm.bpp / 8;
+    drm.rot.rotation = rotation;
+    drm.rot.convert = drm.convert;
+
+    lv_display_set_draw_buffers(drm.disp, drm.shadow, NULL);
+
+    return 0;
+}
+
+static void delete_cb(lv_event_t *e)
+{
+    LV_UNUSED(e);
+    release();
+}
+
+static void page_flip_handler(int fd, unsigned int sequence, unsigned int tv_sec,
+                              unsigned int tv_usec, void *user_data)
+{
+    drm_buffer_t *buf = user_data;
+
+    LV_UNUSED(fd);
+    LV_UNUSED(sequence);
+    LV_UNUSED(tv_sec);
+    LV_UNUSED(tv_usec);
+
+    drm.front = (int32_t)(buf - drm.bufs);
+    drm.pending = -1;
+
+    submit_queued();
+}
+
+static void release(void)
+{
+    int i;
+
+    if (drm.fd < 0) {
+        return;
+    }
+
+    for (i = 0; i < DRM_ATOMIC_BUFFERS; i++) {
+        destroy_buffer(&drm.bufs[i]);
+    }
+
+    if (drm.shadow != NULL) {
+        lv_draw_buf_destroy(drm.shadow);
+    }
+
+    if (drm.retry_timer != NULL) {
+        lv_timer_delete(drm.retry_timer);
+    }
+
+    if (drm.mode_blob != 0) {
+        drmModeDestroyPropertyBlob(drm.fd, drm.mode_blob);
+    }
+
+    close(drm.fd);
+
+    memset(&drm, 0, sizeof(drm));
+    drm.fd = -1;
+}
+
+#endif /*LV_USE_LINUX_DRM*/
@@ -0,0 +1,87 @@
+/**
+ * @file drm_atomic.h
+ *
+ * DRM/KMS display driver using atomic modesetting
+ *
+ * Renders in LV_DISPLAY_RENDER_MODE_DIRECT into three dumb buffers,
+ * the areas rendered in a frame are passed to the kernel as
+ * FB_DAMAGE_CLIPS and the page flips are non blocking. The flip
+ * complete events are read by the scheduler through the fd of the card,
+ * see drm_atomic_get_fd() and drm_atomic_handle_events()
+ */
+
+#ifndef DRM_ATOMIC_H
+#define DRM_ATOMIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Create the display
+ * @description drives the first connected connector with its preferred
+ * mode, through the primary plane of a CRTC it can be connected to.
+ * With LV_COLOR_DEPTH 16 the frames are converted to XRGB8888 if the
+ * plane does not support RGB565
+ * @param device the card, i.e "/dev/dri/card0"
+ * @param xrgb8888 true to convert the frames to XRGB8888 even if the plane supports RGB565
+ * @param rotation the rotation to apply with the plane, see drm_atomic_has_hw_rotation()
+ * @return the display, NULL on error
+ */
+lv_display_t *drm_atomic_create(const char *device, bool xrgb8888, lv_display_rotation_t rotation);
+
+/**
+ * Tell if the plane applies the rotation
+ * @return false if the plane does not support the rotation, the display
+ * has to be rotated with lv_display_set_rotation() then, the rendered
+ * areas are rotated by software
+ */
+bool drm_atomic_has_hw_rotation(void);
+
+/**
+ * Get the fd of the card
+ * @return the fd the flip complete events are read from, -1 if no display was created
+ */
+int drm_atomic_get_fd(void);
+
+/**
+ * Get the CRTC driving the display
+ * @return the id of the CRTC, 0 if no display was created
+ */
+uint32_t drm_atomic_get_crtc_id(void);
+
+/**
+ * Read the pending events of the card
+ * @description completes the page flips, a frame that was rendered while
+ * a flip was in flight is committed then
+ */
+void drm_atomic_handle_events(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*DRM_ATOMIC_H*/
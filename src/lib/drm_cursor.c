@@ -0,0 +1,448 @@
+/**
+ * @file drm_cursor.c
+ *
+ * Mouse pointer on the cursor plane of a DRM CRTC
+ *
+ * The legacy cursor ioctls are used, the kernel maps them on the cursor
+ * plane and applies them without waiting for the page flips in flight.
+ * The cursor plane is not rotated with the primary plane, the icon is
+ * rotated when uploaded and the points are mapped to the CRTC.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lvgl/lvgl.h"
+
+#if LV_USE_LINUX_DRM
+#include <string.h>
+#include <sys/mman.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "drm_cursor.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Size of the cursor buffers when the driver does not report it */
+#define DRM_CURSOR_DEFAULT_SIZE     64
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* A pointer input device and its read callback */
+typedef struct {
+    lv_indev_t *indev;
+    lv_indev_read_cb_t read_cb;
+} cursor_indev_t;
+
+typedef struct {
+    int fd;
+    uint32_t crtc_id;
+    uint32_t handle;                    /* buffer holding the icon */
+    uint32_t width;
+    uint32_t height;
+    bool shown;                         /* the buffer was set on the CRTC */
+    lv_display_rotation_t rotation;     /* of the primary plane */
+    int32_t hot_x;                      /* top left corner of the icon in the buffer */
+    int32_t hot_y;
+    int32_t x;
+    int32_t y;
+    cursor_indev_t indevs[DRM_CURSOR_MAX_INDEVS];
+} drm_cursor_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static int setup(int fd, uint32_t crtc_id, const lv_image_dsc_t *icon, lv_display_rotation_t rotation);
+static int find_crtc(int *crtc_idx);
+static bool has_cursor_plane(int crtc_idx);
+static int upload(const lv_image_dsc_t *icon);
+static void rotate_point(int32_t *x, int32_t *y, int32_t w, int32_t h);
+static cursor_indev_t *find_indev(lv_indev_t *indev);
+static void read_cb(lv_indev_t *indev, lv_indev_data_t *data);
+static void indev_deleted_cb(lv_event_t *e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static drm_cursor_t cursor = {.fd = -1};
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+bool drm_cursor_attach(int fd, uint32_t crtc_id, lv_indev_t *indev, const lv_image_dsc_t *icon,
+                       lv_display_rotation_t rotation)
+{
+    cursor_indev_t *ci;
+
+    if (lv_indev_get_type(indev) != LV_INDEV_TYPE_POINTER) {
+        return false;
+    }
+
+    if (cursor.fd < 0 && setup(fd, crtc_id, icon, rotation) != 0) {
+        return false;
+    }
+
+    ci = find_indev(NULL);
+    if (ci == NULL) {
+        return false;
+    }
+
+    /* The position is taken from the data returned by the driver */
+    ci->indev = indev;
+    ci->read_cb = lv_indev_get_read_cb(indev);
+    lv_indev_set_read_cb(indev, read_cb);
+    lv_indev_add_event_cb(indev, indev_deleted_cb, LV_EVENT_DELETE, NULL);
+
+    return true;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static int setup(int fd, uint32_t crtc_id, const lv_image_dsc_t *icon, lv_display_rotation_t rotation)
+{
+    drmModeRes *res;
+    int crtc_idx = -1;
+    int i;
+
+    if (icon->header.cf != LV_COLOR_FORMAT_ARGB8888) {
+        return -1;
+    }
+
+    /* The cursor planes are listed only to the clients asking for all the planes */
+    drmSetClientCap(fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1);
+
+    cursor.fd = fd;
+    cursor.crtc_id = crtc_id;
+    cursor.rotation = rotation;
+
+    if (crtc_id == 0) {
+        if (find_crtc(&crtc_idx) != 0) {
+            goto err;
+        }
+    } else {
+        res = drmModeGetResources(fd);
+        for (i = 0; res != NULL && i < res->count_crtcs; i++) {
+            if (res->crtcs[i] == crtc_id) {
+                crtc_idx = i;
+            }
+        }
+        drmModeFreeResources(res);
+    }
+
+    if (crtc_idx < 0 || !has_cursor_plane(crtc_idx)) {
+        LV_LOG_WARN("No cursor plane, the cursor is drawn by LVGL");
+        goto err;
+    }
+
+    if (upload(icon) != 0) {
+        goto err;
+    }
+
+    LV_LOG_USER("Cursor shown on the cursor plane of CRTC %u", (unsigned)cursor.crtc_id);
+    return 0;
+
+err:
+    memset(&cursor, 0, sizeof(cursor));
+    cursor.fd = -1;
+    return -1;
+}
+
+/**
+ * Find the first CRTC scanning out a framebuffer, or the first CRTC when
+ * the display is not enabled yet
+ */
+static int find_crtc(int *crtc_idx)
+{
+    drmModeCrtc *crtc;
+    drmModeRes *res;
+    int i;
+
+    res = drmModeGetResources(cursor.fd);
+    if (res == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < res->count_crtcs && cursor.crtc_id == 0; i++) {
+        crtc = drmModeGetCrtc(cursor.fd, res->crtcs[i]);
+
+        if (crtc != NULL && crtc->mode_valid && crtc->buffer_id != 0) {
+            cursor.crtc_id = crtc->crtc_id;
+            *crtc_idx = i;
+        }
+
+        drmModeFreeCrtc(crtc);
+    }
+
+    if (cursor.crtc_id == 0 && res->count_crtcs > 0) {
+        cursor.crtc_id = res->crtcs[0];
+        *crtc_idx = 0;
+    }
+
+    drmModeFreeResources(res);
+    return cursor.crtc_id != 0 ? 0 : -1;
+}
+
+static bool has_cursor_plane(int crtc_idx)
+{
+    drmModeObjectProperties *props;
+    drmModePropertyRes *prop;
+    drmModePlaneRes *planes;
+    drmModePlane *plane;
+    bool found = false;
+    uint32_t i;
+    uint32_t j;
+
+    planes = drmModeGetPlaneResources(cursor.fd);
+
+    for (i = 0; planes != NULL && i < planes->count_planes && !found; i++) {
+        plane = drmModeGetPlane(cursor.fd, planes->planes[i]);
+
+        if (plane == NULL || !(plane->possible_crtcs & (1u << crtc_idx))) {
+            drmModeFreePlane(plane);
+            continue;
+        }
+
+        props = drmModeObjectGetProperties(cursor.fd, plane->plane_id, DRM_MODE_OBJECT_PLANE);
+        for (j = 0; props != NULL && j < props->count_props; j++) {
+            prop = drmModeGetProperty(cursor.fd, props->props[j]);
+
+            if (prop != NULL && strcmp(prop->name, "type") == 0 &&
+                props->prop_values[j] == DRM_PLANE_TYPE_CURSOR) {
+                found = true;
+            }
+
+            drmModeFreeProperty(prop);
+        }
+
+        drmModeFreeObjectProperties(props);
+        drmModeFreePlane(plane);
+    }
+
+    drmModeFreePlaneResources(planes);
+    return found;
+}
+
+/**
+ * Copy the icon into a buffer of the size of the cursor plane
+ * @description the icon is rotated like the primary plane, so that it is
+ * upright on the screen
+ */
+static int upload(const lv_image_dsc_t *icon)
+{
+    struct drm_mode_create_dumb create;
+    struct drm_mode_map_dumb map;
+    uint64_t width = DRM_CURSOR_DEFAULT_SIZE;
+    uint64_t height = DRM_CURSOR_DEFAULT_SIZE;
+    uint8_t *pixels;
+    const uint8_t *src;
+    uint32_t icon_w = icon->header.w;
+    uint32_t icon_h = icon->header.h;
+    int32_t bx;
+    int32_t by;
+    uint32_t x;
+    uint32_t y;
+
+    drmGetCap(cursor.fd, DRM_CAP_CURSOR_WIDTH, &width);
+    drmGetCap(cursor.fd, DRM_CAP_CURSOR_HEIGHT, &height);
+
+    if (cursor.rotation == LV_DISPLAY_ROTATION_90 || cursor.rotation == LV_DISPLAY_ROTATION_270) {
+        icon_w = icon->header.h;
+        icon_h = icon->header.w;
+    }
+
+    if (icon_w > width || icon_h > height) {
+        LV_LOG_WARN("The cursor icon does not fit in the %ux%u cursor plane", (unsigned)width, (unsigned)height);
+        return -1;
+    }
+
+    memset(&create, 0, sizeof(create));
+    create.width = (uint32_t)width;
+    create.height = (uint32_t)height;
+    create.bpp = 32;
+
+    if (drmIoctl(cursor.fd, DRM_IOCTL_MODE_CREATE_DUMB, &create) != 0) {
+        return -1;
+    }
+
+    memset(&map, 0, sizeof(map));
+    map.handle = create.handle;
+
+    if (drmIoctl(cursor.fd, DRM_IOCTL_MODE_MAP_DUMB, &map) != 0) {
+        goto err;
+    }
+
+    pixels = mmap(NULL, create.size, PROT_READ | PROT_WRITE, MAP_SHARED, cursor.fd, (off_t)map.offset);
+    if (pixels == MAP_FAILED) {
+        goto err;
+    }
+
+    /* LV_COLOR_FORMAT_ARGB8888 has the layout of DRM_FORMAT_ARGB8888 */
+    memset(pixels, 0, create.size);
+    for (y = 0; y < icon->header.h; y++) {
+        src = icon->data + y * icon->header.stride;
+
+        if (cursor.rotation == LV_DISPLAY_ROTATION_0) {
+            memcpy(pixels + y * create.pitch, src, icon->header.w * 4u);
+            continue;
+        }
+
+        for (x = 0; x < icon->header.w; x++) {
+            bx = (int32_t)x;
+            by = (int32_t)y;
+            rotate_point(&bx, &by, icon->header.w, icon->header.h);
+            memcpy(pixels + (uint32_t)by * create.pitch + (uint32_t)bx * 4u, src + x * 4u, 4);
+        }
+    }
+
+    /* The pointer is at the top left corner of the icon */
+    cursor.hot_x = 0;
+    cursor.hot_y = 0;
+    rotate_point(&cursor.hot_x, &cursor.hot_y, icon->header.w, icon->header.h);
+
+    munmap(pixels, create.size);
+
+    cursor.handle = create.handle;
+    cursor.width = create.width;
+    cursor.height = create.height;
+
+    return 0;
+
+err:
+    {
+        struct drm_mode_destroy_dumb destroy = {.handle = create.handle};
+        drmIoctl(cursor.fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+    }
+    return -1;
+}
+
+static cursor_indev_t *find_indev(lv_indev_t *indev)
+{
+    uint32_t i;
+
+    for (i = 0; i < DRM_CURSOR_MAX_INDEVS; i++) {
+        if (cursor.indevs[i].indev == indev) {
+            return &cursor.indevs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Map a point of an unrotated area to the CRTC, through the rotation of the primary plane
+ * @description the inverse of the rotation of the pointers, see
+ * indev_pointer_proc() of LVGL
+ * @param x the x coordinate, updated
+ * @param y the y coordinate, updated
+ * @param w the width of the area on the screen
+ * @param h the height of the area on the screen
+ */
+static void rotate_point(int32_t *x, int32_t *y, int32_t w, int32_t h)
+{
+    int32_t tmp;
+
+    switch (cursor.rotation) {
+    case LV_DISPLAY_ROTATION_90:
+        tmp = *x;
+        *x = *y;
+        *y = w - tmp - 1;
+        break;
+    case LV_DISPLAY_ROTATION_180:
+        *x = w - *x - 1;
+        *y = h - *y - 1;
+        break;
+    case LV_DISPLAY_ROTATION_270:
+        tmp = *x;
+        *x = h - *y - 1;
+        *y = tmp;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Read the pointer with the driver, then move the cursor plane
+ */
+static void read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    cursor_indev_t *ci = find_indev(indev);
+    lv_display_t *disp;
+    int32_t x;
+    int32_t y;
+
+    if (ci == NULL || ci->read_cb == NULL) {
+        return;
+    }
+
+    ci->read_cb(indev, data);
+
+    if (!cursor.shown) {
+        /* Fails until the CRTC is enabled by the first frame */
+        if (drmModeSetCursor(cursor.fd, cursor.crtc_id, cursor.handle, cursor.width, cursor.height) != 0) {
+            return;
+        }
+        cursor.shown = true;
+        cursor.x = cursor.y = INT32_MIN;
+    }
+
+    x = data->point.x;
+    y = data->point.y;
+
+    if (cursor.rotation != LV_DISPLAY_ROTATION_0) {
+        disp = lv_indev_get_display(indev);
+        if (disp == NULL) {
+            disp = lv_display_get_default();
+        }
+        rotate_point(&x, &y, lv_display_get_horizontal_resolution(disp),
+                     lv_display_get_vertical_resolution(disp));
+    }
+
+    x -= cursor.hot_x;
+    y -= cursor.hot_y;
+
+    if (x != cursor.x || y != cursor.y) {
+        cursor.x = x;
+        cursor.y = y;
+        drmModeMoveCursor(cursor.fd, cursor.crtc_id, cursor.x, cursor.y);
+    }
+}
+
+static void indev_deleted_cb(lv_event_t *e)
+{
+    cursor_indev_t *ci = find_indev(lv_event_get_target(e));
+    uint32_t i;
+
+    if (ci == NULL) {
+        return;
+    }
+
+    ci->indev = NULL;
+    ci->read_cb = NULL;
+
+    /* Hide the cursor with the last pointer */
+    for (i = 0; i < DRM_CURSOR_MAX_INDEVS; i++) {
+        if (cursor.indevs[i].indev != NULL) {
+            return;
+        }
+    }
+
+    if (cursor.shown) {
+        drmModeSetCursor(cursor.fd, cursor.crtc_id, 0, 0, 0);
+        cursor.shown = false;
+    }
+}
+
+#endif /*LV_USE_LINUX_DRM*/
@@ -0,0 +1,62 @@
+/**
+ * @file drm_cursor.h
+ *
+ * Mouse pointer on the cursor plane of a DRM CRTC
+ *
+ * The icon is uploaded once, a pointer motion only updates the position
+ * of the plane, nothing is rendered.
+ */
+
+#ifndef DRM_CURSOR_H
+#define DRM_CURSOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Pointer input devices that can share the cursor */
+#define DRM_CURSOR_MAX_INDEVS   4
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Show the cursor of a pointer input device on the cursor plane
+ * @param fd the fd of the card
+ * @param crtc_id the CRTC of the display, 0 to use the first active one
+ * @param indev the pointer input device
+ * @param icon the cursor icon, in LV_COLOR_FORMAT_ARGB8888
+ * @param rotation the rotation of the primary plane, the points of the
+ * input device are in the rotated coordinates of the display
+ * @return false if the CRTC has no cursor plane or the icon does not fit
+ * in it, the cursor has to be drawn by LVGL then
+ */
+bool drm_cursor_attach(int fd, uint32_t crtc_id, lv_indev_t *indev, const lv_image_dsc_t *icon,
+                       lv_display_rotation_t rotation);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*DRM_CURSOR_H*/
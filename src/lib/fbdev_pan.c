@@ -0,0 +1,398 @@
+/**
+ * @file fbdev_pan.c
+ *
+ * Double buffered framebuffer device
+ *
+ * The two halves of the virtual framebuffer take turns being shown,
+ * the panning is requested with FB_ACTIVATE_VBL so that the drivers
+ * supporting it switch the halves during the vertical blanking. The half
+ * shown before is only handed back to LVGL after FBIO_WAITFORVSYNC, it
+ * is scanned out until then. Without FBIO_WAITFORVSYNC the device is not
+ * used, the caller falls back to a single buffer.
+ *
+ * A rotated display is rendered into a shadow buffer, the rendered
+ * areas are rotated into the half at flush time.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lvgl/lvgl.h"
+
+#if LV_USE_LINUX_FBDEV
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fb.h>
+
+#include "damage.h"
+#include "fbdev_pan.h"
+#include "pixel_rotate.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define FBDEV_PAN_BUFFERS   2
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    int fd;
+    lv_display_t *disp;
+    struct fb_var_screeninfo orig;      /* restored on exit, for the console */
+    struct fb_var_screeninfo var;
+    uint32_t stride;
+    uint32_t px_size;
+    uint8_t *map;
+    size_t map_size;
+    lv_draw_buf_t bufs[FBDEV_PAN_BUFFERS];
+    uint32_t front;                     /* index of the half shown */
+    uint32_t render;                    /* being rendered */
+    damage_tracker_t damage;
+    lv_draw_buf_t *shadow;              /* rendered into when rotating, NULL otherwise */
+    pixel_rotate_t rot;                 /* from the shadow buffer to the half rendered */
+} fbdev_pan_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static lv_color_format_t get_color_format(uint32_t bpp);
+static int pan(uint32_t idx);
+static int wait_vsync(void);
+static void flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void render_start_cb(lv_event_t *e);
+static void resolution_changed_cb(lv_event_t *e);
+static int update_shadow(void);
+static void delete_cb(lv_event_t *e);
+static void release(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static fbdev_pan_t fb = {.fd = -1};
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+lv_display_t *fbdev_pan_create(const char *device)
+{
+    struct fb_fix_screeninfo fix;
+    lv_color_format_t cf;
+    uint32_t w;
+    uint32_t h;
+    void *addr;
+    int i;
+
+    if (fb.fd >= 0) {
+        LV_LOG_ERROR("Only one panned fbdev display is supported");
+        return NULL;
+    }
+
+    fb.fd = open(device, O_RDWR | O_CLOEXEC);
+    if (fb.fd < 0) {
+        LV_LOG_ERROR("Failed to open %s: %s", device, strerror(errno));
+        return NULL;
+    }
+
+    if (ioctl(fb.fd, FBIOGET_VSCREENINFO, &fb.orig) != 0) {
+        LV_LOG_ERROR("Failed to get the screen info of %s: %s", device, strerror(errno));
+        goto err_close;
+    }
+
+    w = fb.orig.xres;
+    h = fb.orig.yres;
+    cf = get_color_format(fb.orig.bits_per_pixel);
+
+    if (cf == LV_COLOR_FORMAT_UNKNOWN) {
+        LV_LOG_ERROR("%u bits per pixel are not supported", (unsigned)fb.orig.bits_per_pixel);
+        goto err_close;
+    }
+
+    /* Ask for two screens stacked vertically */
+    fb.var = fb.orig;
+    fb.var.xres_virtual = w;
+    fb.var.yres_virtual = h * FBDEV_PAN_BUFFERS;
+    fb.var.xoffset = 0;
+    fb.var.yoffset = 0;
+    fb.var.activate = FB_ACTIVATE_NOW;
+
+    if (ioctl(fb.fd, FBIOPUT_VSCREENINFO, &fb.var) != 0 ||
+        ioctl(fb.fd, FBIOGET_VSCREENINFO, &fb.var) != 0 ||
+        fb.var.yres_virtual < h * FBDEV_PAN_BUFFERS) {
+        LV_LOG_WARN("%s can not hold %d screens", device, FBDEV_PAN_BUFFERS);
+        goto err_restore;
+    }
+
+    /* The line length may change with the virtual resolution */
+    if (ioctl(fb.fd, FBIOGET_FSCREENINFO, &fix) != 0 || fix.ypanstep == 0) {
+        LV_LOG_WARN("%s does not support panning", device);
+        goto err_restore;
+    }
+
+    /* Without it the next frame would be rendered into the half still scanned out */
+    if (wait_vsync() != 0) {
+        LV_LOG_WARN("%s does not support FBIO_WAITFORVSYNC", device);
+        goto err_restore;
+    }
+
+    fb.stride = fix.line_length;
+    fb.px_size = fb.var.bits_per_pixel / 8;
+    fb.map_size = (size_t)fb.stride * h * FBDEV_PAN_BUFFERS;
+
+    if (fb.map_size > fix.smem_len) {
+        LV_LOG_WARN("%s has %u bytes of video memory, %zu are needed", device, (unsigned)fix.smem_len, fb.map_size);
+        goto err_restore;
+    }
+
+    addr = mmap(NULL, fb.map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fb.fd, 0);
+    if (addr == MAP_FAILED) {
+        LV_LOG_ERROR("Failed to map %s: %s", device, strerror(errno));
+        goto err_restore;
+    }
+
+    fb.map = addr;
+    memset(fb.map, 0, fb.map_size);
+
+    for (i = 0; i < FBDEV_PAN_BUFFERS; i++) {
+        lv_draw_buf_init(&fb.bufs[i], w, h, cf, fb.stride, fb.map + (size_t)fb.stride * h * i,
+                         fb.stride * h);
+    }
+
+    damage_tracker_init(&fb.damage, FBDEV_PAN_BUFFERS, h);
+    fb.front = 0;
+    fb.render = 1;
+
+    ioctl(fb.fd, FBIOBLANK, FB_BLANK_UNBLANK);
+    pan(fb.front);
+
+    fb.disp = lv_display_create((int32_t)w, (int32_t)h);
+    if (fb.disp == NULL) {
+        goto err_unmap;
+    }
+
+    lv_display_set_color_format(fb.disp, cf);
+    lv_display_set_draw_buffers(fb.disp, &fb.bufs[fb.render], NULL);
+    lv_display_set_render_mode(fb.disp, LV_DISPLAY_RENDER_MODE_DIRECT);
+    lv_display_set_flush_cb(fb.disp, flush_cb);
+    lv_display_add_event_cb(fb.disp, render_start_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(fb.disp, resolution_changed_cb, LV_EVENT_RESOLUTION_CHANGED, NULL);
+    lv_display_add_event_cb(fb.disp, delete_cb, LV_EVENT_DELETE, NULL);
+
+    LV_LOG_USER("Panned fbdev display %ux%u, %u bpp", (unsigned)w, (unsigned)h,
+                (unsigned)fb.var.bits_per_pixel);
+
+    return fb.disp;
+
+err_unmap:
+    munmap(fb.map, fb.map_size);
+    fb.map = NULL;
+
+err_restore:
+    ioctl(fb.fd, FBIOPUT_VSCREENINFO, &fb.orig);
+
+err_close:
+    close(fb.fd);
+    memset(&fb, 0, sizeof(fb));
+    fb.fd = -1;
+    return NULL;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static lv_color_format_t get_color_format(uint32_t bpp)
+{
+    switch (bpp) {
+    case 16:
+        return LV_COLOR_FORMAT_RGB565;
+    case 24:
+        return LV_COLOR_FORMAT_RGB888;
+    case 32:
+        return LV_COLOR_FORMAT_XRGB8888;
+    default:
+        return LV_COLOR_FORMAT_UNKNOWN;
+    }
+}
+
+/**
+ * Show a half of the virtual framebuffer
+ * @return 0 on success, -1 with errno set on error
+ */
+static int pan(uint32_t idx)
+{
+    fb.var.xoffset = 0;
+    fb.var.yoffset = fb.var.yres * idx;
+    fb.var.activate = FB_ACTIVATE_VBL;
+
+    return ioctl(fb.fd, FBIOPAN_DISPLAY, &fb.var);
+}
+
+/**
+ * Wait for the next vertical blanking of the first CRTC
+ * @return 0 on success, -1 with errno set on error
+ */
+static int wait_vsync(void)
+{
+    uint32_t crtc = 0;
+
+    return ioctl(fb.fd, FBIO_WAITFORVSYNC, &crtc);
+}
+
+static void flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    lv_area_t fb_area;
+
+    LV_UNUSED(px_map);
+
+    /* Only the rendered areas are rotated into the half */
+    if (fb.shadow != NULL) {
+        pixel_rotate_area(&fb.rot, area);
+        pixel_rotate_get_area(&fb.rot, area, &fb_area);
+        area = &fb_area;
+    }
+
+    damage_tracker_add(&fb.damage, fb.render, area);
+
+    if (!lv_display_flush_is_last(disp)) {
+        lv_display_flush_ready(disp);
+        return;
+    }
+
+    if (pan(fb.render) != 0) {
+        LV_LOG_ERROR("FBIOPAN_DISPLAY failed: %s", strerror(errno));
+    } else {
+        fb.front = fb.render;
+
+        /* The pan applies at the vblank, the previous half is scanned out until then */
+        if (wait_vsync() != 0) {
+            LV_LOG_ERROR("FBIO_WAITFORVSYNC failed: %s", strerror(errno));
+        }
+    }
+
+    lv_display_flush_ready(disp);
+}
+
+/**
+ * Select the half the frame about to be rendered goes into
+ */
+static void render_start_cb(lv_event_t *e)
+{
+    uint32_t idx = (fb.front + 1) % FBDEV_PAN_BUFFERS;
+
+    LV_UNUSED(e);
+
+    if (update_shadow() != 0) {
+        LV_LOG_ERROR("Failed to allocate the shadow buffer");
+    }
+
+    /* The half is one frame behind, it gets the areas of the frame shown */
+    damage_tracker_sync(&fb.damage, idx, fb.bufs[idx].data, fb.bufs[fb.front].data, fb.stride, fb.px_size);
+
+    fb.render = idx;
+
+    /* The shadow buffer always holds the whole frame */
+    if (fb.shadow == NULL) {
+        lv_display_set_draw_buffers(fb.disp, &fb.bufs[idx], NULL);
+    } else {
+        fb.rot.dst = fb.bufs[idx].data;
+    }
+}
+
+/**
+ * Undo the rotations the software path can not apply
+ */
+static void resolution_changed_cb(lv_event_t *e)
+{
+    LV_UNUSED(e);
+
+    if (lv_display_get_rotation(fb.disp) != LV_DISPLAY_ROTATION_0 && fb.px_size != 2 && fb.px_size != 4) {
+        LV_LOG_WARN("%u bits per pixel can not be rotated", (unsigned)fb.var.bits_per_pixel);
+        lv_display_set_rotation(fb.disp, LV_DISPLAY_ROTATION_0);
+    }
+}
+
+/**
+ * Render into a shadow buffer when the display is rotated
+ */
+static int update_shadow(void)
+{
+    lv_display_rotation_t rotation = lv_display_get_rotation(fb.disp);
+    uint32_t w = (uint32_t)lv_display_get_horizontal_resolution(fb.disp);
+    uint32_t h = (uint32_t)lv_display_get_vertical_resolution(fb.disp);
+
+    if (fb.shadow != NULL && fb.rot.rotation == rotation && fb.rot.w == w && fb.rot.h == h) {
+        return 0;
+    }
+
+    if (fb.shadow != NULL) {
+        lv_draw_buf_destroy(fb.shadow);
+        fb.shadow = NULL;
+    }
+
+    if (rotation == LV_DISPLAY_ROTATION_0) {
+        return 0;
+    }
+
+    fb.shadow = lv_draw_buf_create(w, h, lv_display_get_color_format(fb.disp), 0);
+    if (fb.shadow == NULL) {
+        return -1;
+    }
+
+    fb.rot.src = fb.shadow->data;
+    fb.rot.src_stride = fb.shadow->header.stride;
+    fb.rot.src_px_size = fb.px_size;
+    fb.rot.w = w;
+    fb.rot.h = h;
+    fb.rot.dst = fb.bufs[fb.render].data;
+    fb.rot.dst_stride = fb.stride;
+    fb.rot.dst_px_size = fb.px_size;
+    fb.rot.rotation = rotation;
+    fb.rot.convert = NULL;
+
+    lv_display_set_draw_buffers(fb.disp, fb.shadow, NULL);
+
+    return 0;
+}
+
+static void delete_cb(lv_event_t *e)
+{
+    LV_UNUSED(e);
+    release();
+}
+
+static void release(void)
+{
+    if (fb.fd < 0) {
+        return;
+    }
+
+    if (fb.map != NULL) {
+        munmap(fb.map, fb.map_size);
+    }
+
+    if (fb.shadow != NULL) {
+        lv_draw_buf_destroy(fb.shadow);
+    }
+
+    fb.orig.activate = FB_ACTIVATE_NOW;
+    ioctl(fb.fd, FBIOPUT_VSCREENINFO, &fb.orig);
+    close(fb.fd);
+
+    memset(&fb, 0, sizeof(fb));
+    fb.fd = -1;
+}
+
+#endif /*LV_USE_LINUX_FBDEV*/
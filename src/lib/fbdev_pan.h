@@ -0,0 +1,54 @@
+/**
+ * @file fbdev_pan.h
+ *
+ * Double buffered framebuffer device
+ *
+ * The virtual framebuffer is made twice the height of the panel, a frame
+ * is rendered in LV_DISPLAY_RENDER_MODE_DIRECT into the half that is not
+ * shown, then shown with FBIOPAN_DISPLAY. The flush completes after the
+ * vblank the pan is applied at. Before a frame is rendered, only the areas
+ * of the previous frame are copied into its half.
+ */
+
+#ifndef FBDEV_PAN_H
+#define FBDEV_PAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Create the display
+ * @param device the framebuffer device, i.e "/dev/fb0"
+ * @return the display, NULL if the device can not be opened, does
+ * not support a virtual framebuffer of twice the height of the panel
+ * or FBIO_WAITFORVSYNC
+ */
+lv_display_t *fbdev_pan_create(const char *device);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*FBDEV_PAN_H*/
@@ -0,0 +1,326 @@
+/**
+ * @file fontpack.c
+ *
+ * Fonts mapped from a file instead of being compiled in
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fontpack.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* The structures of a font copied out of the pack, the arrays stay mapped */
+typedef struct {
+    lv_font_t font;
+    lv_font_fmt_txt_dsc_t dsc;
+    union {
+        lv_font_fmt_txt_kern_classes_t classes;
+        lv_font_fmt_txt_kern_pair_t pairs;
+    } kern;
+    lv_font_fmt_txt_cmap_t cmaps[];
+} loaded_font_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static loaded_font_t *load_font(const fontpack_entry_t *entry);
+static const void *pack_at(uint64_t offset, size_t size);
+static bool resolve(const void **ptr, size_t size);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static uint8_t *pack;
+static size_t pack_size;
+static const fontpack_entry_t *entries;
+static uint32_t font_count;
+static loaded_font_t **loaded;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int fontpack_open(const char *path)
+{
+    const fontpack_header_t *header;
+    char exe[PATH_MAX];
+    char buf[PATH_MAX + sizeof(FONTPACK_DEFAULT_NAME) + 1];
+    struct stat st;
+    ssize_t len;
+    void *map;
+    int fd;
+
+    if (pack != NULL) {
+        fontpack_close();
+    }
+
+    if (path == NULL) {
+        len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+        if (len < 0) {
+            return -1;
+        }
+        exe[len] = '\0';
+        snprintf(buf, sizeof(buf), "%s/%s", dirname(exe), FONTPACK_DEFAULT_NAME);
+        path = buf;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LV_LOG_INFO("No font pack %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(fontpack_header_t)) {
+        LV_LOG_WARN("Invalid font pack %s", path);
+        close(fd);
+        return -1;
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LV_LOG_WARN("Failed to map %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    /* The glyphs are scattered, reading ahead would page in the unused ones */
+    madvise(map, (size_t)st.st_size, MADV_RANDOM);
+
+    header = map;
+    if (memcmp(header->magic, FONTPACK_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != FONTPACK_VERSION ||
+        header->font_size != sizeof(lv_font_t) ||
+        header->dsc_size != sizeof(lv_font_fmt_txt_dsc_t) ||
+        header->glyph_dsc_size != sizeof(lv_font_fmt_txt_glyph_dsc_t) ||
+        header->cmap_size != sizeof(lv_font_fmt_txt_cmap_t) ||
+        header->kern_classes_size != sizeof(lv_font_fmt_txt_kern_classes_t) ||
+        header->kern_pair_size != sizeof(lv_font_fmt_txt_kern_pair_t) ||
+        header->font_count > ((size_t)st.st_size - sizeof(*header)) / sizeof(fontpack_entry_t)) {
+        LV_LOG_WARN("%s was written for another LVGL configuration, run fontpack_gen again", path);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    loaded = calloc(header->font_count, sizeof(loaded[0]));
+    if (loaded == NULL && header->font_count > 0) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    pack = map;
+    pack_size = (size_t)st.st_size;
+    entries = (const fontpack_entry_t *)(pack + sizeof(*header));
+    font_count = header->font_count;
+
+    LV_LOG_USER("Mapped %u fonts from %s", (unsigned)font_count, path);
+    return 0;
+}
+
+const lv_font_t *fontpack_get(const char *name)
+{
+    uint32_t i;
+
+    for (i = 0; i < font_count; i++) {
+        if (strncmp(entries[i].name, name, FONTPACK_NAME_MAX) != 0) {
+            continue;
+        }
+
+        if (loaded[i] == NULL) {
+            loaded[i] = load_font(&entries[i]);
+            if (loaded[i] == NULL) {
+                LV_LOG_WARN("The font %s of the pack is corrupted", name);
+                return NULL;
+            }
+        }
+
+        return &loaded[i]->font;
+    }
+
+    return NULL;
+}
+
+void fontpack_close(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < font_count; i++) {
+        free(loaded[i]);
+    }
+    free(loaded);
+
+    if (pack != NULL) {
+        munmap(pack, pack_size);
+    }
+
+    pack = NULL;
+    pack_size = 0;
+    entries = NULL;
+    font_count = 0;
+    loaded = NULL;
+}
+
+size_t fontpack_cmap_ofs_size(const lv_font_fmt_txt_cmap_t *cmap)
+{
+    switch (cmap->type) {
+    case LV_FONT_FMT_TXT_CMAP_FORMAT0_FULL:
+        return cmap->range_length * sizeof(uint8_t);
+    case LV_FONT_FMT_TXT_CMAP_SPARSE_FULL:
+        return cmap->list_length * sizeof(uint16_t);
+    default:
+        return 0;
+    }
+}
+
+size_t fontpack_cmap_unicode_size(const lv_font_fmt_txt_cmap_t *cmap)
+{
+    switch (cmap->type) {
+    case LV_FONT_FMT_TXT_CMAP_SPARSE_FULL:
+    case LV_FONT_FMT_TXT_CMAP_SPARSE_TINY:
+        return cmap->list_length * sizeof(uint16_t);
+    default:
+        return 0;
+    }
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Copy the structures of a font and point them into the pack
+ * @return the font, NULL if an offset is out of the pack
+ */
+static loaded_font_t *load_font(const fontpack_entry_t *entry)
+{
+    const lv_font_t *font;
+    const lv_font_fmt_txt_dsc_t *dsc;
+    const lv_font_fmt_txt_cmap_t *cmaps;
+    const void *kern;
+    loaded_font_t *lf;
+    lv_font_fmt_txt_kern_classes_t *kc;
+    lv_font_fmt_txt_kern_pair_t *kp;
+    uint32_t i;
+    bool ok;
+
+    font = pack_at(entry->font_offset, sizeof(*font));
+    if (font == NULL) {
+        return NULL;
+    }
+
+    dsc = font->dsc;
+    if (!resolve((const void **)&dsc, sizeof(*dsc)) || dsc == NULL) {
+        return NULL;
+    }
+
+    lf = calloc(1, sizeof(*lf) + dsc->cmap_num * sizeof(lf->cmaps[0]));
+    if (lf == NULL) {
+        return NULL;
+    }
+
+    lf->font = *font;
+    lf->dsc = *dsc;
+
+    /* Bitmaps and glyph descriptors are paged in when they are drawn */
+    ok = resolve((const void **)&lf->dsc.glyph_bitmap, entry->bitmap_size) &&
+         resolve((const void **)&lf->dsc.glyph_dsc, (size_t)entry->glyph_count * sizeof(lv_font_fmt_txt_glyph_dsc_t));
+
+    cmaps = dsc->cmaps;
+    ok = ok && resolve((const void **)&cmaps, dsc->cmap_num * sizeof(cmaps[0]));
+    for (i = 0; ok && cmaps != NULL && i < dsc->cmap_num; i++) {
+        lf->cmaps[i] = cmaps[i];
+        ok = resolve((const void **)&lf->cmaps[i].unicode_list, fontpack_cmap_unicode_size(&cmaps[i])) &&
+             resolve(&lf->cmaps[i].glyph_id_ofs_list, fontpack_cmap_ofs_size(&cmaps[i]));
+    }
+    lf->dsc.cmaps = lf->cmaps;
+
+    kern = dsc->kern_dsc;
+    if (ok && kern != NULL && dsc->kern_classes) {
+        kc = &lf->kern.classes;
+        ok = resolve(&kern, sizeof(*kc));
+        if (ok) {
+            *kc = *(const lv_font_fmt_txt_kern_classes_t *)kern;
+            ok = resolve((const void **)&kc->class_pair_values, (size_t)kc->left_class_cnt * kc->right_class_cnt) &&
+                 resolve((const void **)&kc->left_class_mapping, entry->glyph_count) &&
+                 resolve((const void **)&kc->right_class_mapping, entry->glyph_count);
+        }
+        lf->dsc.kern_dsc = kc;
+    } else if (ok && kern != NULL) {
+        kp = &lf->kern.pairs;
+        ok = resolve(&kern, sizeof(*kp));
+        if (ok) {
+            *kp = *(const lv_font_fmt_txt_kern_pair_t *)kern;
+            ok = resolve(&kp->glyph_ids, (size_t)kp->pair_cnt * (kp->glyph_ids_size == 0 ? 2 : 4)) &&
+                 resolve((const void **)&kp->values, kp->pair_cnt);
+        }
+        lf->dsc.kern_dsc = kp;
+    }
+
+    if (!ok) {
+        free(lf);
+        return NULL;
+    }
+
+    lf->font.get_glyph_dsc = lv_font_get_glyph_dsc_fmt_txt;
+    lf->font.get_glyph_bitmap = lv_font_get_bitmap_fmt_txt;
+    lf->font.release_glyph = NULL;
+    lf->font.dsc = &lf->dsc;
+    lf->font.fallback = NULL;
+    lf->font.user_data = NULL;
+
+    return lf;
+}
+
+/**
+ * Point into the pack
+ * @return the data at the offset, NULL if it is out of the pack
+ */
+static const void *pack_at(uint64_t offset, size_t size)
+{
+    if (offset > pack_size || size > pack_size - offset) {
+        return NULL;
+    }
+
+    return pack + offset;
+}
+
+/**
+ * Turn an offset stored in a pointer into a pointer into the pack
+ * @param ptr the offset to convert, 0 stands for NULL
+ * @param size the size of the data it points to
+ * @return false if the data is out of the pack
+ */
+static bool resolve(const void **ptr, size_t size)
+{
+    uintptr_t offset = (uintptr_t)*ptr;
+
+    if (offset == 0) {
+        return true;
+    }
+
+    *ptr = pack_at(offset, size);
+    return *ptr != NULL;
+}
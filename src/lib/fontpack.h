@@ -0,0 +1,117 @@
+/**
+ * @file fontpack.h
+ *
+ * Fonts mapped from a file instead of being compiled in
+ *
+ * A pack holds LVGL fonts in the text format (lv_font_fmt_txt), written
+ * by fontpack_gen from the fonts selected at build time. The pack is
+ * mapped read only: a font is only set up when it is first requested and
+ * its glyph descriptors and bitmaps are paged in as they are drawn. The
+ * fonts that are not used cost neither memory nor load time.
+ *
+ * The LVGL structures are stored as they are in memory with the pointers
+ * replaced by offsets in the file. A pack is only loaded by a build with
+ * the same LVGL configuration and ABI as the generator.
+ */
+
+#ifndef FONTPACK_H
+#define FONTPACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stddef.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define FONTPACK_MAGIC          "LVFP"
+#define FONTPACK_VERSION        1
+#define FONTPACK_NAME_MAX       48
+
+/* Name of the pack next to the executable */
+#define FONTPACK_DEFAULT_NAME   "fonts.pack"
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* At the start of the file, followed by font_count entries */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t font_count;
+    /* Sizes of the LVGL structures of the generator */
+    uint16_t font_size;
+    uint16_t dsc_size;
+    uint16_t glyph_dsc_size;
+    uint16_t cmap_size;
+    uint16_t kern_classes_size;
+    uint16_t kern_pair_size;
+} fontpack_header_t;
+
+typedef struct {
+    char name[FONTPACK_NAME_MAX];       /* the LVGL name without lv_font_, i.e montserrat_28 */
+    uint64_t font_offset;               /* the lv_font_t */
+    uint32_t glyph_count;               /* glyph descriptors, including the reserved glyph 0 */
+    uint32_t bitmap_size;
+} fontpack_entry_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Map a font pack
+ * @param path the pack, NULL for FONTPACK_DEFAULT_NAME next to the executable
+ * @return 0 on success, -1 if the file is missing or was written for
+ * another LVGL configuration
+ */
+int fontpack_open(const char *path);
+
+/**
+ * Get a font of the pack
+ * @description the font is set up on the first call, the following calls
+ * return the same font
+ * @param name the name of the font, i.e montserrat_28
+ * @return the font, NULL if the pack is not open or has no such font
+ */
+const lv_font_t *fontpack_get(const char *name);
+
+/**
+ * Unmap the pack
+ * @description the fonts of the pack must no longer be used
+ */
+void fontpack_close(void);
+
+/**
+ * Size of the glyph ids of a character map
+ * @param cmap the character map
+ * @return the size of its glyph_id_ofs_list in bytes
+ */
+size_t fontpack_cmap_ofs_size(const lv_font_fmt_txt_cmap_t *cmap);
+
+/**
+ * Size of the unicode list of a character map
+ * @param cmap the character map
+ * @return the size of its unicode_list in bytes
+ */
+size_t fontpack_cmap_unicode_size(const lv_font_fmt_txt_cmap_t *cmap);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*FONTPACK_H*/
@@ -0,0 +1,445 @@
+/**
+ * @file frame_hist.c
+ *
+ * Histograms of the phases of the frames
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "simulator_util.h"
+#include "frame_hist.h"
+#include "realtime.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Large enough for every histogram with all its buckets */
+#define EXPORT_BUF_SIZE     8192
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static int open_export(const char *dest);
+static void *export_thread(void *arg);
+static void export_line(void);
+static void refr_event_cb(lv_event_t *e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static const char *const hist_names[FRAME_HIST_COUNT] = {
+    "timer_us", "layout_us", "render_us", "flush_us", "area_px", "interval_us"
+};
+
+/* Updated with atomics */
+static frame_hist_t hists[FRAME_HIST_COUNT];
+
+static lv_display_t *display;
+static bool enabled;
+static uint64_t start_us;
+
+/* Export, a file or a datagram socket */
+static int export_fd = -1;
+static bool export_socket;
+static struct sockaddr_storage export_addr;
+static socklen_t export_addr_len;
+static uint32_t export_period_ms;
+
+static pthread_t thread;
+static pthread_mutex_t stop_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stop_cond;
+static bool stop_requested;
+
+/* Phases of the frame being refreshed, only touched by the UI thread */
+static uint64_t timer_start_us;
+static uint64_t timer_refr_us;          /* refreshes run by the timers */
+static uint64_t refr_start_us;
+static uint64_t last_frame_us;          /* start of the previous frame that rendered */
+static uint64_t render_start_us;
+static uint64_t render_us;
+static uint64_t flush_start_us;
+static uint64_t flush_us;
+static uint64_t area_px;
+static bool in_timer;
+static bool rendered;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int frame_hist_start(lv_display_t *disp)
+{
+    const char *dest = getenv("LV_SIM_FRAME_HIST");
+    pthread_condattr_t attr;
+
+    if (dest == NULL || *dest == '\0' || enabled) {
+        return 0;
+    }
+
+    export_period_ms = (uint32_t)atoi(getenv_default("LV_SIM_FRAME_HIST_MS", "1000"));
+    if (export_period_ms == 0) {
+        export_period_ms = 1000;
+    }
+
+    export_fd = open_export(dest);
+    if (export_fd < 0) {
+        LV_LOG_ERROR("Failed to open %s: %s", dest, strerror(errno));
+        return -1;
+    }
+
+    memset(hists, 0, sizeof(hists));
+    start_us = now_us();
+    last_frame_us = 0;
+    stop_requested = false;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&stop_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&thread, NULL, export_thread, NULL) != 0) {
+        pthread_cond_destroy(&stop_cond);
+        close(export_fd);
+        export_fd = -1;
+        return -1;
+    }
+
+    display = disp;
+    lv_display_add_event_cb(display, refr_event_cb, LV_EVENT_ALL, NULL);
+    enabled = true;
+
+    LV_LOG_USER("Frame histograms are exported to %s every %u ms", dest, (unsigned)export_period_ms);
+    return 0;
+}
+
+void frame_hist_stop(void)
+{
+    if (!enabled) {
+        return;
+    }
+
+    lv_display_remove_event_cb_with_user_data(display, refr_event_cb, NULL);
+    enabled = false;
+
+    pthread_mutex_lock(&stop_lock);
+    stop_requested = true;
+    pthread_cond_signal(&stop_cond);
+    pthread_mutex_unlock(&stop_lock);
+
+    /* The thread exports the last values before leaving */
+    pthread_join(thread, NULL);
+    pthread_cond_destroy(&stop_cond);
+
+    close(export_fd);
+    export_fd = -1;
+    display = NULL;
+}
+
+bool frame_hist_enabled(void)
+{
+    return enabled;
+}
+
+void frame_hist_timer_begin(void)
+{
+    if (!enabled) {
+        return;
+    }
+
+    timer_start_us = now_us();
+    timer_refr_us = 0;
+    in_timer = true;
+}
+
+void frame_hist_timer_end(void)
+{
+    uint64_t elapsed;
+
+    if (!enabled || !in_timer) {
+        return;
+    }
+
+    in_timer = false;
+    elapsed = now_us() - timer_start_us;
+    frame_hist_record(FRAME_HIST_TIMER, elapsed > timer_refr_us ? elapsed - timer_refr_us : 0);
+}
+
+void frame_hist_record(frame_hist_id_t id, uint64_t value)
+{
+    frame_hist_t *hist = &hists[id];
+    uint32_t bucket = value == 0 ? 0 : 64 - (uint32_t)__builtin_clzll(value);
+    uint64_t max;
+
+    if (bucket >= FRAME_HIST_BUCKETS) {
+        bucket = FRAME_HIST_BUCKETS - 1;
+    }
+
+    __atomic_fetch_add(&hist->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+
+    max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    while (value > max &&
+           !__atomic_compare_exchange_n(&hist->max, &max, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void frame_hist_snapshot(frame_hist_t *snapshot)
+{
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < FRAME_HIST_COUNT; i++) {
+        for (j = 0; j < FRAME_HIST_BUCKETS; j++) {
+            snapshot[i].buckets[j] = __atomic_load_n(&hists[i].buckets[j], __ATOMIC_RELAXED);
+        }
+        snapshot[i].count = __atomic_load_n(&hists[i].count, __ATOMIC_RELAXED);
+        snapshot[i].sum = __atomic_load_n(&hists[i].sum, __ATOMIC_RELAXED);
+        snapshot[i].max = __atomic_load_n(&hists[i].max, __ATOMIC_RELAXED);
+    }
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Open the destination of the export
+ * @param dest a path, unix:PATH or udp:HOST:PORT
+ * @return the fd, -1 with errno set on error
+ */
+static int open_export(const char *dest)
+{
+    struct sockaddr_un *un = (struct sockaddr_un *)&export_addr;
+    struct addrinfo hints;
+    struct addrinfo *res;
+    char host[256];
+    const char *port;
+    size_t len;
+    int fd;
+
+    memset(&export_addr, 0, sizeof(export_addr));
+    export_socket = false;
+
+    if (strncmp(dest, "unix:", 5) == 0) {
+        dest += 5;
+        if (strlen(dest) >= sizeof(un->sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, dest);
+        export_addr_len = sizeof(*un);
+
+    } else if (strncmp(dest, "udp:", 4) == 0) {
+        dest += 4;
+        port = strrchr(dest, ':');
+        len = port != NULL ? (size_t)(port - dest) : 0;
+        if (len == 0 || len >= sizeof(host)) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        memcpy(host, dest, len);
+        host[len] = '\0';
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        if (getaddrinfo(host, port + 1, &hints, &res) != 0) {
+            errno = EHOSTUNREACH;
+            return -1;
+        }
+
+        memcpy(&export_addr, res->ai_addr, res->ai_addrlen);
+        export_addr_len = res->ai_addrlen;
+        freeaddrinfo(res);
+
+    } else {
+        return open(dest, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+
+    /* The collector may start after the UI, the datagrams are sent without connecting */
+    fd = socket(export_addr.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    export_socket = fd >= 0;
+    return fd;
+}
+
+static void *export_thread(void *arg)
+{
+    struct timespec deadline;
+    bool stop;
+
+    (void)arg;
+
+    /* Writes files and sockets, not part of the rendering */
+    realtime_leave();
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    while (true) {
+
+        deadline.tv_nsec += (long)(export_period_ms % 1000) * 1000000L;
+        deadline.tv_sec += export_period_ms / 1000;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_nsec -= 1000000000L;
+            deadline.tv_sec++;
+        }
+
+        pthread_mutex_lock(&stop_lock);
+        while (!stop_requested) {
+            if (pthread_cond_timedwait(&stop_cond, &stop_lock, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        stop = stop_requested;
+        pthread_mutex_unlock(&stop_lock);
+
+        export_line();
+
+        if (stop) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Write the histograms as a JSON line
+ * @description the empty buckets past the last value are left out, a lost
+ * datagram is not retried
+ */
+static void export_line(void)
+{
+    frame_hist_t snapshot[FRAME_HIST_COUNT];
+    char buf[EXPORT_BUF_SIZE];
+    size_t len;
+    uint32_t used;
+    uint32_t i;
+    uint32_t j;
+
+    frame_hist_snapshot(snapshot);
+
+    len = (size_t)snprintf(buf, sizeof(buf), "{\"time_ms\":%llu",
+                           (unsigned long long)((now_us() - start_us) / 1000));
+
+    for (i = 0; i < FRAME_HIST_COUNT; i++) {
+        used = FRAME_HIST_BUCKETS;
+        while (used > 0 && snapshot[i].buckets[used - 1] == 0) {
+            used--;
+        }
+
+        len += (size_t)snprintf(buf + len, sizeof(buf) - len,
+                                ",\"%s\":{\"count\":%llu,\"sum\":%llu,\"max\":%llu,\"buckets\":[",
+                                hist_names[i], (unsigned long long)snapshot[i].count,
+                                (unsigned long long)snapshot[i].sum, (unsigned long long)snapshot[i].max);
+
+        for (j = 0; j < used; j++) {
+            len += (size_t)snprintf(buf + len, sizeof(buf) - len, j == 0 ? "%llu" : ",%llu",
+                                    (unsigned long long)snapshot[i].buckets[j]);
+        }
+
+        len += (size_t)snprintf(buf + len, sizeof(buf) - len, "]}");
+    }
+
+    len += (size_t)snprintf(buf + len, sizeof(buf) - len, "}\n");
+
+    if (export_socket) {
+        if (sendto(export_fd, buf, len, MSG_DONTWAIT, (struct sockaddr *)&export_addr, export_addr_len) < 0) {
+            LV_LOG_TRACE("Frame histograms not sent: %s", strerror(errno));
+        }
+    } else if (write(export_fd, buf, len) != (ssize_t)len) {
+        LV_LOG_WARN("Failed to write the frame histograms: %s", strerror(errno));
+    }
+}
+
+/**
+ * Split the refreshes into their phases
+ * @description the layout is updated between the start of the refresh and
+ * the start of the rendering, the flushes happen during the rendering and
+ * while waiting for the last buffer at the end of the refresh
+ */
+static void refr_event_cb(lv_event_t *e)
+{
+    uint64_t now = now_us();
+    const lv_area_t *area;
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_REFR_START:
+        refr_start_us = now;
+        render_start_us = 0;
+        render_us = 0;
+        flush_us = 0;
+        area_px = 0;
+        rendered = false;
+        break;
+    case LV_EVENT_RENDER_START:
+        render_start_us = now;
+        rendered = true;
+        break;
+    case LV_EVENT_RENDER_READY:
+        render_us = now - render_start_us;
+        render_us = render_us > flush_us ? render_us - flush_us : 0;
+        break;
+    case LV_EVENT_FLUSH_START:
+        area = lv_event_get_param(e);
+        if (area != NULL) {
+            area_px += lv_area_get_size(area);
+        }
+        flush_start_us = now;
+        break;
+    case LV_EVENT_FLUSH_WAIT_START:
+        flush_start_us = now;
+        break;
+    case LV_EVENT_FLUSH_FINISH:
+    case LV_EVENT_FLUSH_WAIT_FINISH:
+        flush_us += now - flush_start_us;
+        break;
+    case LV_EVENT_REFR_READY:
+        if (in_timer) {
+            timer_refr_us += now - refr_start_us;
+        }
+
+        /* Nothing was invalidated */
+        if (!rendered) {
+            break;
+        }
+
+        frame_hist_record(FRAME_HIST_LAYOUT, render_start_us - refr_start_us);
+        frame_hist_record(FRAME_HIST_RENDER, render_us);
+        frame_hist_record(FRAME_HIST_FLUSH, flush_us);
+        frame_hist_record(FRAME_HIST_AREA, area_px);
+
+        if (last_frame_us != 0) {
+            frame_hist_record(FRAME_HIST_INTERVAL, refr_start_us - last_frame_us);
+        }
+        last_frame_us = refr_start_us;
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,122 @@
+/**
+ * @file frame_hist.h
+ *
+ * Histograms of the phases of the frames
+ *
+ * The time spent in the LVGL timers, the layout, the rendering and the
+ * flushes of every frame, the area it flushed and the interval since the
+ * previous frame are counted in fixed
+ * power of two buckets. The counters are updated with atomics, they are
+ * read by the export thread without stopping the UI.
+ *
+ * The histograms are exported when LV_SIM_FRAME_HIST is set, nothing is
+ * drawn on the display:
+ * - a path, a JSON line is appended to the file every period
+ * - unix:PATH, a datagram is sent to the unix socket every period
+ * - udp:HOST:PORT, a datagram is sent to the address every period
+ * LV_SIM_FRAME_HIST_MS sets the period, 1000 ms by default. The counters
+ * are cumulative, the collector computes the differences. The empty
+ * buckets past the last one holding values are left out of the lines.
+ */
+
+#ifndef FRAME_HIST_H
+#define FRAME_HIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Bucket 0 counts the zeros, bucket i the values in [2^(i-1), 2^i) */
+#define FRAME_HIST_BUCKETS  32
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef enum {
+    FRAME_HIST_TIMER,                   /* lv_timer_handler() without the refreshes, in us */
+    FRAME_HIST_LAYOUT,                  /* refresh start to render start, in us */
+    FRAME_HIST_RENDER,                  /* drawing without the flushes, in us */
+    FRAME_HIST_FLUSH,                   /* flush callbacks and waits for them, in us */
+    FRAME_HIST_AREA,                    /* pixels flushed, in px */
+    FRAME_HIST_INTERVAL,                /* start of the previous frame to start of the frame, in us */
+    FRAME_HIST_COUNT
+} frame_hist_id_t;
+
+typedef struct {
+    uint64_t buckets[FRAME_HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+} frame_hist_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Start recording the frames of a display
+ * @description does nothing unless LV_SIM_FRAME_HIST is set
+ * @param disp the display
+ * @return 0 on success or when disabled, -1 if the export failed to start
+ */
+int frame_hist_start(lv_display_t *disp);
+
+/**
+ * Export the last values and stop recording
+ */
+void frame_hist_stop(void);
+
+/**
+ * Check if the frames are recorded
+ * @return true between frame_hist_start() and frame_hist_stop() when enabled
+ */
+bool frame_hist_enabled(void);
+
+/**
+ * Mark the start of a run of the LVGL timers
+ */
+void frame_hist_timer_begin(void);
+
+/**
+ * Mark the end of a run of the LVGL timers
+ * @description the refreshes the timers ran are not counted, they are
+ * split into their own phases
+ */
+void frame_hist_timer_end(void);
+
+/**
+ * Count a value
+ * @description lock free, can be called from any thread
+ * @param id the histogram
+ * @param value the value
+ */
+void frame_hist_record(frame_hist_id_t id, uint64_t value);
+
+/**
+ * Copy the histograms
+ * @param snapshot FRAME_HIST_COUNT histograms to fill
+ */
+void frame_hist_snapshot(frame_hist_t *snapshot);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*FRAME_HIST_H*/
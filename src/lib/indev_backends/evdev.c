@@ -24,7 +24,9 @@
 #include "lvgl/lvgl.h"
 #if LV_USE_EVDEV
 #include "lvgl/src/core/lv_global.h"
+#include "../simulator_util.h"
 #include "../backends.h"
+#include "../driver_backends.h"
 
 /*********************
  *      DEFINES
@@ -42,6 +44,7 @@ static void indev_deleted_cb(lv_event_t *e);
 static void discovery_cb(lv_indev_t *indev, lv_evdev_type_t type, void *user_data);
 static void set_mouse_cursor_icon(lv_indev_t *indev, lv_display_t *display);
 static lv_indev_t *init_pointer_evdev(lv_display_t *display);
+static int get_fds_evdev(backend_fd_t *fds, int max);
 
 /**********************
  *  STATIC VARIABLES
@@ -65,10 +68,11 @@ static char *backend_name = "EVDEV";
 int backend_init_evdev(backend_t *backend)
 {
     LV_ASSERT_NULL(backend);
-    backend->handle->indev = malloc(sizeof(indev_backend_t));
+    backend->handle->indev = calloc(1, sizeof(indev_backend_t));
     LV_ASSERT_NULL(backend->handle->indev);
 
     backend->handle->indev->init_indev = init_pointer_evdev;
+    backend->handle->indev->get_fds = get_fds_evdev;
 
     backend->name = backend_name;
     backend->type = BACKEND_INDEV;
@@ -130,6 +134,12 @@ static void set_mouse_cursor_icon(lv_indev_t *indev, lv_display_t *display)
 {
     /* Set the cursor icon */
     LV_IMAGE_DECLARE(mouse_cursor_icon);
+
+    /* A hardware cursor moves without redrawing the screen */
+    if (driver_backends_set_hw_cursor(indev, &mouse_cursor_icon)) {
+        return;
+    }
+
     lv_obj_t *cursor_obj = lv_image_create(lv_display_get_screen_active(display));
     lv_image_set_src(cursor_obj, &mouse_cursor_icon);
     lv_indev_set_cursor(indev, cursor_obj);
@@ -173,4 +183,37 @@ static lv_indev_t *init_pointer_evdev(lv_display_t *display)
     set_mouse_cursor_icon(indev, display);
     return indev;
 }
+
+/*
+ * Get the fds of the input devices
+ *
+ * @description the driver does not expose them, they are found through
+ * /proc/self/fd. The inotify fd of the discovery is watched too, so
+ * that a device being plugged in wakes the scheduler
+ * @param fds the fds to watch
+ * @param max the size of fds
+ * @return the number of fds
+ */
+static int get_fds_evdev(backend_fd_t *fds, int max)
+{
+    int found[BACKEND_MAX_FDS];
+    int count;
+    int i;
+
+    count = find_open_fds("/dev/input/event", found, max < BACKEND_MAX_FDS ? max : BACKEND_MAX_FDS);
+    for (i = 0; i < count; i++) {
+        fds[i].fd = found[i];
+        fds[i].edge = false;
+    }
+
+    /* The hotplug notifications are consumed by the discovery timer */
+    if (count < max && find_open_fds("anon_inode:inotify", found, 1) == 1) {
+        fds[count].fd = found[0];
+        fds[count].edge = true;
+        count++;
+    }
+
+    return count;
+}
+
 #endif /*#if LV_USE_EVDEV*/
@@ -0,0 +1,917 @@
+/**
+ * @file mem_alloc.c
+ *
+ * LVGL allocator with size class pools, a TLSF arena and accounting
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "mem_alloc.h"
+
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_CUSTOM
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Alignment of the allocations, wide enough for the SIMD loads */
+#define ALIGN               16
+
+#define ALLOC_MAGIC         0xA11C
+#define CLASS_ARENA         0xFF
+#define CLASS_COUNT         (sizeof(class_sizes) / sizeof(class_sizes[0]))
+
+/* Carved into the slots of one size class */
+#define SLAB_SIZE           (64 * 1024)
+
+/* Largest allocation, the arena blocks must stay below 2^FL_MAX */
+#define ALLOC_MAX           ((size_t)1 << 30)
+
+#define DEFAULT_ARENA_MB    8
+#define HUGEPAGE_SIZE       (2 * 1024 * 1024)
+#define MAX_CHUNKS          64
+
+/*
+ * TLSF: the free blocks are kept in FL_COUNT power of two ranges, each
+ * split into SL_COUNT linear lists. The blocks below SMALL_BLOCK_SIZE
+ * share the first range in steps of ALIGN.
+ */
+#define SL_LOG2             4
+#define SL_COUNT            (1 << SL_LOG2)
+#define FL_SHIFT            (SL_LOG2 + 4)
+#define FL_MAX              32
+#define FL_COUNT            (FL_MAX - FL_SHIFT + 1)
+#define SMALL_BLOCK_SIZE    ((size_t)1 << FL_SHIFT)
+
+#define BLOCK_FREE          ((size_t)1)
+#define BLOCK_HDR           offsetof(block_t, next_free)
+#define BLOCK_MIN           (sizeof(block_t) - BLOCK_HDR)
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Arena block, the free list links are in the payload of the free blocks */
+typedef struct block {
+    struct block *prev_phys;
+    size_t size;                        /* payload size, BLOCK_FREE in the low bit */
+    struct block *next_free;
+    struct block *prev_free;
+} block_t;
+
+/* Before every allocation, keeps the payload aligned */
+typedef struct {
+    uint32_t size;                      /* requested size */
+    uint8_t tag;
+    uint8_t cls;                        /* size class, CLASS_ARENA for the arena blocks */
+    uint16_t magic;
+    uint8_t reserved[8];
+} alloc_hdr_t;
+
+typedef struct slot {
+    struct slot *next;
+} slot_t;
+
+typedef struct {
+    slot_t *free;
+    uint8_t *bump;                      /* next slot never used of the current slab */
+    uint8_t *end;
+} size_class_t;
+
+typedef struct {
+    void *mem;
+    size_t size;
+    block_t *first;
+    bool mapped;                        /* unmapped by lv_mem_deinit(), not added with lv_mem_add_pool() */
+} chunk_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void *alloc_locked(size_t size, mem_tag_t tag);
+static void free_locked(alloc_hdr_t *hdr);
+static alloc_hdr_t *header_of(void *p);
+static void account(alloc_hdr_t *hdr, size_t new_size);
+static int class_of(size_t total);
+static void *pool_alloc(int cls);
+static void pool_free(int cls, void *slot);
+static block_t *arena_alloc(size_t size);
+static bool arena_grow(size_t size);
+static void *map_chunk(size_t size);
+static chunk_t *add_chunk(void *mem, size_t size, bool mapped);
+static void mapping(size_t size, int *fl, int *sl);
+static block_t *find_free(size_t size);
+static void insert_free(block_t *b);
+static void remove_free(block_t *b);
+static void split(block_t *b, size_t size);
+static void release(block_t *b);
+static void *tagged_draw_buf_malloc(size_t size, lv_color_format_t cf);
+static void *tagged_image_buf_malloc(size_t size, lv_color_format_t cf);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/* Slot sizes, header included */
+static const uint16_t class_sizes[] = {32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512};
+
+static struct {
+    pthread_mutex_t lock;
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[FL_COUNT];
+    block_t *blocks[FL_COUNT][SL_COUNT];
+    size_class_t classes[CLASS_COUNT];
+    chunk_t chunks[MAX_CHUNKS];
+    uint32_t chunk_count;
+    size_t chunk_size;
+    bool hugepages;
+    bool hugetlb;
+    mem_alloc_stats_t stats;
+} mem;
+
+static lv_draw_buf_malloc_cb draw_buf_malloc;
+static lv_draw_buf_malloc_cb image_buf_malloc;
+
+#endif /*LV_USE_STDLIB_MALLOC == LV_STDLIB_CUSTOM*/
+
+static __thread mem_tag_t current_tag;
+
+static const char * const tag_names[MEM_TAG_COUNT] = {"widgets", "draw", "sampler", "history"};
+
+/**********************
+ *      MACROS
+ **********************/
+#define ALIGN_UP(x, a)      (((x) + (a) - 1) & ~((size_t)(a) - 1))
+#define PAYLOAD(b)          ((uint8_t *)(b) + BLOCK_HDR)
+#define BLOCK_OF(p)         ((block_t *)((uint8_t *)(p) - BLOCK_HDR))
+#define BLOCK_SIZE(b)       ((b)->size & ~BLOCK_FREE)
+#define BLOCK_IS_FREE(b)    (((b)->size & BLOCK_FREE) != 0)
+#define BLOCK_NEXT(b)       ((block_t *)(PAYLOAD(b) + BLOCK_SIZE(b)))
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+mem_tag_t mem_tag_set(mem_tag_t tag)
+{
+    mem_tag_t prev = current_tag;
+
+    current_tag = tag < MEM_TAG_COUNT ? tag : MEM_TAG_WIDGETS;
+    return prev;
+}
+
+const char *mem_tag_name(mem_tag_t tag)
+{
+    return tag < MEM_TAG_COUNT ? tag_names[tag] : "?";
+}
+
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_CUSTOM
+
+void mem_alloc_tag_draw_bufs(void)
+{
+    lv_draw_buf_handlers_t *handlers = lv_draw_buf_get_handlers();
+
+    if (handlers->buf_malloc_cb != tagged_draw_buf_malloc) {
+        draw_buf_malloc = handlers->buf_malloc_cb;
+        handlers->buf_malloc_cb = tagged_draw_buf_malloc;
+    }
+
+    /* The decoded images are separate handlers */
+    handlers = lv_draw_buf_get_image_handlers();
+    if (handlers->buf_malloc_cb != tagged_image_buf_malloc) {
+        image_buf_malloc = handlers->buf_malloc_cb;
+        handlers->buf_malloc_cb = tagged_image_buf_malloc;
+    }
+}
+
+int mem_alloc_get_stats(mem_alloc_stats_t *stats)
+{
+    pthread_mutex_lock(&mem.lock);
+    *stats = mem.stats;
+    pthread_mutex_unlock(&mem.lock);
+
+    return 0;
+}
+
+void lv_mem_init(void)
+{
+    pthread_mutexattr_t attr;
+    const char *env;
+    long mb;
+
+    memset(&mem, 0, sizeof(mem));
+
+    /* The render thread may run on SCHED_FIFO while the sampler allocates */
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&mem.lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    env = getenv("LV_SIM_MEM_ARENA_MB");
+    mb = env != NULL ? strtol(env, NULL, 10) : 0;
+    mem.chunk_size = (size_t)(mb > 0 && mb <= 1024 ? mb : DEFAULT_ARENA_MB) * 1024 * 1024;
+
+    env = getenv("LV_SIM_MEM_HUGEPAGES");
+    mem.hugepages = env != NULL && strcmp(env, "1") == 0;
+    mem.hugetlb = mem.hugepages;
+
+    /* Mapped now, in the real-time mode mlockall() has already run and faults it in */
+    pthread_mutex_lock(&mem.lock);
+    arena_grow(0);
+    pthread_mutex_unlock(&mem.lock);
+}
+
+void lv_mem_deinit(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < mem.chunk_count; i++) {
+        if (mem.chunks[i].mapped) {
+            munmap(mem.chunks[i].mem, mem.chunks[i].size);
+        }
+    }
+
+    pthread_mutex_destroy(&mem.lock);
+    memset(&mem, 0, sizeof(mem));
+}
+
+lv_mem_pool_t lv_mem_add_pool(void *mem_start, size_t bytes)
+{
+    chunk_t *chunk;
+
+    pthread_mutex_lock(&mem.lock);
+    chunk = add_chunk(mem_start, bytes, false);
+    pthread_mutex_unlock(&mem.lock);
+
+    return chunk != NULL ? mem_start : NULL;
+}
+
+void lv_mem_remove_pool(lv_mem_pool_t pool)
+{
+    chunk_t *chunk;
+    uint32_t i;
+
+    pthread_mutex_lock(&mem.lock);
+
+    for (i = 0; i < mem.chunk_count; i++) {
+        chunk = &mem.chunks[i];
+        if (chunk->mem != pool) {
+            continue;
+        }
+
+        /* Only a pool without allocations, its first block spans all of it */
+        if (!BLOCK_IS_FREE(chunk->first) || BLOCK_SIZE(BLOCK_NEXT(chunk->first)) != 0) {
+            LV_LOG_WARN("The pool %p is still in use", pool);
+            break;
+        }
+
+        remove_free(chunk->first);
+        mem.stats.arena_size -= chunk->size;
+        if (chunk->mapped) {
+            munmap(chunk->mem, chunk->size);
+        }
+        mem.chunks[i] = mem.chunks[--mem.chunk_count];
+        break;
+    }
+
+    pthread_mutex_unlock(&mem.lock);
+}
+
+void *lv_malloc_core(size_t size)
+{
+    void *p;
+
+    pthread_mutex_lock(&mem.lock);
+    p = alloc_locked(size, current_tag);
+    pthread_mutex_unlock(&mem.lock);
+
+    return p;
+}
+
+void *lv_realloc_core(void *p, size_t new_size)
+{
+    alloc_hdr_t *hdr;
+    block_t *b;
+    block_t *next;
+    size_t total;
+    size_t adjust;
+    void *moved;
+
+    if (p == NULL) {
+        return lv_malloc_core(new_size);
+    }
+
+    hdr = header_of(p);
+    if (hdr == NULL || new_size > ALLOC_MAX) {
+        return NULL;
+    }
+
+    total = new_size + sizeof(alloc_hdr_t);
+
+    pthread_mutex_lock(&mem.lock);
+
+    /* Resized in place when it fits the slot or the block, or the free block after it */
+    if (hdr->cls != CLASS_ARENA) {
+        if (total <= class_sizes[hdr->cls]) {
+            account(hdr, new_size);
+            pthread_mutex_unlock(&mem.lock);
+            return p;
+        }
+    } else {
+        b = BLOCK_OF(hdr);
+        adjust = ALIGN_UP(LV_MAX(total, BLOCK_MIN), ALIGN);
+        next = BLOCK_NEXT(b);
+
+        if (adjust > BLOCK_SIZE(b) && BLOCK_IS_FREE(next) &&
+            BLOCK_SIZE(b) + BLOCK_HDR + BLOCK_SIZE(next) >= adjust) {
+            remove_free(next);
+            b->size = BLOCK_SIZE(b) + BLOCK_HDR + BLOCK_SIZE(next);
+            BLOCK_NEXT(b)->prev_phys = b;
+        }
+
+        if (adjust <= BLOCK_SIZE(b)) {
+            split(b, adjust);
+            account(hdr, new_size);
+            pthread_mutex_unlock(&mem.lock);
+            return p;
+        }
+    }
+
+    moved = alloc_locked(new_size, (mem_tag_t)hdr->tag);
+    if (moved != NULL) {
+        memcpy(moved, p, LV_MIN(hdr->size, new_size));
+        free_locked(hdr);
+    }
+
+    pthread_mutex_unlock(&mem.lock);
+
+    return moved;
+}
+
+void lv_free_core(void *p)
+{
+    alloc_hdr_t *hdr;
+
+    if (p == NULL) {
+        return;
+    }
+
+    hdr = header_of(p);
+    if (hdr == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&mem.lock);
+    free_locked(hdr);
+    pthread_mutex_unlock(&mem.lock);
+}
+
+void lv_mem_monitor_core(lv_mem_monitor_t *mon_p)
+{
+    block_t *b;
+    size_t used_cnt = 0;
+    int fl;
+    int sl;
+    int i;
+
+    lv_memzero(mon_p, sizeof(*mon_p));
+
+    pthread_mutex_lock(&mem.lock);
+
+    for (fl = 0; fl < FL_COUNT; fl++) {
+        for (sl = 0; sl < SL_COUNT; sl++) {
+            for (b = mem.blocks[fl][sl]; b != NULL; b = b->next_free) {
+                mon_p->free_cnt++;
+                mon_p->free_biggest_size = LV_MAX(mon_p->free_biggest_size, BLOCK_SIZE(b));
+            }
+        }
+    }
+
+    for (i = 0; i < MEM_TAG_COUNT; i++) {
+        used_cnt += mem.stats.tags[i].count;
+    }
+
+    mon_p->total_size = mem.stats.arena_size;
+    mon_p->free_size = mem.stats.arena_free + mem.stats.pooled_free;
+    mon_p->used_cnt = used_cnt;
+    mon_p->max_used = mem.stats.peak_used;
+
+    pthread_mutex_unlock(&mem.lock);
+
+    if (mon_p->total_size > 0) {
+        mon_p->used_pct = (uint8_t)(100 - (100U * mon_p->free_size) / mon_p->total_size);
+    }
+    if (mon_p->free_size > 0) {
+        mon_p->frag_pct = (uint8_t)(100 - (100U * mon_p->free_biggest_size) / mon_p->free_size);
+    }
+}
+
+lv_result_t lv_mem_test_core(void)
+{
+    lv_result_t res = LV_RESULT_OK;
+    block_t *prev;
+    block_t *b;
+    uint32_t i;
+
+    pthread_mutex_lock(&mem.lock);
+
+    /* The blocks chain to the sentinel and two free blocks are never adjacent */
+    for (i = 0; i < mem.chunk_count && res == LV_RESULT_OK; i++) {
+        prev = NULL;
+        for (b = mem.chunks[i].first; ; b = BLOCK_NEXT(b)) {
+            if (b->prev_phys != prev || (uint8_t *)b >= (uint8_t *)mem.chunks[i].mem + mem.chunks[i].size ||
+                (prev != NULL && BLOCK_IS_FREE(prev) && BLOCK_IS_FREE(b))) {
+                res = LV_RESULT_INVALID;
+                break;
+            }
+            if (BLOCK_SIZE(b) == 0) {
+                break;
+            }
+            prev = b;
+        }
+    }
+
+    pthread_mutex_unlock(&mem.lock);
+
+    return res;
+}
+
+#else /*LV_USE_STDLIB_MALLOC == LV_STDLIB_CUSTOM*/
+
+void mem_alloc_tag_draw_bufs(void)
+{
+}
+
+int mem_alloc_get_stats(mem_alloc_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    return -1;
+}
+
+#endif /*LV_USE_STDLIB_MALLOC == LV_STDLIB_CUSTOM*/
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_CUSTOM
+
+static void *alloc_locked(size_t size, mem_tag_t tag)
+{
+    alloc_hdr_t *hdr;
+    block_t *b;
+    size_t total;
+    int cls;
+
+    if (size > ALLOC_MAX) {
+        return NULL;
+    }
+
+    total = size + sizeof(alloc_hdr_t);
+    cls = class_of(total);
+
+    if (cls != CLASS_ARENA) {
+        hdr = pool_alloc(cls);
+    } else {
+        b = arena_alloc(total);
+        hdr = b != NULL ? (alloc_hdr_t *)PAYLOAD(b) : NULL;
+    }
+
+    if (hdr == NULL) {
+        return NULL;
+    }
+
+    hdr->size = 0;
+    hdr->tag = (uint8_t)tag;
+    hdr->cls = (uint8_t)cls;
+    hdr->magic = ALLOC_MAGIC;
+    mem.stats.tags[tag].count++;
+    account(hdr, size);
+
+    return hdr + 1;
+}
+
+static void free_locked(alloc_hdr_t *hdr)
+{
+    account(hdr, 0);
+    mem.stats.tags[hdr->tag].count--;
+    hdr->magic = 0;
+
+    if (hdr->cls == CLASS_ARENA) {
+        release(BLOCK_OF(hdr));
+    } else {
+        pool_free(hdr->cls, hdr);
+    }
+}
+
+/**
+ * Get the header of an allocation
+ * @return the header, NULL if the pointer was not allocated here or was already freed
+ */
+static alloc_hdr_t *header_of(void *p)
+{
+    alloc_hdr_t *hdr = (alloc_hdr_t *)p - 1;
+
+    if (hdr->magic != ALLOC_MAGIC) {
+        LV_LOG_ERROR("%p was not allocated here or is already freed", p);
+        return NULL;
+    }
+
+    return hdr;
+}
+
+/**
+ * Change the requested size of an allocation in the accounting
+ */
+static void account(alloc_hdr_t *hdr, size_t new_size)
+{
+    mem_tag_usage_t *usage = &mem.stats.tags[hdr->tag];
+    size_t used = 0;
+    int i;
+
+    usage->bytes = usage->bytes - hdr->size + new_size;
+    hdr->size = (uint32_t)new_size;
+
+    for (i = 0; i < MEM_TAG_COUNT; i++) {
+        used += mem.stats.tags[i].bytes;
+    }
+    mem.stats.peak_used = LV_MAX(mem.stats.peak_used, used);
+}
+
+/**
+ * Get the size class of an allocation
+ * @param total the size with the header
+ * @return the smallest class it fits, CLASS_ARENA if it is too large
+ */
+static int class_of(size_t total)
+{
+    uint32_t i;
+
+    /* Every 16 bytes up to 128 */
+    if (total <= 128) {
+        return total <= 32 ? 0 : (int)((total + 15) / 16) - 2;
+    }
+
+    for (i = 7; i < CLASS_COUNT; i++) {
+        if (total <= class_sizes[i]) {
+            return (int)i;
+        }
+    }
+
+    return CLASS_ARENA;
+}
+
+static void *pool_alloc(int cls)
+{
+    size_class_t *c = &mem.classes[cls];
+    size_t size = class_sizes[cls];
+    block_t *slab;
+    slot_t *slot;
+
+    if (c->free != NULL) {
+        slot = c->free;
+        c->free = slot->next;
+    } else {
+        if ((size_t)(c->end - c->bump) < size) {
+            slab = arena_alloc(SLAB_SIZE);
+            if (slab == NULL) {
+                return NULL;
+            }
+
+            /* The tail of the previous slab is too short for a slot */
+            mem.stats.pooled_free -= (size_t)(c->end - c->bump);
+            mem.stats.pooled_size += SLAB_SIZE;
+            mem.stats.pooled_free += SLAB_SIZE;
+            c->bump = PAYLOAD(slab);
+            c->end = c->bump + SLAB_SIZE;
+        }
+
+        slot = (slot_t *)c->bump;
+        c->bump += size;
+    }
+
+    mem.stats.pooled_free -= size;
+    return slot;
+}
+
+static void pool_free(int cls, void *slot)
+{
+    size_class_t *c = &mem.classes[cls];
+
+    ((slot_t *)slot)->next = c->free;
+    c->free = slot;
+    mem.stats.pooled_free += class_sizes[cls];
+}
+
+static block_t *arena_alloc(size_t size)
+{
+    block_t *b;
+
+    size = ALIGN_UP(LV_MAX(size, BLOCK_MIN), ALIGN);
+
+    b = find_free(size);
+    if (b == NULL) {
+        if (!arena_grow(size)) {
+            return NULL;
+        }
+        b = find_free(size);
+        if (b == NULL) {
+            return NULL;
+        }
+    }
+
+    remove_free(b);
+    split(b, size);
+
+    return b;
+}
+
+/**
+ * Map another chunk of the arena
+ * @param size the block it must be able to hold
+ * @return false if the chunk could not be mapped
+ */
+static bool arena_grow(size_t size)
+{
+    size_t page = mem.hugepages ? HUGEPAGE_SIZE : (size_t)sysconf(_SC_PAGESIZE);
+    size_t chunk_size;
+    void *chunk;
+
+    if (mem.chunk_count == MAX_CHUNKS) {
+        return false;
+    }
+
+    /* A block, the sentinel after it and the alignment of the start */
+    chunk_size = ALIGN_UP(LV_MAX(size + 2 * BLOCK_HDR + ALIGN, mem.chunk_size), page);
+
+    chunk = map_chunk(chunk_size);
+    if (chunk == NULL) {
+        return false;
+    }
+
+    return add_chunk(chunk, chunk_size, true) != NULL;
+}
+
+static void *map_chunk(size_t size)
+{
+    uint8_t *p;
+    uint8_t *aligned;
+    size_t head;
+
+    if (mem.hugetlb) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            mem.stats.hugepages = true;
+            return p;
+        }
+
+        /* No hugetlbfs pages reserved (vm.nr_hugepages), transparent ones from now on */
+        LV_LOG_INFO("No hugetlbfs pages, using transparent huge pages");
+        mem.hugetlb = false;
+    }
+
+    if (!mem.hugepages) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return p != MAP_FAILED ? p : NULL;
+    }
+
+    /* Transparent huge pages only back aligned ranges, map more and trim */
+    p = mmap(NULL, size + HUGEPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+
+    aligned = (uint8_t *)ALIGN_UP((uintptr_t)p, HUGEPAGE_SIZE);
+    head = (size_t)(aligned - p);
+    if (head > 0) {
+        munmap(p, head);
+    }
+    munmap(aligned + size, HUGEPAGE_SIZE - head);
+
+    if (madvise(aligned, size, MADV_HUGEPAGE) == 0) {
+        mem.stats.hugepages = true;
+    }
+
+    return aligned;
+}
+
+/**
+ * Add memory to the arena
+ * @return the chunk, NULL if it is too small or there are too many chunks
+ */
+static chunk_t *add_chunk(void *start, size_t size, bool mapped)
+{
+    chunk_t *chunk;
+    uint8_t *begin = (uint8_t *)ALIGN_UP((uintptr_t)start, ALIGN);
+    uint8_t *end = (uint8_t *)(((uintptr_t)start + size) & ~((uintptr_t)ALIGN - 1));
+    block_t *first;
+    block_t *sentinel;
+
+    if (mem.chunk_count == MAX_CHUNKS || end < begin ||
+        (size_t)(end - begin) < 2 * BLOCK_HDR + BLOCK_MIN) {
+        if (mapped) {
+            munmap(start, size);
+        }
+        return NULL;
+    }
+
+    /* One free block, then an empty used block stopping the merges */
+    first = (block_t *)begin;
+    first->prev_phys = NULL;
+    first->size = (size_t)(end - begin) - 2 * BLOCK_HDR;
+
+    sentinel = BLOCK_NEXT(first);
+    sentinel->prev_phys = first;
+    sentinel->size = 0;
+
+    insert_free(first);
+
+    chunk = &mem.chunks[mem.chunk_count++];
+    chunk->mem = start;
+    chunk->size = size;
+    chunk->first = first;
+    chunk->mapped = mapped;
+    mem.stats.arena_size += size;
+
+    return chunk;
+}
+
+/**
+ * Get the list of a block size
+ */
+static void mapping(size_t size, int *fl, int *sl)
+{
+    int msb;
+
+    if (size < SMALL_BLOCK_SIZE) {
+        *fl = 0;
+        *sl = (int)(size / (SMALL_BLOCK_SIZE / SL_COUNT));
+    } else {
+        msb = 63 - __builtin_clzll((unsigned long long)size);
+        *sl = (int)(size >> (msb - SL_LOG2)) ^ SL_COUNT;
+        *fl = msb - (FL_SHIFT - 1);
+    }
+}
+
+/**
+ * Find a free block of at least a size
+ * @description the size is rounded up to the next list, any block of that
+ * list fits and the search does not walk the lists
+ */
+static block_t *find_free(size_t size)
+{
+    uint32_t sl_map;
+    uint32_t fl_map;
+    int fl;
+    int sl;
+
+    if (size >= SMALL_BLOCK_SIZE) {
+        size += ((size_t)1 << (63 - __builtin_clzll((unsigned long long)size) - SL_LOG2)) - 1;
+    }
+    mapping(size, &fl, &sl);
+    if (fl >= FL_COUNT) {
+        return NULL;
+    }
+
+    sl_map = mem.sl_bitmap[fl] & (~0U << sl);
+    if (sl_map == 0) {
+        fl_map = fl + 1 < 32 ? mem.fl_bitmap & (~0U << (fl + 1)) : 0;
+        if (fl_map == 0) {
+            return NULL;
+        }
+        fl = __builtin_ctz(fl_map);
+        sl_map = mem.sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+
+    return mem.blocks[fl][sl];
+}
+
+static void insert_free(block_t *b)
+{
+    int fl;
+    int sl;
+
+    mapping(BLOCK_SIZE(b), &fl, &sl);
+
+    b->prev_free = NULL;
+    b->next_free = mem.blocks[fl][sl];
+    if (b->next_free != NULL) {
+        b->next_free->prev_free = b;
+    }
+    mem.blocks[fl][sl] = b;
+
+    mem.fl_bitmap |= 1U << fl;
+    mem.sl_bitmap[fl] |= 1U << sl;
+
+    b->size |= BLOCK_FREE;
+    mem.stats.arena_free += BLOCK_SIZE(b);
+}
+
+static void remove_free(block_t *b)
+{
+    int fl;
+    int sl;
+
+    mapping(BLOCK_SIZE(b), &fl, &sl);
+
+    if (b->prev_free != NULL) {
+        b->prev_free->next_free = b->next_free;
+    } else {
+        mem.blocks[fl][sl] = b->next_free;
+        if (b->next_free == NULL) {
+            mem.sl_bitmap[fl] &= ~(1U << sl);
+            if (mem.sl_bitmap[fl] == 0) {
+                mem.fl_bitmap &= ~(1U << fl);
+            }
+        }
+    }
+    if (b->next_free != NULL) {
+        b->next_free->prev_free = b->prev_free;
+    }
+
+    b->size &= ~BLOCK_FREE;
+    mem.stats.arena_free -= BLOCK_SIZE(b);
+}
+
+/**
+ * Shrink a used block to a size, the rest is freed if it can hold a block
+ */
+static void split(block_t *b, size_t size)
+{
+    block_t *rest;
+
+    if (BLOCK_SIZE(b) < size + sizeof(block_t)) {
+        return;
+    }
+
+    rest = (block_t *)(PAYLOAD(b) + size);
+    rest->prev_phys = b;
+    rest->size = BLOCK_SIZE(b) - size - BLOCK_HDR;
+    BLOCK_NEXT(rest)->prev_phys = rest;
+    b->size = size;
+
+    release(rest);
+}
+
+/**
+ * Free a used block, merged with the free blocks around it
+ */
+static void release(block_t *b)
+{
+    block_t *prev = b->prev_phys;
+    block_t *next;
+
+    if (prev != NULL && BLOCK_IS_FREE(prev)) {
+        remove_free(prev);
+        prev->size = BLOCK_SIZE(prev) + BLOCK_HDR + BLOCK_SIZE(b);
+        b = prev;
+        BLOCK_NEXT(b)->prev_phys = b;
+    }
+
+    next = BLOCK_NEXT(b);
+    if (BLOCK_IS_FREE(next)) {
+        remove_free(next);
+        b->size = BLOCK_SIZE(b) + BLOCK_HDR + BLOCK_SIZE(next);
+        BLOCK_NEXT(b)->prev_phys = b;
+    }
+
+    insert_free(b);
+}
+
+static void *tagged_draw_buf_malloc(size_t size, lv_color_format_t cf)
+{
+    mem_tag_t prev = current_tag;
+    void *buf;
+
+    if (prev == MEM_TAG_WIDGETS) {
+        current_tag = MEM_TAG_DRAW_BUF;
+    }
+    buf = draw_buf_malloc(size, cf);
+    current_tag = prev;
+
+    return buf;
+}
+
+static void *tagged_image_buf_malloc(size_t size, lv_color_format_t cf)
+{
+    mem_tag_t prev = current_tag;
+    void *buf;
+
+    if (prev == MEM_TAG_WIDGETS) {
+        current_tag = MEM_TAG_DRAW_BUF;
+    }
+    buf = image_buf_malloc(size, cf);
+    current_tag = prev;
+
+    return buf;
+}
+
+#endif /*LV_USE_STDLIB_MALLOC == LV_STDLIB_CUSTOM*/
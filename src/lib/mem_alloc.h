@@ -0,0 +1,113 @@
+/**
+ * @file mem_alloc.h
+ *
+ * LVGL allocator with size class pools, a TLSF arena and accounting
+ *
+ * Built when lv_conf.h selects LV_USE_STDLIB_MALLOC LV_STDLIB_CUSTOM, it
+ * provides the lv_malloc_core() family. The allocations of up to
+ * MEM_ALLOC_POOLED_MAX bytes come from per size class free lists carved
+ * out of slabs, so the short lived objects, styles and label texts reuse
+ * the same slots instead of splitting the heap. The larger ones come from
+ * a TLSF arena, in bounded time with immediate coalescing. The arena is
+ * mapped in chunks of LV_SIM_MEM_ARENA_MB (default 8), backed by huge
+ * pages when LV_SIM_MEM_HUGEPAGES is 1: hugetlbfs pages if reserved,
+ * transparent huge pages otherwise.
+ *
+ * Every allocation records the tag of its subsystem, set per thread by
+ * mem_tag_set(). The LVGL draw buffers are tagged once
+ * mem_alloc_tag_draw_bufs() is called, the rest of LVGL counts as widgets.
+ * With another LV_USE_STDLIB_MALLOC the tags are ignored and
+ * mem_alloc_get_stats() fails.
+ */
+
+#ifndef MEM_ALLOC_H
+#define MEM_ALLOC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Largest allocation served by the size class pools */
+#define MEM_ALLOC_POOLED_MAX    496
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef enum {
+    MEM_TAG_WIDGETS,                    /* objects, styles, texts, everything LVGL allocates by default */
+    MEM_TAG_DRAW_BUF,                   /* display buffers, layers and other LVGL draw buffers */
+    MEM_TAG_SAMPLER,                    /* snapshots of the sampler thread */
+    MEM_TAG_HISTORY,                    /* charts and heatmap of the dashboard */
+    MEM_TAG_COUNT
+} mem_tag_t;
+
+typedef struct {
+    size_t bytes;                       /* requested by the live allocations */
+    uint32_t count;                     /* live allocations */
+} mem_tag_usage_t;
+
+typedef struct {
+    mem_tag_usage_t tags[MEM_TAG_COUNT];
+    size_t arena_size;                  /* mapped or added to the arena */
+    size_t arena_free;                  /* free in the arena, the free slots excluded */
+    size_t pooled_size;                 /* slabs of the size class pools */
+    size_t pooled_free;                 /* free slots of the size class pools */
+    size_t peak_used;                   /* highest requested total */
+    bool hugepages;                     /* the arena is backed by huge pages */
+} mem_alloc_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Set the tag of the allocations of the calling thread
+ * @param tag the new tag
+ * @return the previous tag, to restore it
+ */
+mem_tag_t mem_tag_set(mem_tag_t tag);
+
+/**
+ * Get the name of a tag
+ * @param tag the tag
+ * @return a short name, i.e "draw"
+ */
+const char *mem_tag_name(mem_tag_t tag);
+
+/**
+ * Tag the draw buffers LVGL creates as MEM_TAG_DRAW_BUF
+ * @description call after lv_init(), the buffers created with another tag
+ * than MEM_TAG_WIDGETS keep it
+ */
+void mem_alloc_tag_draw_bufs(void);
+
+/**
+ * Get the usage of the allocator
+ * @param stats filled with the usage
+ * @return 0 on success, -1 if LVGL does not use this allocator
+ */
+int mem_alloc_get_stats(mem_alloc_stats_t *stats);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*MEM_ALLOC_H*/
@@ -0,0 +1,461 @@
+/**
+ * @file pixel_convert.c
+ *
+ * Pixel format conversion at flush time
+ *
+ * The x86 kernels are compiled with target attributes, the whole file
+ * builds with the default compiler flags and the AVX2 kernels are only
+ * called when the CPU supports them.
+ *
+ * RGB565 is widened by replicating the high bits into the low bits so
+ * that white stays white, XRGB8888 is narrowed by truncation, both as
+ * LVGL does.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXEL_CONVERT_X86   1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PIXEL_CONVERT_NEON  1
+#endif
+
+#include "pixel_convert.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void rgb565_to_xrgb8888_scalar(void *dst, const void *src, uint32_t count);
+static void xrgb8888_to_rgb565_scalar(void *dst, const void *src, uint32_t count);
+static void rgb565_swap_scalar(void *dst, const void *src, uint32_t count);
+
+#if PIXEL_CONVERT_X86
+static void rgb565_to_xrgb8888_sse2(void *dst, const void *src, uint32_t count);
+static void xrgb8888_to_rgb565_sse2(void *dst, const void *src, uint32_t count);
+static void rgb565_swap_sse2(void *dst, const void *src, uint32_t count);
+static void rgb565_to_xrgb8888_avx2(void *dst, const void *src, uint32_t count);
+static void xrgb8888_to_rgb565_avx2(void *dst, const void *src, uint32_t count);
+static void rgb565_swap_avx2(void *dst, const void *src, uint32_t count);
+#endif
+
+#if PIXEL_CONVERT_NEON
+static void rgb565_to_xrgb8888_neon(void *dst, const void *src, uint32_t count);
+static void xrgb8888_to_rgb565_neon(void *dst, const void *src, uint32_t count);
+static void rgb565_swap_neon(void *dst, const void *src, uint32_t count);
+#endif
+
+static const pixel_convert_ops_t *select_ops(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static const pixel_convert_ops_t ops_scalar = {
+    .name = "scalar",
+    .rgb565_to_xrgb8888 = rgb565_to_xrgb8888_scalar,
+    .xrgb8888_to_rgb565 = xrgb8888_to_rgb565_scalar,
+    .rgb565_swap = rgb565_swap_scalar,
+};
+
+#if PIXEL_CONVERT_X86
+static const pixel_convert_ops_t ops_sse2 = {
+    .name = "sse2",
+    .rgb565_to_xrgb8888 = rgb565_to_xrgb8888_sse2,
+    .xrgb8888_to_rgb565 = xrgb8888_to_rgb565_sse2,
+    .rgb565_swap = rgb565_swap_sse2,
+};
+
+static const pixel_convert_ops_t ops_avx2 = {
+    .name = "avx2",
+    .rgb565_to_xrgb8888 = rgb565_to_xrgb8888_avx2,
+    .xrgb8888_to_rgb565 = xrgb8888_to_rgb565_avx2,
+    .rgb565_swap = rgb565_swap_avx2,
+};
+#endif
+
+#if PIXEL_CONVERT_NEON
+static const pixel_convert_ops_t ops_neon = {
+    .name = "neon",
+    .rgb565_to_xrgb8888 = rgb565_to_xrgb8888_neon,
+    .xrgb8888_to_rgb565 = xrgb8888_to_rgb565_neon,
+    .rgb565_swap = rgb565_swap_neon,
+};
+#endif
+
+static const pixel_convert_ops_t *selected;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+const pixel_convert_ops_t *pixel_convert_get(void)
+{
+    const pixel_convert_ops_t *ops = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+
+    /* Selecting twice from two threads gives the same result */
+    if (ops == NULL) {
+        ops = select_ops();
+        __atomic_store_n(&selected, ops, __ATOMIC_RELEASE);
+    }
+
+    return ops;
+}
+
+int pixel_convert_get_all(const pixel_convert_ops_t **ops, int max)
+{
+    int count = 0;
+
+    if (count < max) {
+        ops[count++] = &ops_scalar;
+    }
+
+#if PIXEL_CONVERT_X86
+    __builtin_cpu_init();
+
+    if (count < max && __builtin_cpu_supports("sse2")) {
+        ops[count++] = &ops_sse2;
+    }
+
+    if (count < max && __builtin_cpu_supports("avx2")) {
+        ops[count++] = &ops_avx2;
+    }
+#endif
+
+#if PIXEL_CONVERT_NEON
+    if (count < max) {
+        ops[count++] = &ops_neon;
+    }
+#endif
+
+    return count;
+}
+
+void pixel_convert_area(pixel_convert_fn_t fn, uint8_t *dst, uint32_t dst_stride,
+                        const uint8_t *src, uint32_t src_stride, uint32_t w, uint32_t h)
+{
+    uint32_t y;
+
+    for (y = 0; y < h; y++) {
+        fn(dst, src, w);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Pick the last implementation supported, they are listed from the
+ * slowest to the fastest
+ */
+static const pixel_convert_ops_t *select_ops(void)
+{
+    const pixel_convert_ops_t *all[PIXEL_CONVERT_MAX_IMPLS];
+    const char *name = getenv("LV_SIM_PIXEL_CONVERT");
+    int count = pixel_convert_get_all(all, PIXEL_CONVERT_MAX_IMPLS);
+    int i;
+
+    if (name != NULL) {
+        for (i = 0; i < count; i++) {
+            if (strcmp(all[i]->name, name) == 0) {
+                return all[i];
+            }
+        }
+    }
+
+    return all[count - 1];
+}
+
+static void rgb565_to_xrgb8888_scalar(void *dst, const void *src, uint32_t count)
+{
+    const uint16_t *s = src;
+    uint32_t *d = dst;
+    uint32_t r;
+    uint32_t g;
+    uint32_t b;
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        r = s[i] >> 11;
+        g = (s[i] >> 5) & 0x3F;
+        b = s[i] & 0x1F;
+
+        r = (r << 3) | (r >> 2);
+        g = (g << 2) | (g >> 4);
+        b = (b << 3) | (b >> 2);
+
+        d[i] = 0xFF000000u | (r << 16) | (g << 8) | b;
+    }
+}
+
+static void xrgb8888_to_rgb565_scalar(void *dst, const void *src, uint32_t count)
+{
+    const uint32_t *s = src;
+    uint16_t *d = dst;
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        d[i] = (uint16_t)(((s[i] >> 8) & 0xF800) | ((s[i] >> 5) & 0x07E0) | ((s[i] >> 3) & 0x001F));
+    }
+}
+
+static void rgb565_swap_scalar(void *dst, const void *src, uint32_t count)
+{
+    const uint16_t *s = src;
+    uint16_t *d = dst;
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        d[i] = (uint16_t)((s[i] << 8) | (s[i] >> 8));
+    }
+}
+
+#if PIXEL_CONVERT_X86
+
+__attribute__((target("sse2")))
+static void rgb565_to_xrgb8888_sse2(void *dst, const void *src, uint32_t count)
+{
+    const uint16_t *s = src;
+    uint32_t *d = dst;
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    const __m128i mask6 = _mm_set1_epi16(0x3F);
+    const __m128i alpha = _mm_set1_epi16((short)0xFF00);
+    __m128i p, r, g, b, gb, ar;
+    uint32_t i = 0;
+
+    /* 8 pixels per iteration, GB and AR halves interleaved into 32 bits */
+    for (; i + 8 <= count; i += 8) {
+        p = _mm_loadu_si128((const __m128i *)(s + i));
+
+        r = _mm_srli_epi16(p, 11);
+        g = _mm_and_si128(_mm_srli_epi16(p, 5), mask6);
+        b = _mm_and_si128(p, mask5);
+
+        r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+        g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+        b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+        gb = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+        ar = _mm_or_si128(alpha, r);
+
+        _mm_storeu_si128((__m128i *)(d + i), _mm_unpacklo_epi16(gb, ar));
+        _mm_storeu_si128((__m128i *)(d + i + 4), _mm_unpackhi_epi16(gb, ar));
+    }
+
+    rgb565_to_xrgb8888_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void xrgb8888_to_rgb565_sse2(void *dst, const void *src, uint32_t count)
+{
+    const uint32_t *s = src;
+    uint16_t *d = dst;
+    const __m128i mask_r = _mm_set1_epi32(0xF800);
+    const __m128i mask_g = _mm_set1_epi32(0x07E0);
+    const __m128i mask_b = _mm_set1_epi32(0x001F);
+    __m128i lo, hi;
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        lo = _mm_loadu_si128((const __m128i *)(s + i));
+        hi = _mm_loadu_si128((const __m128i *)(s + i + 4));
+
+        lo = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(lo, 8), mask_r),
+                                       _mm_and_si128(_mm_srli_epi32(lo, 5), mask_g)),
+                          _mm_and_si128(_mm_srli_epi32(lo, 3), mask_b));
+        hi = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(hi, 8), mask_r),
+                                       _mm_and_si128(_mm_srli_epi32(hi, 5), mask_g)),
+                          _mm_and_si128(_mm_srli_epi32(hi, 3), mask_b));
+
+        /* SSE2 only packs with signed saturation, sign extend the 16 bits first */
+        lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+        hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+
+        _mm_storeu_si128((__m128i *)(d + i), _mm_packs_epi32(lo, hi));
+    }
+
+    xrgb8888_to_rgb565_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void rgb565_swap_sse2(void *dst, const void *src, uint32_t count)
+{
+    const uint16_t *s = src;
+    uint16_t *d = dst;
+    __m128i p;
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        p = _mm_loadu_si128((const __m128i *)(s + i));
+        _mm_storeu_si128((__m128i *)(d + i), _mm_or_si128(_mm_slli_epi16(p, 8), _mm_srli_epi16(p, 8)));
+    }
+
+    rgb565_swap_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void rgb565_to_xrgb8888_avx2(void *dst, const void *src, uint32_t count)
+{
+    const uint16_t *s = src;
+    uint32_t *d = dst;
+    const __m256i mask5 = _mm256_set1_epi32(0x1F);
+    const __m256i mask6 = _mm256_set1_epi32(0x3F);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+    __m256i p, r, g, b;
+    uint32_t i = 0;
+
+    /* Widened to 32 bits on load, the lanes stay in order */
+    for (; i + 8 <= count; i += 8) {
+        p = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(s + i)));
+
+        r = _mm256_srli_epi32(p, 11);
+        g = _mm256_and_si256(_mm256_srli_epi32(p, 5), mask6);
+        b = _mm256_and_si256(p, mask5);
+
+        r = _mm256_or_si256(_mm256_slli_epi32(r, 3), _mm256_srli_epi32(r, 2));
+        g = _mm256_or_si256(_mm256_slli_epi32(g, 2), _mm256_srli_epi32(g, 4));
+        b = _mm256_or_si256(_mm256_slli_epi32(b, 3), _mm256_srli_epi32(b, 2));
+
+        p = _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(r, 16)),
+                            _mm256_or_si256(_mm256_slli_epi32(g, 8), b));
+
+        _mm256_storeu_si256((__m256i *)(d + i), p);
+    }
+
+    rgb565_to_xrgb8888_sse2(d + i, s + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void xrgb8888_to_rgb565_avx2(void *dst, const void *src, uint32_t count)
+{
+    const uint32_t *s = src;
+    uint16_t *d = dst;
+    const __m256i mask_r = _mm256_set1_epi32(0xF800);
+    const __m256i mask_g = _mm256_set1_epi32(0x07E0);
+    const __m256i mask_b = _mm256_set1_epi32(0x001F);
+    __m256i lo, hi, p;
+    uint32_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        lo = _mm256_loadu_si256((const __m256i *)(s + i));
+        hi = _mm256_loadu_si256((const __m256i *)(s + i + 8));
+
+        lo = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(lo, 8), mask_r),
+                                             _mm256_and_si256(_mm256_srli_epi32(lo, 5), mask_g)),
+                             _mm256_and_si256(_mm256_srli_epi32(lo, 3), mask_b));
+        hi = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(hi, 8), mask_r),
+                                             _mm256_and_si256(_mm256_srli_epi32(hi, 5), mask_g)),
+                             _mm256_and_si256(_mm256_srli_epi32(hi, 3), mask_b));
+
+        /* The pack works per 128 bit lane, put the quadwords back in order */
+        p = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8);
+
+        _mm256_storeu_si256((__m256i *)(d + i), p);
+    }
+
+    xrgb8888_to_rgb565_sse2(d + i, s + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void rgb565_swap_avx2(void *dst, const void *src, uint32_t count)
+{
+    const uint16_t *s = src;
+    uint16_t *d = dst;
+    __m256i p;
+    uint32_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        p = _mm256_loadu_si256((const __m256i *)(s + i));
+        _mm256_storeu_si256((__m256i *)(d + i), _mm256_or_si256(_mm256_slli_epi16(p, 8), _mm256_srli_epi16(p, 8)));
+    }
+
+    rgb565_swap_sse2(d + i, s + i, count - i);
+}
+
+#endif /*PIXEL_CONVERT_X86*/
+
+#if PIXEL_CONVERT_NEON
+
+static void rgb565_to_xrgb8888_neon(void *dst, const void *src, uint32_t count)
+{
+    const uint16_t *s = src;
+    uint32_t *d = dst;
+    uint16x8_t p, r, g, b;
+    uint8x8x4_t out;
+    uint32_t i = 0;
+
+    out.val[3] = vdup_n_u8(0xFF);
+
+    /* The channels are stored interleaved as B, G, R, A bytes */
+    for (; i + 8 <= count; i += 8) {
+        p = vld1q_u16(s + i);
+
+        r = vshrq_n_u16(p, 11);
+        g = vandq_u16(vshrq_n_u16(p, 5), vdupq_n_u16(0x3F));
+        b = vandq_u16(p, vdupq_n_u16(0x1F));
+
+        out.val[2] = vmovn_u16(vorrq_u16(vshlq_n_u16(r, 3), vshrq_n_u16(r, 2)));
+        out.val[1] = vmovn_u16(vorrq_u16(vshlq_n_u16(g, 2), vshrq_n_u16(g, 4)));
+        out.val[0] = vmovn_u16(vorrq_u16(vshlq_n_u16(b, 3), vshrq_n_u16(b, 2)));
+
+        vst4_u8((uint8_t *)(d + i), out);
+    }
+
+    rgb565_to_xrgb8888_scalar(d + i, s + i, count - i);
+}
+
+static void xrgb8888_to_rgb565_neon(void *dst, const void *src, uint32_t count)
+{
+    const uint32_t *s = src;
+    uint16_t *d = dst;
+    uint8x8x4_t in;
+    uint16x8_t p;
+    uint32_t i = 0;
+
+    /* Each channel is moved to the top of 16 bits, then shifted in below the previous one */
+    for (; i + 8 <= count; i += 8) {
+        in = vld4_u8((const uint8_t *)(s + i));
+
+        p = vshll_n_u8(in.val[2], 8);
+        p = vsriq_n_u16(p, vshll_n_u8(in.val[1], 8), 5);
+        p = vsriq_n_u16(p, vshll_n_u8(in.val[0], 8), 11);
+
+        vst1q_u16(d + i, p);
+    }
+
+    xrgb8888_to_rgb565_scalar(d + i, s + i, count - i);
+}
+
+static void rgb565_swap_neon(void *dst, const void *src, uint32_t count)
+{
+    const uint16_t *s = src;
+    uint16_t *d = dst;
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u16(d + i, vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(vld1q_u16(s + i)))));
+    }
+
+    rgb565_swap_scalar(d + i, s + i, count - i);
+}
+
+#endif /*PIXEL_CONVERT_NEON*/
@@ -0,0 +1,87 @@
+/**
+ * @file pixel_convert.h
+ *
+ * Pixel format conversion at flush time
+ *
+ * Converts the areas rendered by LVGL into the format scanned out by the
+ * display when the two differ. The kernels are vectorized with NEON on
+ * ARM and SSE2/AVX2 on x86, the best one supported by the CPU is
+ * selected at runtime.
+ */
+
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Number of implementations, see pixel_convert_get_all() */
+#define PIXEL_CONVERT_MAX_IMPLS     4
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Prototype of a kernel, converts count pixels, dst and src do not overlap */
+typedef void (*pixel_convert_fn_t)(void *dst, const void *src, uint32_t count);
+
+/* The kernels of an instruction set */
+typedef struct {
+    const char *name;
+    pixel_convert_fn_t rgb565_to_xrgb8888;  /* Sets the alpha to 0xFF, the result is also ARGB8888 */
+    pixel_convert_fn_t xrgb8888_to_rgb565;  /* Ignores the alpha, works on ARGB8888 too */
+    pixel_convert_fn_t rgb565_swap;         /* Swaps the bytes, RGB565 <-> RGB565_SWAPPED */
+} pixel_convert_ops_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Get the kernels to use
+ * @description the fastest implementation supported by the CPU, or the
+ * one named by the LV_SIM_PIXEL_CONVERT environment variable
+ * @return the kernels
+ */
+const pixel_convert_ops_t *pixel_convert_get(void);
+
+/**
+ * Get all the implementations supported by the CPU
+ * @param ops the array receiving them, the scalar one first
+ * @param max the size of the array
+ * @return the number of implementations
+ */
+int pixel_convert_get_all(const pixel_convert_ops_t **ops, int max);
+
+/**
+ * Convert a rectangle of pixels
+ * @param fn the kernel
+ * @param dst the first destination pixel
+ * @param dst_stride the number of bytes per row of the destination
+ * @param src the first source pixel
+ * @param src_stride the number of bytes per row of the source
+ * @param w the number of pixels per row
+ * @param h the number of rows
+ */
+void pixel_convert_area(pixel_convert_fn_t fn, uint8_t *dst, uint32_t dst_stride,
+                        const uint8_t *src, uint32_t src_stride, uint32_t w, uint32_t h);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*PIXEL_CONVERT_H*/
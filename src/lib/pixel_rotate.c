@@ -0,0 +1,526 @@
+/**
+ * @file pixel_rotate.c
+ *
+ * Software rotation of the flushed areas
+ *
+ * A 90 or 270 degrees rotation reads the frame by rows and writes the
+ * frame buffer by columns. The area is split into blocks whose source
+ * and destination rows fit in the L1 cache together, the blocks into
+ * tiles transposed in registers: 8x8 pixels of 16 bits or 4x4 pixels
+ * of 32 bits. Only the pixels at the edges of the area that do not fill
+ * a tile are copied one by one.
+ *
+ * The 180 degrees rotation mirrors the rows, it reads and writes
+ * sequentially and needs no blocking.
+ *
+ * SSE2 and NEON are part of the x86_64 and aarch64 baselines, the
+ * kernels are selected at compile time.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXEL_ROTATE_SSE2   1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PIXEL_ROTATE_NEON   1
+#endif
+
+#include "pixel_rotate.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Pixels per side of a block, 64x64 pixels of 32 bits read and written use 32 KiB */
+#define PIXEL_ROTATE_BLOCK      64
+
+/* Pixels per side of the largest tile */
+#define PIXEL_ROTATE_TILE_MAX   8
+
+/* Pixels mirrored per step when converting */
+#define PIXEL_ROTATE_CHUNK      64
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Prototype of a tile transpose, row i of dst is column i of src, the strides may be negative */
+typedef void (*transpose_fn_t)(uint8_t *dst, intptr_t dst_stride, const uint8_t *src, intptr_t src_stride);
+
+/* Prototype of a mirror, dst[i] = src[count - 1 - i] */
+typedef void (*reverse_fn_t)(void *dst, const void *src, uint32_t count);
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void rotate_0(const pixel_rotate_t *rot, const lv_area_t *area);
+static void rotate_180(const pixel_rotate_t *rot, const lv_area_t *area);
+static void rotate_90_270(const pixel_rotate_t *rot, const lv_area_t *area);
+static void rotate_block(const pixel_rotate_t *rot, int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+static void rotate_tile(const pixel_rotate_t *rot, int32_t x, int32_t y, uint32_t n, transpose_fn_t transpose);
+static void rotate_pixels(const pixel_rotate_t *rot, int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+static uint8_t *dst_pixel(const pixel_rotate_t *rot, int32_t x, int32_t y);
+static void transpose16_8x8(uint8_t *dst, intptr_t dst_stride, const uint8_t *src, intptr_t src_stride);
+static void transpose32_4x4(uint8_t *dst, intptr_t dst_stride, const uint8_t *src, intptr_t src_stride);
+static void reverse16(void *dst, const void *src, uint32_t count);
+static void reverse32(void *dst, const void *src, uint32_t count);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void pixel_rotate_get_area(const pixel_rotate_t *rot, const lv_area_t *area, lv_area_t *rotated)
+{
+    int32_t w = (int32_t)rot->w;
+    int32_t h = (int32_t)rot->h;
+
+    switch (rot->rotation) {
+    case LV_DISPLAY_ROTATION_90:
+        rotated->x1 = area->y1;
+        rotated->x2 = area->y2;
+        rotated->y1 = w - 1 - area->x2;
+        rotated->y2 = w - 1 - area->x1;
+        break;
+    case LV_DISPLAY_ROTATION_180:
+        rotated->x1 = w - 1 - area->x2;
+        rotated->x2 = w - 1 - area->x1;
+        rotated->y1 = h - 1 - area->y2;
+        rotated->y2 = h - 1 - area->y1;
+        break;
+    case LV_DISPLAY_ROTATION_270:
+        rotated->x1 = h - 1 - area->y2;
+        rotated->x2 = h - 1 - area->y1;
+        rotated->y1 = area->x1;
+        rotated->y2 = area->x2;
+        break;
+    default:
+        *rotated = *area;
+        break;
+    }
+}
+
+void pixel_rotate_area(const pixel_rotate_t *rot, const lv_area_t *area)
+{
+    switch (rot->rotation) {
+    case LV_DISPLAY_ROTATION_90:
+    case LV_DISPLAY_ROTATION_270:
+        rotate_90_270(rot, area);
+        break;
+    case LV_DISPLAY_ROTATION_180:
+        rotate_180(rot, area);
+        break;
+    default:
+        rotate_0(rot, area);
+        break;
+    }
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void rotate_0(const pixel_rotate_t *rot, const lv_area_t *area)
+{
+    const uint8_t *src = rot->src + area->y1 * rot->src_stride + area->x1 * rot->src_px_size;
+    uint8_t *dst = dst_pixel(rot, area->x1, area->y1);
+    uint32_t w = (uint32_t)lv_area_get_width(area);
+    uint32_t h = (uint32_t)lv_area_get_height(area);
+    uint32_t y;
+
+    if (rot->convert != NULL) {
+        pixel_convert_area(rot->convert, dst, rot->dst_stride, src, rot->src_stride, w, h);
+        return;
+    }
+
+    for (y = 0; y < h; y++) {
+        memcpy(dst, src, w * rot->src_px_size);
+        dst += rot->dst_stride;
+        src += rot->src_stride;
+    }
+}
+
+static void rotate_180(const pixel_rotate_t *rot, const lv_area_t *area)
+{
+    uint8_t tmp[PIXEL_ROTATE_CHUNK * 4];
+    reverse_fn_t reverse = rot->src_px_size == 2 ? reverse16 : reverse32;
+    uint32_t w = (uint32_t)lv_area_get_width(area);
+    const uint8_t *src;
+    uint8_t *dst;
+    uint32_t count;
+    uint32_t done;
+    int32_t y;
+
+    for (y = area->y1; y <= area->y2; y++) {
+        /* The last pixel of the source row is the first of the destination row */
+        src = rot->src + y * rot->src_stride + area->x1 * rot->src_px_size;
+        dst = dst_pixel(rot, area->x2, y);
+
+        if (rot->convert == NULL) {
+            reverse(dst, src, w);
+            continue;
+        }
+
+        for (done = 0; done < w; done += count) {
+            count = w - done < PIXEL_ROTATE_CHUNK ? w - done : PIXEL_ROTATE_CHUNK;
+            reverse(tmp, src + (w - done - count) * rot->src_px_size, count);
+            rot->convert(dst + done * rot->dst_px_size, tmp, count);
+        }
+    }
+}
+
+static void rotate_90_270(const pixel_rotate_t *rot, const lv_area_t *area)
+{
+    int32_t x;
+    int32_t y;
+
+    for (y = area->y1; y <= area->y2; y += PIXEL_ROTATE_BLOCK) {
+        for (x = area->x1; x <= area->x2; x += PIXEL_ROTATE_BLOCK) {
+            rotate_block(rot, x, y, LV_MIN(x + PIXEL_ROTATE_BLOCK - 1, area->x2),
+                         LV_MIN(y + PIXEL_ROTATE_BLOCK - 1, area->y2));
+        }
+    }
+}
+
+static void rotate_block(const pixel_rotate_t *rot, int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+    transpose_fn_t transpose = rot->src_px_size == 2 ? transpose16_8x8 : transpose32_4x4;
+    int32_t n = rot->src_px_size == 2 ? 8 : 4;
+    int32_t x;
+    int32_t y;
+
+    for (y = y1; y + n - 1 <= y2; y += n) {
+        for (x = x1; x + n - 1 <= x2; x += n) {
+            rotate_tile(rot, x, y, (uint32_t)n, transpose);
+        }
+
+        if (x <= x2) {
+            rotate_pixels(rot, x, y, x2, y + n - 1);
+        }
+    }
+
+    if (y <= y2) {
+        rotate_pixels(rot, x1, y, x2, y2);
+    }
+}
+
+/**
+ * Rotate the tile of n x n pixels at x, y
+ */
+static void rotate_tile(const pixel_rotate_t *rot, int32_t x, int32_t y, uint32_t n, transpose_fn_t transpose)
+{
+    uint8_t tmp[PIXEL_ROTATE_TILE_MAX * PIXEL_ROTATE_TILE_MAX * 4];
+    intptr_t src_stride = (intptr_t)rot->src_stride;
+    intptr_t dst_stride = (intptr_t)rot->dst_stride;
+    const uint8_t *src;
+    uint8_t *dst;
+    uint32_t i;
+
+    if (rot->rotation == LV_DISPLAY_ROTATION_90) {
+        /* Column x + i goes to row w - 1 - x - i, from top to bottom */
+        src = rot->src + y * src_stride + x * (intptr_t)rot->src_px_size;
+        dst = dst_pixel(rot, x, y);
+        dst_stride = -dst_stride;
+    } else {
+        /* Column x + i goes to row x + i, from bottom to top */
+        src = rot->src + (y + (int32_t)n - 1) * src_stride + x * (intptr_t)rot->src_px_size;
+        dst = dst_pixel(rot, x, y + (int32_t)n - 1);
+        src_stride = -src_stride;
+    }
+
+    if (rot->convert == NULL) {
+        transpose(dst, dst_stride, src, src_stride);
+        return;
+    }
+
+    transpose(tmp, (intptr_t)(n * rot->src_px_size), src, src_stride);
+
+    for (i = 0; i < n; i++) {
+        rot->convert(dst + (intptr_t)i * dst_stride, tmp + i * n * rot->src_px_size, n);
+    }
+}
+
+/**
+ * Rotate the pixels that do not fill a tile one by one
+ */
+static void rotate_pixels(const pixel_rotate_t *rot, int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+    const uint8_t *src;
+    uint8_t *dst;
+    int32_t x;
+    int32_t y;
+
+    for (y = y1; y <= y2; y++) {
+        for (x = x1; x <= x2; x++) {
+            src = rot->src + y * rot->src_stride + x * rot->src_px_size;
+            dst = dst_pixel(rot, x, y);
+
+            if (rot->convert != NULL) {
+                rot->convert(dst, src, 1);
+            } else {
+                memcpy(dst, src, rot->src_px_size);
+            }
+        }
+    }
+}
+
+/**
+ * Get the address in the rotated frame buffer of the pixel x, y of the frame
+ */
+static uint8_t *dst_pixel(const pixel_rotate_t *rot, int32_t x, int32_t y)
+{
+    int32_t w = (int32_t)rot->w;
+    int32_t h = (int32_t)rot->h;
+    int32_t col;
+    int32_t row;
+
+    switch (rot->rotation) {
+    case LV_DISPLAY_ROTATION_90:
+        col = y;
+        row = w - 1 - x;
+        break;
+    case LV_DISPLAY_ROTATION_180:
+        col = w - 1 - x;
+        row = h - 1 - y;
+        break;
+    case LV_DISPLAY_ROTATION_270:
+        col = h - 1 - y;
+        row = x;
+        break;
+    default:
+        col = x;
+        row = y;
+        break;
+    }
+
+    return rot->dst + (intptr_t)row * rot->dst_stride + (intptr_t)col * rot->dst_px_size;
+}
+
+#if PIXEL_ROTATE_SSE2
+
+static void transpose16_8x8(uint8_t *dst, intptr_t dst_stride, const uint8_t *src, intptr_t src_stride)
+{
+    __m128i r[8];
+    __m128i a[8];
+    __m128i b[8];
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        r[i] = _mm_loadu_si128((const __m128i *)(src + i * src_stride));
+    }
+
+    /* Interleave 16, 32 then 64 bits, pairs of rows, then quads, then halves */
+    for (i = 0; i < 4; i++) {
+        a[i * 2] = _mm_unpacklo_epi16(r[i * 2], r[i * 2 + 1]);
+        a[i * 2 + 1] = _mm_unpackhi_epi16(r[i * 2], r[i * 2 + 1]);
+    }
+
+    for (i = 0; i < 2; i++) {
+        b[i * 4] = _mm_unpacklo_epi32(a[i * 4], a[i * 4 + 2]);
+        b[i * 4 + 1] = _mm_unpackhi_epi32(a[i * 4], a[i * 4 + 2]);
+        b[i * 4 + 2] = _mm_unpacklo_epi32(a[i * 4 + 1], a[i * 4 + 3]);
+        b[i * 4 + 3] = _mm_unpackhi_epi32(a[i * 4 + 1], a[i * 4 + 3]);
+    }
+
+    for (i = 0; i < 4; i++) {
+        _mm_storeu_si128((__m128i *)(dst + (i * 2) * dst_stride), _mm_unpacklo_epi64(b[i], b[i + 4]));
+        _mm_storeu_si128((__m128i *)(dst + (i * 2 + 1) * dst_stride), _mm_unpackhi_epi64(b[i], b[i + 4]));
+    }
+}
+
+static void transpose32_4x4(uint8_t *dst, intptr_t dst_stride, const uint8_t *src, intptr_t src_stride)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)src);
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(src + src_stride));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(src + 2 * src_stride));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(src + 3 * src_stride));
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)(dst + dst_stride), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)(dst + 2 * dst_stride), _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i *)(dst + 3 * dst_stride), _mm_unpackhi_epi64(t2, t3));
+}
+
+static void reverse16(void *dst, const void *src, uint32_t count)
+{
+    const uint16_t *s = src;
+    uint16_t *d = dst;
+    __m128i v;
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        v = _mm_loadu_si128((const __m128i *)(s + count - i - 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_si128((__m128i *)(d + i), _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    for (; i < count; i++) {
+        d[i] = s[count - 1 - i];
+    }
+}
+
+static void reverse32(void *dst, const void *src, uint32_t count)
+{
+    const uint32_t *s = src;
+    uint32_t *d = dst;
+    __m128i v;
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        v = _mm_loadu_si128((const __m128i *)(s + count - i - 4));
+        _mm_storeu_si128((__m128i *)(d + i), _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+
+    for (; i < count; i++) {
+        d[i] = s[count - 1 - i];
+    }
+}
+
+#elif PIXEL_ROTATE_NEON
+
+static void transpose16_8x8(uint8_t *dst, intptr_t dst_stride, const uint8_t *src, intptr_t src_stride)
+{
+    uint16x8_t r[8];
+    uint16x8x2_t t[4];
+    uint32x4x2_t u[4];
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        r[i] = vld1q_u16((const uint16_t *)(src + i * src_stride));
+    }
+
+    /* Transpose the 2x2 blocks of 16 bits, then of 32 bits, then swap the 64 bit halves */
+    for (i = 0; i < 4; i++) {
+        t[i] = vtrnq_u16(r[i * 2], r[i * 2 + 1]);
+    }
+
+    for (i = 0; i < 2; i++) {
+        u[i * 2] = vtrnq_u32(vreinterpretq_u32_u16(t[i * 2].val[0]), vreinterpretq_u32_u16(t[i * 2 + 1].val[0]));
+        u[i * 2 + 1] = vtrnq_u32(vreinterpretq_u32_u16(t[i * 2].val[1]), vreinterpretq_u32_u16(t[i * 2 + 1].val[1]));
+    }
+
+    /* u[0]: columns 0 and 4 of rows 0-3 then columns 2 and 6, u[1]: columns 1, 5 then 3, 7 */
+    for (i = 0; i < 4; i++) {
+        uint32x4_t top = u[i & 1].val[i >> 1];
+        uint32x4_t bottom = u[2 + (i & 1)].val[i >> 1];
+        int col = (i & 1) + (i >> 1) * 2;
+
+        vst1q_u16((uint16_t *)(dst + col * dst_stride),
+                  vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(top), vget_low_u32(bottom))));
+        vst1q_u16((uint16_t *)(dst + (col + 4) * dst_stride),
+                  vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(top), vget_high_u32(bottom))));
+    }
+}
+
+static void transpose32_4x4(uint8_t *dst, intptr_t dst_stride, const uint8_t *src, intptr_t src_stride)
+{
+    uint32x4x2_t t01 = vtrnq_u32(vld1q_u32((const uint32_t *)src), vld1q_u32((const uint32_t *)(src + src_stride)));
+    uint32x4x2_t t23 = vtrnq_u32(vld1q_u32((const uint32_t *)(src + 2 * src_stride)),
+                                 vld1q_u32((const uint32_t *)(src + 3 * src_stride)));
+
+    vst1q_u32((uint32_t *)dst, vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+    vst1q_u32((uint32_t *)(dst + dst_stride), vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+    vst1q_u32((uint32_t *)(dst + 2 * dst_stride), vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+    vst1q_u32((uint32_t *)(dst + 3 * dst_stride), vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+}
+
+static void reverse16(void *dst, const void *src, uint32_t count)
+{
+    const uint16_t *s = src;
+    uint16_t *d = dst;
+    uint16x8_t v;
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        v = vrev64q_u16(vld1q_u16(s + count - i - 8));
+        vst1q_u16(d + i, vextq_u16(v, v, 4));
+    }
+
+    for (; i < count; i++) {
+        d[i] = s[count - 1 - i];
+    }
+}
+
+static void reverse32(void *dst, const void *src, uint32_t count)
+{
+    const uint32_t *s = src;
+    uint32_t *d = dst;
+    uint32x4_t v;
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        v = vrev64q_u32(vld1q_u32(s + count - i - 4));
+        vst1q_u32(d + i, vextq_u32(v, v, 2));
+    }
+
+    for (; i < count; i++) {
+        d[i] = s[count - 1 - i];
+    }
+}
+
+#else
+
+static void transpose16_8x8(uint8_t *dst, intptr_t dst_stride, const uint8_t *src, intptr_t src_stride)
+{
+    int i;
+    int j;
+
+    for (i = 0; i < 8; i++) {
+        for (j = 0; j < 8; j++) {
+            ((uint16_t *)(dst + i * dst_stride))[j] = ((const uint16_t *)(src + j * src_stride))[i];
+        }
+    }
+}
+
+static void transpose32_4x4(uint8_t *dst, intptr_t dst_stride, const uint8_t *src, intptr_t src_stride)
+{
+    int i;
+    int j;
+
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 4; j++) {
+            ((uint32_t *)(dst + i * dst_stride))[j] = ((const uint32_t *)(src + j * src_stride))[i];
+        }
+    }
+}
+
+static void reverse16(void *dst, const void *src, uint32_t count)
+{
+    const uint16_t *s = src;
+    uint16_t *d = dst;
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        d[i] = s[count - 1 - i];
+    }
+}
+
+static void reverse32(void *dst, const void *src, uint32_t count)
+{
+    const uint32_t *s = src;
+    uint32_t *d = dst;
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        d[i] = s[count - 1 - i];
+    }
+}
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * @file pixel_rotate.h
+ *
+ * Software rotation of the flushed areas
+ *
+ * Rotates the areas rendered by LVGL into the frame buffer of a panel
+ * mounted in another orientation, with the mapping of
+ * lv_display_rotate_area(). The 90 and 270 degrees rotations transpose
+ * blocks of pixels small enough to stay in the cache, with SSE2 or NEON
+ * when available.
+ */
+
+#ifndef PIXEL_ROTATE_H
+#define PIXEL_ROTATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "pixel_convert.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* A frame and the rotated frame buffer it is copied into */
+typedef struct {
+    const uint8_t *src;
+    uint32_t src_stride;
+    uint32_t src_px_size;               /* 2 or 4 bytes */
+    uint32_t w;                         /* size of the frame before rotation */
+    uint32_t h;
+    uint8_t *dst;
+    uint32_t dst_stride;
+    uint32_t dst_px_size;
+    lv_display_rotation_t rotation;
+    pixel_convert_fn_t convert;         /* NULL if both have the same format */
+} pixel_rotate_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Get the position of an area in the rotated frame
+ * @param rot the frames
+ * @param area an area of the frame
+ * @param rotated receives the area in the rotated frame
+ */
+void pixel_rotate_get_area(const pixel_rotate_t *rot, const lv_area_t *area, lv_area_t *rotated);
+
+/**
+ * Copy an area of the frame into the rotated frame buffer
+ * @description the pixels are converted on the way when rot->convert is set
+ * @param rot the frames
+ * @param area the area of the frame to copy
+ */
+void pixel_rotate_area(const pixel_rotate_t *rot, const lv_area_t *area);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*PIXEL_ROTATE_H*/
@@ -0,0 +1,156 @@
+/**
+ * @file realtime.c
+ *
+ * Low jitter mode of the render thread
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "realtime.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Stack faulted in, the deepest rendering paths use less */
+#define PREFAULT_STACK_SIZE     (512 * 1024)
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static bool memlock_unlimited(void);
+static void prefault_stack(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int realtime_lock_memory(void)
+{
+    int flags = MCL_CURRENT;
+
+    /* Freed memory stays in the heap, allocating it again does not fault */
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    /* MCL_FUTURE populates the mappings when they are created, past the limit they fail */
+    if (memlock_unlimited()) {
+        flags |= MCL_FUTURE;
+    }
+
+    if (mlockall(flags) != 0) {
+        return -1;
+    }
+
+    prefault_stack();
+    return flags & MCL_FUTURE ? 0 : 1;
+}
+
+void realtime_prefault(void *addr, size_t size)
+{
+    volatile uint8_t *p = addr;
+    long page = sysconf(_SC_PAGESIZE);
+    size_t i;
+
+    if (p == NULL || size == 0) {
+        return;
+    }
+
+    /* Written back so that a private or shared mapping gets its own page */
+    for (i = 0; i < size; i += (size_t)page) {
+        p[i] = p[i];
+    }
+    p[size - 1] = p[size - 1];
+}
+
+int realtime_set_fifo(int priority)
+{
+    struct sched_param param = {.sched_priority = priority};
+    int err;
+
+    if (priority < sched_get_priority_min(SCHED_FIFO) || priority > sched_get_priority_max(SCHED_FIFO)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+
+    return 0;
+}
+
+void realtime_leave(void)
+{
+    struct sched_param param;
+    int policy;
+
+    if (pthread_getschedparam(pthread_self(), &policy, &param) != 0 || policy != SCHED_FIFO) {
+        return;
+    }
+
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Check if RLIMIT_MEMLOCK leaves room for the mappings created later
+ * @description root is not limited
+ */
+static bool memlock_unlimited(void)
+{
+    struct rlimit limit;
+
+    if (geteuid() == 0) {
+        return true;
+    }
+
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) != 0) {
+        return false;
+    }
+
+    return limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= REALTIME_MIN_MEMLOCK;
+}
+
+/**
+ * Grow the stack of the calling thread, the locked pages stay
+ */
+static void prefault_stack(void)
+{
+    volatile uint8_t stack[PREFAULT_STACK_SIZE];
+    long page = sysconf(_SC_PAGESIZE);
+    size_t i;
+
+    for (i = 0; i < sizeof(stack); i += (size_t)page) {
+        stack[i] = 0;
+    }
+}
@@ -0,0 +1,82 @@
+/**
+ * @file realtime.h
+ *
+ * Low jitter mode of the render thread
+ *
+ * The memory of the process is locked and faulted in, the render thread
+ * runs on SCHED_FIFO. Threads inherit the policy of the thread creating
+ * them: set up the main thread before lv_init() so that the LVGL draw
+ * threads are real-time too, the threads doing I/O call realtime_leave().
+ */
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stddef.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Priority of the render thread, above the threaded IRQ handlers (50) */
+#define REALTIME_DEFAULT_PRIORITY   60
+
+/* Smallest RLIMIT_MEMLOCK to also lock the mappings created later */
+#define REALTIME_MIN_MEMLOCK        (128 * 1024 * 1024)
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Lock the memory of the process
+ * @description the current pages are faulted in and locked, the mappings
+ * created later are locked too unless RLIMIT_MEMLOCK is below
+ * REALTIME_MIN_MEMLOCK: they would fail once the limit is reached. The
+ * heap is never returned to the kernel and the stack of the calling thread
+ * is faulted in.
+ * @return 0 on success, 1 if only the current pages are locked, -1 with
+ * errno set on error, usually RLIMIT_MEMLOCK
+ */
+int realtime_lock_memory(void);
+
+/**
+ * Fault in a buffer allocated after realtime_lock_memory()
+ * @description every page is touched, the content is kept
+ * @param addr the start of the buffer
+ * @param size the size of the buffer in bytes
+ */
+void realtime_prefault(void *addr, size_t size);
+
+/**
+ * Run the calling thread on SCHED_FIFO
+ * @param priority the priority, 1 to 99
+ * @return 0 on success, -1 with errno set on error, usually RLIMIT_RTPRIO
+ */
+int realtime_set_fifo(int priority);
+
+/**
+ * Put the calling thread back on SCHED_OTHER if it inherited SCHED_FIFO
+ */
+void realtime_leave(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*REALTIME_H*/
@@ -36,6 +36,10 @@ typedef struct {
     uint32_t window_height;
     bool maximize;
     bool fullscreen;
+    lv_display_rotation_t rotation;
+    uint32_t draw_threads;              /* cores the rendering runs on, 0 for all the performance cores */
+    bool realtime;                      /* SCHED_FIFO render thread and locked memory */
+    int rt_priority;
 } simulator_settings_t;
 
 /**********************
@@ -17,6 +17,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <time.h>
+
+#include "simulator_util.h"
 
 /*********************
  *      DEFINES
@@ -61,6 +68,56 @@ void die(const char *msg, ...)
 
 }
 
+int find_open_fds(const char *prefix, int *fds, int max)
+{
+    char path[PATH_MAX];
+    char target[PATH_MAX];
+    struct dirent *entry;
+    size_t prefix_len = strlen(prefix);
+    ssize_t len;
+    DIR *dir;
+    int count = 0;
+    int fd;
+
+    dir = opendir("/proc/self/fd");
+    if (dir == NULL) {
+        return 0;
+    }
+
+    while (count < max && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+            continue;
+        }
+
+        fd = atoi(entry->d_name);
+        if (fd == dirfd(dir)) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/proc/self/fd/%s", entry->d_name);
+        len = readlink(path, target, sizeof(target) - 1);
+        if (len < 0) {
+            continue;
+        }
+        target[len] = '\0';
+
+        if (strncmp(target, prefix, prefix_len) == 0) {
+            fds[count++] = fd;
+        }
+    }
+
+    closedir(dir);
+    return count;
+}
+
+uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
 /**********************
  *   STATIC FUNCTIONS
  **********************/
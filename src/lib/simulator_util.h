@@ -20,6 +20,7 @@ extern "C" {
  *      INCLUDES
  *********************/
 #include <stdarg.h>
+#include <stdint.h>
 
 
 /**********************
@@ -42,6 +43,21 @@ const char *getenv_default(const char *name, const char *default_val);
  */
 void die(const char *msg, ...);
 
+/**
+ * @description Find the fds opened by a driver that does not expose them
+ * @param prefix The beginning of the file the fd refers to, i.e "/dev/input/event"
+ * @param fds The fds found
+ * @param max The size of fds
+ * @return the number of fds found
+ */
+int find_open_fds(const char *prefix, int *fds, int max);
+
+/**
+ * @description Read the monotonic clock
+ * @return the time in microseconds
+ */
+uint64_t now_us(void);
+
 /*********************
  *      DEFINES
  *********************/
@@ -22,13 +22,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <signal.h>
 #include "lvgl/lvgl.h"
 #include "lvgl/demos/lv_demos.h"
 
 #include "src/lib/driver_backends.h"
 #include "src/lib/simulator_util.h"
 #include "src/lib/simulator_settings.h"
+#include "src/lib/cpu_affinity.h"
+#include "src/lib/realtime.h"
+#include "src/lib/fontpack.h"
+#include "src/lib/mem_alloc.h"
 
 #include "src/top_demo.h"
 
@@ -36,11 +39,11 @@
 static void configure_simulator(int argc, char **argv);
 static void print_lvgl_version(void);
 static void print_usage(void);
+static lv_display_rotation_t parse_rotation(const char *degrees);
 
 /* contains the name of the selected backend if user
  * has specified one on the command line */
 static char *selected_backend;
-static volatile bool keep_running = true;
 /* Global simulator settings, defined in lv_linux_backend.c */
 extern simulator_settings_t settings;
 
@@ -57,19 +60,39 @@ static void print_lvgl_version(void)
             LVGL_VERSION_INFO);
 }
 
-static void int_handler(int dummy) {
-    (void)dummy;
-    keep_running = false;
-}
-
 /**
  * @brief Print usage information
  */
 static void print_usage(void)
 {
-    fprintf(stdout, "\nlvglsim [-V] [-B] [-b backend_name] [-W window_width] [-H window_height]\n\n");
+    fprintf(stdout, "\nlvglsim [-V] [-B] [-b backend_name] [-W window_width] [-H window_height] [-r rotation] [-j draw_threads] [-R]\n\n");
     fprintf(stdout, "-V print LVGL version\n");
     fprintf(stdout, "-B list supported backends\n");
+    fprintf(stdout, "-r rotate the display by 0, 90, 180 or 270 degrees\n");
+    fprintf(stdout, "-j number of draw threads running in parallel on the performance cores\n");
+    fprintf(stdout, "-R real-time mode, SCHED_FIFO render thread at LV_SIM_RT_PRIORITY and locked memory\n");
+}
+
+/**
+ * @brief Parse a display rotation
+ * @param degrees 0, 90, 180 or 270
+ * @return the LVGL rotation, exits on other values
+ */
+static lv_display_rotation_t parse_rotation(const char *degrees)
+{
+    switch (atoi(degrees)) {
+    case 0:
+        return LV_DISPLAY_ROTATION_0;
+    case 90:
+        return LV_DISPLAY_ROTATION_90;
+    case 180:
+        return LV_DISPLAY_ROTATION_180;
+    case 270:
+        return LV_DISPLAY_ROTATION_270;
+    default:
+        die("error invalid rotation: %s, expected 0, 90, 180 or 270\n", degrees);
+        return LV_DISPLAY_ROTATION_0;
+    }
 }
 
 /**
@@ -88,12 +111,19 @@ static void configure_simulator(int argc, char **argv)
 
     const char *env_w = getenv("LV_SIM_WINDOW_WIDTH");
     const char *env_h = getenv("LV_SIM_WINDOW_HEIGHT");
+    const char *env_r = getenv("LV_SIM_ROTATION");
+    const char *env_j = getenv("LV_SIM_DRAW_THREADS");
+    const char *env_p = getenv("LV_SIM_RT_PRIORITY");
     /* Default values */
     settings.window_width = atoi(env_w ? env_w : "800");
     settings.window_height = atoi(env_h ? env_h : "480");
+    settings.rotation = parse_rotation(env_r ? env_r : "0");
+    settings.draw_threads = atoi(env_j ? env_j : "0");
+    settings.realtime = false;
+    settings.rt_priority = env_p ? atoi(env_p) : REALTIME_DEFAULT_PRIORITY;
 
     /* Parse the command-line options. */
-    while ((opt = getopt (argc, argv, "b:fmW:H:BVh")) != -1) {
+    while ((opt = getopt (argc, argv, "b:fmW:H:r:j:RBVh")) != -1) {
         switch (opt) {
         case 'h':
             print_usage();
@@ -119,6 +149,15 @@ static void configure_simulator(int argc, char **argv)
         case 'H':
             settings.window_height = atoi(optarg);
             break;
+        case 'r':
+            settings.rotation = parse_rotation(optarg);
+            break;
+        case 'j':
+            settings.draw_threads = atoi(optarg);
+            break;
+        case 'R':
+            settings.realtime = true;
+            break;
         case ':':
             print_usage();
             die("Option -%c requires an argument.\n", optopt);
@@ -139,14 +178,57 @@ static void configure_simulator(int argc, char **argv)
 // ...existing code...
 int main(int argc, char **argv)
 {
-    /* 注册信号处理 */
-    signal(SIGINT, int_handler);
+    driver_backends_frame_stats_t frame_stats;
+    uint32_t pinned;
+    int rt_locked = -1;
+    bool rt_fifo = false;
+
+    /* 信号通过 signalfd 接收, 必须在创建任何线程之前屏蔽 */
+    if (driver_backends_init_run_loop() == -1) {
+        die("Failed to create the run loop\n");
+    }
 
     configure_simulator(argc, argv);
 
+    /* 绘制线程在 lv_init() 中创建, 继承主线程的亲和性, 渲染留在性能核上 */
+    pinned = cpu_affinity_pin(CPU_AFFINITY_PERFORMANCE, settings.draw_threads);
+
+    /* 实时模式: 锁定内存, 后端创建显示后再对绘制缓冲区预先缺页 */
+    if (settings.realtime) {
+        rt_locked = realtime_lock_memory();
+        rt_fifo = realtime_set_fifo(settings.rt_priority) == 0;
+    }
+
     /* Initialize LVGL. */
     lv_init();
 
+    /* 绘制缓冲区单独计数, 仪表盘显示各子系统的内存占用 */
+    mem_alloc_tag_draw_bufs();
+
+    if (settings.realtime) {
+        if (rt_locked < 0) {
+            LV_LOG_WARN("Failed to lock the memory, raise RLIMIT_MEMLOCK (ulimit -l)");
+        } else if (rt_locked > 0) {
+            LV_LOG_WARN("RLIMIT_MEMLOCK below %u MB, only the current memory is locked",
+                        (unsigned)(REALTIME_MIN_MEMLOCK / (1024 * 1024)));
+        }
+        if (!rt_fifo) {
+            LV_LOG_WARN("Failed to run on SCHED_FIFO %d, needs CAP_SYS_NICE or RLIMIT_RTPRIO",
+                        settings.rt_priority);
+        }
+        if (rt_locked == 0 && rt_fifo) {
+            LV_LOG_USER("Real-time mode, SCHED_FIFO %d with locked memory", settings.rt_priority);
+        }
+    }
+
+    /* 不常用的字体从字体包映射, 首次使用时才加载; 没有字体包时只有内置字体可用 */
+    fontpack_open(getenv("LV_SIM_FONT_PACK"));
+
+    if (pinned > 0) {
+        LV_LOG_USER("Rendering on %u of the %u performance cores, %u efficiency cores", pinned,
+                    cpu_affinity_count(CPU_AFFINITY_PERFORMANCE), cpu_affinity_count(CPU_AFFINITY_EFFICIENCY));
+    }
+
     /* Initialize the configured backend */
     if (driver_backends_init_backend(selected_backend) == -1) {
         die("Failed to initialize display backend");
@@ -165,19 +247,23 @@ int main(int argc, char **argv)
 
     top_demo_init();
     /* Enter the run loop */
-    // 替换原来的 driver_backends_run_loop();
     printf("LVGL running... Press Ctrl+C to exit.\n");
-    while(keep_running) {
-        /* 处理 LVGL 定时器任务 */
-        uint32_t time_till_next = lv_timer_handler();
-        
-        /* 睡眠一段时间以降低 CPU 占用 */
-        /* 如果 time_till_next 太大，限制最大睡眠时间，保证响应性 */
-        if(time_till_next > 50) time_till_next = 50;
-        usleep(time_till_next * 1000);
-    }
+
+    /* 没有事件时在 epoll_wait 中休眠, 直到下一个 LVGL 定时器到期或有输入 */
+    driver_backends_run_loop();
 
     printf("\nExiting...\n");
+
+    /* 帧按 vblank 节拍渲染时, 打印超出预算的帧数 */
+    driver_backends_get_frame_stats(&frame_stats);
+    if (frame_stats.frames > 0) {
+        printf("Frames: %u, missed deadline: %u (budget %u us, refresh period %u us)\n",
+               frame_stats.frames, frame_stats.missed, frame_stats.budget_us, frame_stats.period_us);
+    }
+
+    top_demo_deinit();
+    driver_backends_deinit_run_loop();
     lv_deinit(); // 可选：清理 LVGL 资源
+    fontpack_close();
     return 0;
 }
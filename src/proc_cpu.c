@@ -0,0 +1,168 @@
+/**
+ * @file proc_cpu.c
+ *
+ * Per-process CPU usage engine
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "proc_cpu.h"
+#include "procfs.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define PROC_CPU_MIN_CAPACITY   512
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static int table_reserve(proc_cpu_table_t *table, uint32_t count);
+static uint32_t key_hash(pid_t pid, uint64_t starttime);
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int proc_cpu_init(proc_cpu_t *cpu)
+{
+    memset(cpu, 0, sizeof(*cpu));
+
+    cpu->clk_tck = sysconf(_SC_CLK_TCK);
+    if (cpu->clk_tck <= 0) {
+        cpu->clk_tck = 100;
+    }
+
+    if (table_reserve(&cpu->tables[0], 0) != 0 ||
+        table_reserve(&cpu->tables[1], 0) != 0) {
+        proc_cpu_deinit(cpu);
+        return -1;
+    }
+
+    return 0;
+}
+
+void proc_cpu_update(proc_cpu_t *cpu, proc_row_t *rows, uint32_t count, bool has_io)
+{
+    proc_cpu_table_t *prev = &cpu->tables[cpu->prev];
+    proc_cpu_table_t *next = &cpu->tables[cpu->prev ^ 1];
+    proc_cpu_entry_t *e;
+    uint64_t now_ns = procfs_now_ns();
+    uint64_t elapsed_ns;
+    uint64_t elapsed_ms;
+    uint64_t elapsed_ticks;
+    uint64_t delta;
+    uint32_t i;
+    uint32_t h;
+
+    /* Elapsed wall time in clock ticks, multiplied by 10^9 to stay in integers */
+    elapsed_ns = cpu->last_ns ? now_ns - cpu->last_ns : 0;
+    elapsed_ticks = elapsed_ns * (uint64_t)cpu->clk_tck;
+    elapsed_ms = elapsed_ns / 1000000ULL;
+    cpu->last_ns = now_ns;
+
+    if (table_reserve(next, count) != 0) {
+        /* Keep the previous samples, try again on the next tick */
+        for (i = 0; i < count; i++) {
+            rows[i].cpu_x10 = 0;
+        }
+        return;
+    }
+
+    memset(next->entries, 0, (next->mask + 1) * sizeof(proc_cpu_entry_t));
+
+    for (i = 0; i < count; i++) {
+        proc_row_t *row = &rows[i];
+        uint32_t hash = key_hash(row->pid, row->starttime);
+
+        /* Look up the previous sample */
+        row->cpu_x10 = 0;
+        row->io_rate = 0;
+        for (h = hash & prev->mask; (e = &prev->entries[h])->pid != 0; h = (h + 1) & prev->mask) {
+            if (e->pid == row->pid && e->starttime == row->starttime) {
+                if (elapsed_ticks != 0 && row->cpu_ticks >= e->cpu_ticks) {
+                    delta = row->cpu_ticks - e->cpu_ticks;
+                    row->cpu_x10 = (uint32_t)(delta * 1000000000ULL * 1000 / elapsed_ticks);
+                }
+                /* No delta against the counters of a tick that did not read them */
+                if (has_io && e->has_io && elapsed_ms != 0 && row->io_bytes >= e->io_bytes) {
+                    delta = row->io_bytes - e->io_bytes;
+                    row->io_rate = delta * 1000ULL / elapsed_ms;
+                }
+                break;
+            }
+        }
+
+        /* Record the current sample for the next tick */
+        h = hash & next->mask;
+        while (next->entries[h].pid != 0) {
+            h = (h + 1) & next->mask;
+        }
+
+        e = &next->entries[h];
+        e->pid = row->pid;
+        e->starttime = row->starttime;
+        e->cpu_ticks = row->cpu_ticks;
+        e->io_bytes = row->io_bytes;
+        e->has_io = has_io;
+    }
+
+    cpu->prev ^= 1;
+}
+
+void proc_cpu_deinit(proc_cpu_t *cpu)
+{
+    free(cpu->tables[0].entries);
+    free(cpu->tables[1].entries);
+    memset(cpu, 0, sizeof(*cpu));
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Make sure the table can hold count entries at a load factor of at most 1/2
+ */
+static int table_reserve(proc_cpu_table_t *table, uint32_t count)
+{
+    uint32_t capacity = table->entries ? table->mask + 1 : PROC_CPU_MIN_CAPACITY;
+    proc_cpu_entry_t *entries;
+
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+
+    if (table->entries != NULL && capacity == table->mask + 1) {
+        return 0;
+    }
+
+    entries = calloc(capacity, sizeof(proc_cpu_entry_t));
+    if (entries == NULL) {
+        return -1;
+    }
+
+    free(table->entries);
+    table->entries = entries;
+    table->mask = capacity - 1;
+
+    return 0;
+}
+
+/**
+ * Mix the pid and the start time, pids are mostly sequential so
+ * a multiplicative hash spreads them over the table
+ */
+static uint32_t key_hash(pid_t pid, uint64_t starttime)
+{
+    uint64_t k = ((uint64_t)(uint32_t)pid << 32) ^ starttime;
+
+    k *= 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(k >> 32);
+}
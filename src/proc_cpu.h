@@ -0,0 +1,97 @@
+/**
+ * @file proc_cpu.h
+ *
+ * Per-process CPU usage engine
+ *
+ * Keeps the utime + stime and the I/O byte counters of every process seen
+ * during the previous tick in an open addressing hash table keyed by
+ * (pid, starttime), a recycled pid has a different start time and is
+ * therefore seen as a new process.
+ *
+ * Two tables are used alternately, the current tick is looked up in the
+ * previous table and inserted into the other one, processes that exited
+ * simply do not make it to the next table.
+ */
+
+#ifndef PROC_CPU_H
+#define PROC_CPU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "proc_scan.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    uint64_t starttime;
+    uint64_t cpu_ticks;
+    uint64_t io_bytes;
+    pid_t pid;                          /* 0 marks an empty slot */
+    bool has_io;                        /* io_bytes was read during that tick */
+} proc_cpu_entry_t;
+
+typedef struct {
+    proc_cpu_entry_t *entries;
+    uint32_t mask;                      /* capacity - 1, capacity is a power of two */
+} proc_cpu_table_t;
+
+typedef struct {
+    proc_cpu_table_t tables[2];
+    uint32_t prev;                      /* index of the table of the previous tick */
+    uint64_t last_ns;                   /* monotonic time of the previous tick */
+    long clk_tck;
+} proc_cpu_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Initialize the CPU usage engine
+ * @param cpu the engine
+ * @return 0 on success, -1 on allocation failure
+ */
+int proc_cpu_init(proc_cpu_t *cpu);
+
+/**
+ * Compute the CPU usage of every row in a single pass
+ * @description sets cpu_x10 of each row to the share of one CPU used since
+ * the previous call, like top(1) a multi-threaded process can go above 100%.
+ * io_rate is computed the same way from io_bytes.
+ * Rows seen for the first time report 0, and so does io_rate until
+ * io_bytes was read during two ticks in a row.
+ * @param cpu the engine
+ * @param rows the rows of the last scan
+ * @param count the number of rows
+ * @param has_io io_bytes of the rows was read
+ */
+void proc_cpu_update(proc_cpu_t *cpu, proc_row_t *rows, uint32_t count, bool has_io);
+
+/**
+ * Release the tables of the engine
+ * @param cpu the engine
+ */
+void proc_cpu_deinit(proc_cpu_t *cpu);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*PROC_CPU_H*/
@@ -0,0 +1,372 @@
+/**
+ * @file proc_list.c
+ *
+ * Virtualized process list
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <string.h>
+
+#include "proc_list.h"
+#include "sampler.h"
+#include "lib/fontpack.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define PROC_LIST_ROW_HEIGHT    22
+#define PROC_LIST_MAX_POOL      64
+#define PROC_LIST_CELL_LEN      24
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef enum {
+    COL_PID,
+    COL_USER,
+    COL_STATE,
+    COL_CPU,
+    COL_RSS,
+    COL_IO,
+    COL_CMD,
+    COL_COUNT,
+} column_t;
+
+typedef struct {
+    lv_obj_t *obj;
+    lv_obj_t *cells[COL_COUNT];
+    char text[COL_COUNT][PROC_LIST_CELL_LEN]; /* what the cells currently show */
+    int32_t bound;                      /* index of the row shown, -1 if none */
+} pool_row_t;
+
+typedef struct {
+    lv_obj_t *header[COL_COUNT];
+    lv_obj_t *body;
+    lv_obj_t *spacer;
+    pool_row_t pool[PROC_LIST_MAX_POOL];
+    uint32_t pool_count;
+    proc_row_t *rows;                   /* copy of the rows, owned by the list */
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t height_rows;               /* rows the spacer is sized for */
+    uint32_t total;
+    bool has_io;
+    int32_t key;                        /* highlighted column, -1 before the first update */
+} proc_list_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void create_cells(lv_obj_t *parent, lv_obj_t **cells);
+static uint32_t visible_rows(proc_list_t *pl);
+static void grow_pool(proc_list_t *pl);
+static void rebind(proc_list_t *pl);
+static void set_cell(pool_row_t *prow, column_t col, const char *text);
+static void body_event_cb(lv_event_t *e);
+static void delete_cb(lv_event_t *e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static const int32_t col_x[COL_COUNT] = {0, 56, 136, 156, 216, 296, 376};
+static const int32_t col_w[COL_COUNT] = {52, 76, 16, 56, 76, 76, 160};
+static const char * const col_names[COL_COUNT] = {"PID", "USER", "S", "%CPU", "RSS(KB)", "IO(KB/s)", "COMMAND"};
+
+/* The cell font, falls back to the CJK font of the pack for the command names */
+static lv_font_t cell_font;
+
+/* Column highlighted for each sort key */
+static const column_t sort_columns[] = {COL_CPU, COL_RSS, COL_IO};
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+lv_obj_t *proc_list_create(lv_obj_t *parent)
+{
+    lv_obj_t *list;
+    lv_obj_t *header;
+    proc_list_t *pl;
+    column_t col;
+
+    pl = lv_malloc_zeroed(sizeof(*pl));
+    LV_ASSERT_MALLOC(pl);
+    if (pl == NULL) {
+        return NULL;
+    }
+    pl->key = -1;
+
+    cell_font = lv_font_montserrat_14;
+    cell_font.fallback = fontpack_get("source_han_sans_sc_16_cjk");
+
+    list = lv_obj_create(parent);
+    lv_obj_set_flex_flow(list, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_style_pad_all(list, 4, 0);
+    lv_obj_set_style_pad_gap(list, 2, 0);
+    lv_obj_set_style_bg_color(list, lv_palette_lighten(LV_PALETTE_GREY, 4), 0);
+    lv_obj_remove_flag(list, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_user_data(list, pl);
+    lv_obj_add_event_cb(list, delete_cb, LV_EVENT_DELETE, NULL);
+
+    /* The header does not scroll with the rows */
+    header = lv_obj_create(list);
+    lv_obj_remove_style_all(header);
+    lv_obj_set_size(header, LV_PCT(100), PROC_LIST_ROW_HEIGHT);
+    lv_obj_add_flag(header, LV_OBJ_FLAG_EVENT_BUBBLE);
+    create_cells(header, pl->header);
+    for (col = 0; col < COL_COUNT; col++) {
+        lv_label_set_text(pl->header[col], col_names[col]);
+    }
+
+    pl->body = lv_obj_create(list);
+    lv_obj_remove_style_all(pl->body);
+    lv_obj_set_width(pl->body, LV_PCT(100));
+    lv_obj_set_flex_grow(pl->body, 1);
+    lv_obj_set_scroll_dir(pl->body, LV_DIR_VER);
+    lv_obj_add_flag(pl->body, LV_OBJ_FLAG_EVENT_BUBBLE);
+    lv_obj_add_event_cb(pl->body, body_event_cb, LV_EVENT_SCROLL, pl);
+    lv_obj_add_event_cb(pl->body, body_event_cb, LV_EVENT_SIZE_CHANGED, pl);
+
+    /* Gives the body the height of all the rows, the pool rows are laid over it */
+    pl->spacer = lv_obj_create(pl->body);
+    lv_obj_remove_style_all(pl->spacer);
+    lv_obj_remove_flag(pl->spacer, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_size(pl->spacer, 1, 0);
+
+    return list;
+}
+
+void proc_list_set_rows(lv_obj_t *list, const proc_row_t *rows, uint32_t count, uint32_t total,
+                        proc_sort_key_t key, bool has_io)
+{
+    proc_list_t *pl = lv_obj_get_user_data(list);
+    proc_row_t *copy;
+    uint32_t height_rows;
+    column_t col;
+    bool shrunk;
+
+    if (pl == NULL) {
+        return;
+    }
+
+    if (pl->key != (int32_t)key) {
+        for (col = 0; col < COL_COUNT; col++) {
+            lv_obj_set_style_text_color(pl->header[col], col == sort_columns[key] ?
+                                        lv_palette_main(LV_PALETTE_BLUE) : lv_color_black(), 0);
+        }
+        pl->key = (int32_t)key;
+    }
+
+    if (pl->total != total) {
+        lv_label_set_text_fmt(pl->header[COL_CMD], "COMMAND (%u tasks)", (unsigned)total);
+        pl->total = total;
+    }
+
+    /* The scroll events rebind later, the snapshot is released by then */
+    if (count > pl->capacity) {
+        copy = lv_realloc(pl->rows, count * sizeof(proc_row_t));
+        LV_ASSERT_MALLOC(copy);
+        if (copy == NULL) {
+            count = pl->capacity;
+        } else {
+            pl->rows = copy;
+            pl->capacity = count;
+        }
+    }
+    if (count > 0) {
+        memcpy(pl->rows, rows, count * sizeof(proc_row_t));
+    }
+
+    /* The whole list can be scrolled, the sampler carries at most SAMPLER_MAX_PROCS rows */
+    height_rows = total < SAMPLER_MAX_PROCS ? total : SAMPLER_MAX_PROCS;
+    if (height_rows < count) {
+        height_rows = count;
+    }
+
+    shrunk = height_rows < pl->height_rows;
+    if (height_rows != pl->height_rows) {
+        lv_obj_set_height(pl->spacer, (int32_t)height_rows * PROC_LIST_ROW_HEIGHT);
+        pl->height_rows = height_rows;
+    }
+
+    pl->count = count;
+    pl->has_io = has_io;
+
+    /* Keep the viewport inside the shorter list */
+    if (shrunk) {
+        lv_obj_update_layout(pl->body);
+        lv_obj_readjust_scroll(pl->body, LV_ANIM_OFF);
+    }
+
+    rebind(pl);
+}
+
+uint32_t proc_list_get_rows_shown(lv_obj_t *list)
+{
+    proc_list_t *pl = lv_obj_get_user_data(list);
+    int32_t scroll_y;
+    uint32_t visible;
+
+    if (pl == NULL) {
+        return 0;
+    }
+
+    visible = visible_rows(pl);
+    if (visible == 0) {
+        return 0;
+    }
+
+    scroll_y = lv_obj_get_scroll_y(pl->body);
+    return (scroll_y > 0 ? (uint32_t)scroll_y / PROC_LIST_ROW_HEIGHT : 0) + visible;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void create_cells(lv_obj_t *parent, lv_obj_t **cells)
+{
+    column_t col;
+
+    for (col = 0; col < COL_COUNT; col++) {
+        cells[col] = lv_label_create(parent);
+        lv_label_set_long_mode(cells[col], LV_LABEL_LONG_CLIP);
+        lv_label_set_text_static(cells[col], "");
+        lv_obj_set_pos(cells[col], col_x[col], 0);
+        lv_obj_set_width(cells[col], col_w[col]);
+        lv_obj_set_style_text_font(cells[col], &cell_font, 0);
+    }
+}
+
+/**
+ * Rows covering the viewport, plus the partially visible ones
+ */
+static uint32_t visible_rows(proc_list_t *pl)
+{
+    int32_t height = lv_obj_get_height(pl->body);
+
+    return height > 0 ? (uint32_t)height / PROC_LIST_ROW_HEIGHT + 2 : 0;
+}
+
+/**
+ * Create enough rows to cover the viewport
+ */
+static void grow_pool(proc_list_t *pl)
+{
+    uint32_t needed = visible_rows(pl);
+    pool_row_t *prow;
+
+    if (needed > PROC_LIST_MAX_POOL) {
+        needed = PROC_LIST_MAX_POOL;
+    }
+
+    while (pl->pool_count < needed) {
+        prow = &pl->pool[pl->pool_count++];
+
+        prow->obj = lv_obj_create(pl->body);
+        lv_obj_remove_style_all(prow->obj);
+        lv_obj_remove_flag(prow->obj, LV_OBJ_FLAG_CLICKABLE);
+        lv_obj_set_size(prow->obj, LV_PCT(100), PROC_LIST_ROW_HEIGHT);
+        lv_obj_add_flag(prow->obj, LV_OBJ_FLAG_HIDDEN);
+        create_cells(prow->obj, prow->cells);
+        memset(prow->text, 0, sizeof(prow->text));
+        prow->bound = -1;
+    }
+}
+
+/**
+ * Bind the pool rows to the rows under the viewport
+ */
+static void rebind(proc_list_t *pl)
+{
+    int32_t scroll_y = lv_obj_get_scroll_y(pl->body);
+    uint32_t first = scroll_y > 0 ? (uint32_t)scroll_y / PROC_LIST_ROW_HEIGHT : 0;
+    char text[PROC_LIST_CELL_LEN];
+    const proc_row_t *row;
+    pool_row_t *prow;
+    uint32_t idx;
+    uint32_t i;
+
+    for (i = 0; i < pl->pool_count; i++) {
+        prow = &pl->pool[i];
+        idx = first + i;
+
+        if (idx >= pl->count) {
+            if (prow->bound >= 0) {
+                lv_obj_add_flag(prow->obj, LV_OBJ_FLAG_HIDDEN);
+                prow->bound = -1;
+            }
+            continue;
+        }
+
+        if (prow->bound < 0) {
+            lv_obj_remove_flag(prow->obj, LV_OBJ_FLAG_HIDDEN);
+        }
+
+        if (prow->bound != (int32_t)idx) {
+            lv_obj_set_y(prow->obj, (int32_t)idx * PROC_LIST_ROW_HEIGHT);
+            prow->bound = (int32_t)idx;
+        }
+
+        row = &pl->rows[idx];
+
+        snprintf(text, sizeof(text), "%d", (int)row->pid);
+        set_cell(prow, COL_PID, text);
+        set_cell(prow, COL_USER, row->user);
+        snprintf(text, sizeof(text), "%c", row->state);
+        set_cell(prow, COL_STATE, text);
+        snprintf(text, sizeof(text), "%u.%u", (unsigned)(row->cpu_x10 / 10), (unsigned)(row->cpu_x10 % 10));
+        set_cell(prow, COL_CPU, text);
+        snprintf(text, sizeof(text), "%lu", row->rss_kb);
+        set_cell(prow, COL_RSS, text);
+        if (pl->has_io) {
+            snprintf(text, sizeof(text), "%llu", (unsigned long long)(row->io_rate / 1024));
+            set_cell(prow, COL_IO, text);
+        } else {
+            set_cell(prow, COL_IO, "-");
+        }
+        set_cell(prow, COL_CMD, row->cmd);
+    }
+}
+
+/**
+ * Update a cell only if its text changed
+ */
+static void set_cell(pool_row_t *prow, column_t col, const char *text)
+{
+    if (strncmp(prow->text[col], text, PROC_LIST_CELL_LEN - 1) == 0) {
+        return;
+    }
+
+    /* The cache is the label text, nothing is copied or allocated */
+    snprintf(prow->text[col], PROC_LIST_CELL_LEN, "%s", text);
+    lv_label_set_text_static(prow->cells[col], prow->text[col]);
+}
+
+static void body_event_cb(lv_event_t *e)
+{
+    proc_list_t *pl = lv_event_get_user_data(e);
+
+    if (lv_event_get_code(e) == LV_EVENT_SIZE_CHANGED) {
+        grow_pool(pl);
+    }
+
+    rebind(pl);
+}
+
+static void delete_cb(lv_event_t *e)
+{
+    lv_obj_t *list = lv_event_get_target(e);
+    proc_list_t *pl = lv_obj_get_user_data(list);
+
+    if (pl != NULL) {
+        lv_free(pl->rows);
+    }
+    lv_free(pl);
+    lv_obj_set_user_data(list, NULL);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file proc_list.h
+ *
+ * Virtualized process list
+ *
+ * Only the rows that fit in the viewport exist as objects. A fixed pool of
+ * row objects is bound to the snapshot rows under the viewport and rebound
+ * while scrolling, a spacer gives the list the height of all the rows.
+ * Every cell remembers its text, set-text is only called for the cells
+ * whose value changed, so an update only redraws what changed. The rows
+ * are copied, the snapshot they come from can be released at once.
+ *
+ * The spacer is sized from the number of processes on the system, the
+ * rows only have to cover the list down to the viewport: scrolling further
+ * shows the rows of the next update, see proc_list_get_rows_shown().
+ */
+
+#ifndef PROC_LIST_H
+#define PROC_LIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lvgl/lvgl.h"
+#include "proc_scan.h"
+#include "proc_topk.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Create a process list
+ * @param parent the parent object
+ * @return the list, clicks anywhere on it are reported on this object
+ */
+lv_obj_t *proc_list_create(lv_obj_t *parent);
+
+/**
+ * Bind the list to new rows
+ * @param list the list
+ * @param rows the rows, copied into the list
+ * @param count the number of rows, the first ones of the whole list
+ * @param total the number of processes on the system, the height of the list
+ * @param key the sort key, highlighted in the header
+ * @param has_io the io_rate of the rows is valid
+ */
+void proc_list_set_rows(lv_obj_t *list, const proc_row_t *rows, uint32_t count, uint32_t total,
+                        proc_sort_key_t key, bool has_io);
+
+/**
+ * Get the number of rows from the top of the list to the bottom of the viewport
+ * @description the rows the next update has to carry, the partially
+ * visible ones included
+ * @param list the list
+ * @return the number of rows, 0 before the list is laid out
+ */
+uint32_t proc_list_get_rows_shown(lv_obj_t *list);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*PROC_LIST_H*/
@@ -0,0 +1,314 @@
+/**
+ * @file proc_scan.c
+ *
+ * Native process scanner
+ *
+ * Each pid directory is opened relative to the /proc handle with openat(2),
+ * which saves building absolute paths and walking them again in the kernel.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <pwd.h>
+#include <sys/stat.h>
+
+#include "proc_scan.h"
+#include "procfs.h"
+#include "procfs_parse.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define PROC_SCAN_INITIAL_ROWS  256
+#define PROC_SCAN_BUF_SIZE      4096
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static ssize_t read_pid_file(proc_scan_t *scan, const char *pid_name, const char *file);
+static int parse_stat(proc_scan_t *scan, const char *pid_name, proc_row_t *row);
+static void parse_io(proc_scan_t *scan, const char *pid_name, proc_row_t *row);
+static const char *lookup_user(proc_scan_t *scan, uid_t uid);
+static int grow_rows(proc_scan_t *scan);
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int proc_scan_init(proc_scan_t *scan)
+{
+    char path[PATH_MAX];
+
+    memset(scan, 0, sizeof(*scan));
+
+    scan->dir = opendir(procfs_path("/proc", path, sizeof(path)));
+    if (scan->dir == NULL) {
+        return -1;
+    }
+
+    scan->page_kb = (unsigned long)sysconf(_SC_PAGESIZE) / 1024;
+    scan->buf_size = PROC_SCAN_BUF_SIZE;
+    scan->buf = malloc(scan->buf_size);
+    if (scan->buf == NULL || grow_rows(scan) != 0) {
+        proc_scan_deinit(scan);
+        return -1;
+    }
+
+    return 0;
+}
+
+int proc_scan_update(proc_scan_t *scan)
+{
+    struct dirent *de;
+    proc_row_t *row;
+
+    if (scan->dir == NULL) {
+        return -1;
+    }
+
+    rewinddir(scan->dir);
+    scan->count = 0;
+
+    while ((de = readdir(scan->dir)) != NULL) {
+
+        /* Only the numeric entries are processes */
+        if (de->d_name[0] < '1' || de->d_name[0] > '9') {
+            continue;
+        }
+
+        if (scan->count == scan->capacity && grow_rows(scan) != 0) {
+            break;
+        }
+
+        row = &scan->rows[scan->count];
+
+        /* The process may have exited in the meantime */
+        if (parse_stat(scan, de->d_name, row) != 0) {
+            continue;
+        }
+
+        if (scan->want_io) {
+            parse_io(scan, de->d_name, row);
+        }
+
+        scan->count++;
+    }
+
+    return (int)scan->count;
+}
+
+void proc_scan_resolve(proc_scan_t *scan, proc_row_t *row)
+{
+    char pid_name[16];
+    struct stat st;
+
+    snprintf(pid_name, sizeof(pid_name), "%d", (int)row->pid);
+
+    if (fstatat(dirfd(scan->dir), pid_name, &st, 0) == 0) {
+        row->uid = st.st_uid;
+    }
+
+    snprintf(row->user, sizeof(row->user), "%s", lookup_user(scan, row->uid));
+}
+
+void proc_scan_deinit(proc_scan_t *scan)
+{
+    if (scan->dir != NULL) {
+        closedir(scan->dir);
+    }
+
+    free(scan->rows);
+    free(scan->buf);
+    memset(scan, 0, sizeof(*scan));
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Read /proc/[pid]/[file] into the scan buffer
+ *
+ * @return the number of bytes read, the buffer is NUL terminated, -1 on error
+ */
+static ssize_t read_pid_file(proc_scan_t *scan, const char *pid_name, const char *file)
+{
+    char path[32];
+    ssize_t len;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s", pid_name, file);
+
+    fd = openat(dirfd(scan->dir), path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    do {
+        len = read(fd, scan->buf, scan->buf_size - 1);
+    } while (len < 0 && errno == EINTR);
+
+    close(fd);
+
+    if (len < 0) {
+        return -1;
+    }
+
+    scan->buf[len] = '\0';
+    return len;
+}
+
+/**
+ * Parse /proc/[pid]/stat - pid (comm) state ...
+ *
+ * @note comm can contain spaces and parenthesis, the last ')' ends it
+ */
+static int parse_stat(proc_scan_t *scan, const char *pid_name, proc_row_t *row)
+{
+    procfs_view_t text;
+    procfs_view_t field;
+    const char *open;
+    const char *close;
+    ssize_t buf_len;
+    size_t len;
+    uint64_t utime;
+    uint64_t stime;
+
+    buf_len = read_pid_file(scan, pid_name, "stat");
+    if (buf_len <= 0) {
+        return -1;
+    }
+
+    open = memchr(scan->buf, '(', (size_t)buf_len);
+    close = strrchr(scan->buf, ')');
+    if (open == NULL || close == NULL || close < open || close[1] != ' ') {
+        return -1;
+    }
+
+    len = (size_t)(close - open - 1);
+    if (len >= PROC_SCAN_CMD_LEN) {
+        len = PROC_SCAN_CMD_LEN - 1;
+    }
+
+    memcpy(row->cmd, open + 1, len);
+    row->cmd[len] = '\0';
+
+    text = procfs_view(scan->buf, (size_t)(open - scan->buf));
+    row->pid = (pid_t)procfs_parse_u64(&text);
+    row->uid = 0;
+    row->cpu_x10 = 0;
+    row->io_bytes = 0;
+    row->io_rate = 0;
+    row->user[0] = '\0';
+
+    /* The fields are counted from 1, the state is field 3 */
+    text = procfs_view(close + 1, (size_t)(scan->buf + buf_len - close - 1));
+    if (!procfs_next_field(&text, &field)) {
+        return -1;
+    }
+    row->state = field.ptr[0];
+
+    /* utime and stime are fields 14 and 15 */
+    if (!procfs_skip_fields(&text, 10)) {
+        return -1;
+    }
+    utime = procfs_parse_u64(&text);
+    stime = procfs_parse_u64(&text);
+    row->cpu_ticks = utime + stime;
+
+    /* starttime is field 22 */
+    if (!procfs_skip_fields(&text, 6)) {
+        return -1;
+    }
+    row->starttime = procfs_parse_u64(&text);
+
+    /* vsize is field 23, rss (in pages) field 24 */
+    if (!procfs_skip_fields(&text, 1)) {
+        return -1;
+    }
+    row->rss_kb = (unsigned long)procfs_parse_u64(&text) * scan->page_kb;
+
+    return 0;
+}
+
+/**
+ * Parse the read_bytes: and write_bytes: lines of /proc/[pid]/io
+ *
+ * @note the file is only readable for processes we are allowed to ptrace
+ */
+static void parse_io(proc_scan_t *scan, const char *pid_name, proc_row_t *row)
+{
+    procfs_view_t text;
+    procfs_view_t line;
+    procfs_view_t key;
+    ssize_t len;
+
+    len = read_pid_file(scan, pid_name, "io");
+    if (len <= 0) {
+        return;
+    }
+
+    text = procfs_view(scan->buf, (size_t)len);
+    while (procfs_next_line(&text, &line)) {
+        if (!procfs_next_field(&line, &key)) {
+            continue;
+        }
+
+        if (PROCFS_VIEW_EQ(key, "read_bytes:") || PROCFS_VIEW_EQ(key, "write_bytes:")) {
+            row->io_bytes += procfs_parse_u64(&line);
+        }
+    }
+}
+
+/**
+ * Resolve a uid to a user name through a small direct mapped cache,
+ * getpwuid_r() may read /etc/passwd, it is only called on a miss
+ */
+static const char *lookup_user(proc_scan_t *scan, uid_t uid)
+{
+    proc_uid_cache_t *entry = &scan->uid_cache[uid & (PROC_SCAN_UID_CACHE - 1)];
+    struct passwd pw;
+    struct passwd *res = NULL;
+    char pw_buf[512];
+
+    if (entry->valid && entry->uid == uid) {
+        return entry->name;
+    }
+
+    if (getpwuid_r(uid, &pw, pw_buf, sizeof(pw_buf), &res) == 0 && res != NULL) {
+        snprintf(entry->name, sizeof(entry->name), "%s", res->pw_name);
+    } else {
+        snprintf(entry->name, sizeof(entry->name), "%u", (unsigned int)uid);
+    }
+
+    entry->uid = uid;
+    entry->valid = 1;
+
+    return entry->name;
+}
+
+/**
+ * Double the capacity of the row array
+ */
+static int grow_rows(proc_scan_t *scan)
+{
+    uint32_t capacity = scan->capacity ? scan->capacity * 2 : PROC_SCAN_INITIAL_ROWS;
+    proc_row_t *rows = realloc(scan->rows, capacity * sizeof(proc_row_t));
+
+    if (rows == NULL) {
+        return -1;
+    }
+
+    scan->rows = rows;
+    scan->capacity = capacity;
+    return 0;
+}
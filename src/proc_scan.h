@@ -0,0 +1,122 @@
+/**
+ * @file proc_scan.h
+ *
+ * Native process scanner - walks /proc/[pid] directly
+ * and returns structured rows, without forking ps(1)
+ *
+ * The scanner owns its buffers and reuses them between calls to
+ * proc_scan_update(), so a steady state scan does not allocate.
+ *
+ * A scan only reads /proc/[pid]/stat (and /proc/[pid]/io if requested),
+ * the owner of a process is resolved with proc_scan_resolve() once the
+ * rows to display have been selected.
+ */
+
+#ifndef PROC_SCAN_H
+#define PROC_SCAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <dirent.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Same as the kernel TASK_COMM_LEN, including the terminating NUL */
+#define PROC_SCAN_CMD_LEN   16
+#define PROC_SCAN_USER_LEN  12
+
+/* Number of entries of the uid -> user name cache, power of two */
+#define PROC_SCAN_UID_CACHE 32
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* One process as seen by the scanner */
+typedef struct {
+    pid_t pid;
+    uid_t uid;
+    char state;                         /* R, S, D, Z, ... */
+    unsigned long rss_kb;               /* resident set size, 0 for kernel threads */
+    uint64_t cpu_ticks;                 /* utime + stime, in clock ticks */
+    uint64_t starttime;                 /* start time after boot, in clock ticks */
+    uint32_t cpu_x10;                   /* CPU usage in tenths of a percent, see proc_cpu.h */
+    uint64_t io_bytes;                  /* read_bytes + write_bytes, only with want_io */
+    uint64_t io_rate;                   /* bytes per second, see proc_cpu.h */
+    char user[PROC_SCAN_USER_LEN];
+    char cmd[PROC_SCAN_CMD_LEN];
+} proc_row_t;
+
+typedef struct {
+    uid_t uid;
+    int valid;
+    char name[PROC_SCAN_USER_LEN];
+} proc_uid_cache_t;
+
+/* Scanner state, reused between ticks */
+typedef struct {
+    DIR *dir;                           /* handle on /proc, rewound each scan */
+    proc_row_t *rows;
+    uint32_t count;                     /* rows filled by the last scan */
+    uint32_t capacity;
+    char *buf;                          /* read buffer for the per pid files */
+    size_t buf_size;
+    unsigned long page_kb;
+    int want_io;                        /* also read /proc/[pid]/io */
+    proc_uid_cache_t uid_cache[PROC_SCAN_UID_CACHE];
+} proc_scan_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Initialize the scanner
+ * @param scan the scanner to initialize
+ * @return 0 on success, -1 if /proc could not be opened
+ */
+int proc_scan_init(proc_scan_t *scan);
+
+/**
+ * Walk /proc and refresh the rows of the scanner
+ * @description processes that exit while being scanned are skipped
+ * @param scan the scanner
+ * @return the number of rows, -1 on error
+ */
+int proc_scan_update(proc_scan_t *scan);
+
+/**
+ * Resolve the owner of a row
+ * @description the owner of the /proc/[pid] directory is the effective uid
+ * of the process, a single fstatat() is enough. Meant to be called only on
+ * the rows that are going to be displayed
+ * @param scan the scanner
+ * @param row a row returned by the last scan
+ */
+void proc_scan_resolve(proc_scan_t *scan, proc_row_t *row);
+
+/**
+ * Release the buffers held by the scanner
+ * @param scan the scanner
+ */
+void proc_scan_deinit(proc_scan_t *scan);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*PROC_SCAN_H*/
@@ -0,0 +1,139 @@
+/**
+ * @file proc_topk.c
+ *
+ * Top-K selection of the process rows
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "proc_topk.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static uint64_t row_key(const proc_row_t *row, proc_sort_key_t key);
+static int slot_less(const proc_row_t *rows, const uint32_t *heap, const uint64_t *keys,
+                     uint32_t a, uint32_t b);
+static void slot_swap(uint32_t *heap, uint64_t *keys, uint32_t a, uint32_t b);
+static void sift_up(const proc_row_t *rows, uint32_t *heap, uint64_t *keys, uint32_t pos);
+static void sift_down(const proc_row_t *rows, uint32_t *heap, uint64_t *keys,
+                      uint32_t size, uint32_t pos);
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+uint32_t proc_topk_select(const proc_row_t *rows, uint32_t count,
+                          proc_sort_key_t key, uint32_t k, uint32_t *out, uint64_t *keys)
+{
+    uint32_t size = 0;
+    uint32_t i;
+    uint64_t v;
+
+    if (k == 0) {
+        return 0;
+    }
+
+    /*
+     * out[] is used as a min-heap of row indices, keys[] mirrors the
+     * sort key of each heap slot so the common case - a row that is
+     * not better than the root - costs one load and one compare
+     */
+    for (i = 0; i < count; i++) {
+        v = row_key(&rows[i], key);
+
+        if (size < k) {
+            out[size] = i;
+            keys[size] = v;
+            sift_up(rows, out, keys, size);
+            size++;
+        } else if (v > keys[0] || (v == keys[0] && rows[i].pid < rows[out[0]].pid)) {
+            out[0] = i;
+            keys[0] = v;
+            sift_down(rows, out, keys, size, 0);
+        }
+    }
+
+    /* Heap sort the survivors, each root goes to the back: highest first */
+    for (i = size; i > 1; i--) {
+        slot_swap(out, keys, 0, i - 1);
+        sift_down(rows, out, keys, i - 1, 0);
+    }
+
+    return size;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint64_t row_key(const proc_row_t *row, proc_sort_key_t key)
+{
+    switch (key) {
+    case PROC_SORT_RSS:
+        return row->rss_kb;
+    case PROC_SORT_IO:
+        return row->io_rate;
+    case PROC_SORT_CPU:
+    default:
+        return row->cpu_x10;
+    }
+}
+
+/**
+ * Heap order, on equal keys the higher pid is considered smaller
+ * so that the ordering is stable from one tick to the next
+ */
+static int slot_less(const proc_row_t *rows, const uint32_t *heap, const uint64_t *keys,
+                     uint32_t a, uint32_t b)
+{
+    return keys[a] < keys[b] ||
+           (keys[a] == keys[b] && rows[heap[a]].pid > rows[heap[b]].pid);
+}
+
+static void slot_swap(uint32_t *heap, uint64_t *keys, uint32_t a, uint32_t b)
+{
+    uint32_t idx = heap[a];
+    uint64_t key = keys[a];
+
+    heap[a] = heap[b];
+    keys[a] = keys[b];
+    heap[b] = idx;
+    keys[b] = key;
+}
+
+static void sift_up(const proc_row_t *rows, uint32_t *heap, uint64_t *keys, uint32_t pos)
+{
+    uint32_t parent;
+
+    while (pos > 0) {
+        parent = (pos - 1) / 2;
+        if (!slot_less(rows, heap, keys, pos, parent)) {
+            break;
+        }
+        slot_swap(heap, keys, pos, parent);
+        pos = parent;
+    }
+}
+
+static void sift_down(const proc_row_t *rows, uint32_t *heap, uint64_t *keys,
+                      uint32_t size, uint32_t pos)
+{
+    uint32_t child;
+
+    while ((child = pos * 2 + 1) < size) {
+        if (child + 1 < size && slot_less(rows, heap, keys, child + 1, child)) {
+            child++;
+        }
+        if (!slot_less(rows, heap, keys, child, pos)) {
+            break;
+        }
+        slot_swap(heap, keys, pos, child);
+        pos = child;
+    }
+}
@@ -0,0 +1,64 @@
+/**
+ * @file proc_topk.h
+ *
+ * Top-K selection of the process rows
+ *
+ * Keeps the K best rows in a bounded min-heap, which costs O(n log K)
+ * instead of sorting every row of the scan on each tick.
+ */
+
+#ifndef PROC_TOPK_H
+#define PROC_TOPK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include "proc_scan.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef enum {
+    PROC_SORT_CPU,
+    PROC_SORT_RSS,
+    PROC_SORT_IO,
+    PROC_SORT_COUNT,
+} proc_sort_key_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Select the K rows with the highest sort key
+ * @param rows the rows of a scan
+ * @param count the number of rows
+ * @param key the sort key
+ * @param k the number of rows to select
+ * @param out receives the indices of the selected rows, highest first,
+ * must have room for k entries
+ * @param keys scratch space for the sort keys, must have room for k entries
+ * @return the number of selected rows, min(count, k)
+ */
+uint32_t proc_topk_select(const proc_row_t *rows, uint32_t count,
+                          proc_sort_key_t key, uint32_t k, uint32_t *out, uint64_t *keys);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*PROC_TOPK_H*/
@@ -0,0 +1,150 @@
+/**
+ * @file procfs.c
+ *
+ * Reader for the system wide procfs files
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <limits.h>
+
+#include "procfs.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define PROCFS_INITIAL_SIZE 4096
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static uint64_t monotonic_ns(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static const char *root_dir = "";
+static procfs_clock_t clock_cb = monotonic_ns;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void procfs_set_root(const char *root)
+{
+    root_dir = root != NULL ? root : "";
+}
+
+const char *procfs_path(const char *path, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s%s", root_dir, path);
+    return buf;
+}
+
+void procfs_set_clock(procfs_clock_t clock)
+{
+    clock_cb = clock != NULL ? clock : monotonic_ns;
+}
+
+uint64_t procfs_now_ns(void)
+{
+    return clock_cb();
+}
+
+int procfs_open(procfs_file_t *file, const char *path)
+{
+    char buf[PATH_MAX];
+
+    memset(file, 0, sizeof(*file));
+
+    file->fd = open(procfs_path(path, buf, sizeof(buf)), O_RDONLY | O_CLOEXEC);
+    if (file->fd < 0) {
+        return -1;
+    }
+
+    file->cap = PROCFS_INITIAL_SIZE;
+    file->buf = malloc(file->cap);
+    if (file->buf == NULL) {
+        close(file->fd);
+        file->fd = -1;
+        return -1;
+    }
+
+    file->buf[0] = '\0';
+    return 0;
+}
+
+ssize_t procfs_read(procfs_file_t *file)
+{
+    ssize_t n;
+    char *buf;
+
+    if (file->fd < 0) {
+        return -1;
+    }
+
+    file->len = 0;
+
+    while (true) {
+        n = pread(file->fd, file->buf + file->len, file->cap - file->len - 1, (off_t)file->len);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        if (n == 0) {
+            break;
+        }
+
+        file->len += (size_t)n;
+
+        /* Full buffer - grow it and continue, keeping one byte for the NUL */
+        if (file->len == file->cap - 1) {
+            buf = realloc(file->buf, file->cap * 2);
+            if (buf == NULL) {
+                break;
+            }
+            file->buf = buf;
+            file->cap *= 2;
+        }
+    }
+
+    file->buf[file->len] = '\0';
+    return (ssize_t)file->len;
+}
+
+void procfs_close(procfs_file_t *file)
+{
+    if (file->fd >= 0) {
+        close(file->fd);
+    }
+
+    free(file->buf);
+    memset(file, 0, sizeof(*file));
+    file->fd = -1;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
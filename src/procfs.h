@@ -0,0 +1,113 @@
+/**
+ * @file procfs.h
+ *
+ * Reader for the system wide procfs files (/proc/stat, /proc/meminfo,
+ * /proc/loadavg, /proc/diskstats, ...)
+ *
+ * Each file is opened once and re-read from offset 0 with pread(2) into
+ * a buffer owned by the reader. The kernel regenerates the content on
+ * every read at offset 0, so there is no need to close and reopen the
+ * file, and no stdio buffer is allocated on every sample.
+ *
+ * The files can be read below another root directory and the samples
+ * timed with another clock, the benchmarks replay a synthetic system
+ * that way.
+ */
+
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Prototype of a monotonic clock, in nanoseconds */
+typedef uint64_t (*procfs_clock_t)(void);
+
+typedef struct {
+    int fd;
+    char *buf;                          /* NUL terminated content of the last read */
+    size_t len;
+    size_t cap;
+} procfs_file_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Read the system files below another directory
+ * @description must be called before the files are opened, the root
+ * prefixes /proc and /sys, i.e root/proc/stat
+ * @param root the directory, NULL or "" for the real system
+ */
+void procfs_set_root(const char *root);
+
+/**
+ * Get the path of a system file below the root
+ * @param path the absolute path, i.e /proc/stat
+ * @param buf receives the path
+ * @param size the size of buf
+ * @return buf
+ */
+const char *procfs_path(const char *path, char *buf, size_t size);
+
+/**
+ * Time the samples with another clock
+ * @param clock the clock, NULL for CLOCK_MONOTONIC
+ */
+void procfs_set_clock(procfs_clock_t clock);
+
+/**
+ * Get the time of a sample
+ * @return the time of the clock in nanoseconds
+ */
+uint64_t procfs_now_ns(void);
+
+/**
+ * Open a procfs file
+ * @param file the reader to initialize
+ * @param path the path of the file, i.e /proc/stat, below the root
+ * @return 0 on success, -1 on error
+ */
+int procfs_open(procfs_file_t *file, const char *path);
+
+/**
+ * Read the whole file again
+ * @description the buffer grows if the content does not fit,
+ * it is never shrunk
+ * @param file the reader
+ * @return the length of the content, -1 on error
+ */
+ssize_t procfs_read(procfs_file_t *file);
+
+/**
+ * Close the file and release the buffer
+ * @param file the reader
+ */
+void procfs_close(procfs_file_t *file);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*PROCFS_H*/
@@ -0,0 +1,282 @@
+/**
+ * @file procfs_parse.c
+ *
+ * Tokenizer for the procfs text formats
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "procfs_parse.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Size of the meminfo hash table, power of two */
+#define MEMINFO_SLOTS   64
+
+/*
+ * Perfect hash of the meminfo keys, found offline for the keys of
+ * procfs_meminfo_key_t - no two of them share a slot. Other keys may land
+ * on a used slot, the name is compared to reject them.
+ */
+#define MEMINFO_HASH(p, len) \
+    (((len) + (uint32_t)(p)[0] + (uint32_t)(p)[3] * 54u + (uint32_t)(p)[(len) - 1]) & (MEMINFO_SLOTS - 1))
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    const char *name;
+    uint32_t len;
+} meminfo_name_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static inline bool is_digit(char c);
+static inline bool is_8_digits(uint64_t chunk);
+static inline uint64_t parse_8_digits(uint64_t chunk);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static const int8_t meminfo_slots[MEMINFO_SLOTS] = {
+    PROCFS_MEMINFO_BUFFERS, -1, -1, PROCFS_MEMINFO_WRITEBACK,
+    -1, -1, -1, PROCFS_MEMINFO_HUGEPAGESIZE,
+    -1, PROCFS_MEMINFO_HUGE_PAGES_FREE, -1, -1,
+    -1, -1, -1, -1,
+    -1, PROCFS_MEMINFO_HUGE_PAGES_TOTAL, PROCFS_MEMINFO_ACTIVE, PROCFS_MEMINFO_SHMEM,
+    -1, -1, PROCFS_MEMINFO_SUNRECLAIM, PROCFS_MEMINFO_MAPPED,
+    PROCFS_MEMINFO_INACTIVE, -1, -1, PROCFS_MEMINFO_PAGE_TABLES,
+    -1, PROCFS_MEMINFO_CACHED, -1, -1,
+    PROCFS_MEMINFO_SWAP_FREE, PROCFS_MEMINFO_SWAP_CACHED, -1, -1,
+    -1, PROCFS_MEMINFO_SLAB, PROCFS_MEMINFO_SRECLAIMABLE, -1,
+    PROCFS_MEMINFO_SWAP_TOTAL, -1, -1, -1,
+    -1, -1, -1, -1,
+    -1, PROCFS_MEMINFO_ANON_PAGES, -1, -1,
+    PROCFS_MEMINFO_MEM_AVAILABLE, PROCFS_MEMINFO_KERNEL_STACK, -1, -1,
+    -1, PROCFS_MEMINFO_MEM_TOTAL, PROCFS_MEMINFO_DIRTY, -1,
+    -1, PROCFS_MEMINFO_MEM_FREE, -1, -1,
+};
+
+static const meminfo_name_t meminfo_names[PROCFS_MEMINFO_COUNT] = {
+    [PROCFS_MEMINFO_MEM_TOTAL] = {"MemTotal", 8},
+    [PROCFS_MEMINFO_MEM_FREE] = {"MemFree", 7},
+    [PROCFS_MEMINFO_MEM_AVAILABLE] = {"MemAvailable", 12},
+    [PROCFS_MEMINFO_BUFFERS] = {"Buffers", 7},
+    [PROCFS_MEMINFO_CACHED] = {"Cached", 6},
+    [PROCFS_MEMINFO_SWAP_CACHED] = {"SwapCached", 10},
+    [PROCFS_MEMINFO_ACTIVE] = {"Active", 6},
+    [PROCFS_MEMINFO_INACTIVE] = {"Inactive", 8},
+    [PROCFS_MEMINFO_SHMEM] = {"Shmem", 5},
+    [PROCFS_MEMINFO_SLAB] = {"Slab", 4},
+    [PROCFS_MEMINFO_SRECLAIMABLE] = {"SReclaimable", 12},
+    [PROCFS_MEMINFO_SUNRECLAIM] = {"SUnreclaim", 10},
+    [PROCFS_MEMINFO_SWAP_TOTAL] = {"SwapTotal", 9},
+    [PROCFS_MEMINFO_SWAP_FREE] = {"SwapFree", 8},
+    [PROCFS_MEMINFO_DIRTY] = {"Dirty", 5},
+    [PROCFS_MEMINFO_WRITEBACK] = {"Writeback", 9},
+    [PROCFS_MEMINFO_ANON_PAGES] = {"AnonPages", 9},
+    [PROCFS_MEMINFO_MAPPED] = {"Mapped", 6},
+    [PROCFS_MEMINFO_KERNEL_STACK] = {"KernelStack", 11},
+    [PROCFS_MEMINFO_PAGE_TABLES] = {"PageTables", 10},
+    [PROCFS_MEMINFO_HUGE_PAGES_TOTAL] = {"HugePages_Total", 15},
+    [PROCFS_MEMINFO_HUGE_PAGES_FREE] = {"HugePages_Free", 14},
+    [PROCFS_MEMINFO_HUGEPAGESIZE] = {"Hugepagesize", 12},
+};
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+uint64_t procfs_parse_u64(procfs_view_t *view)
+{
+    const char *p = view->ptr;
+    const char *end = view->ptr + view->len;
+    uint64_t val = 0;
+    uint64_t chunk;
+
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+
+    /* The counters of /proc/stat and /proc/[pid]/io are often long */
+    while (end - p >= 8) {
+        memcpy(&chunk, p, sizeof(chunk));
+        if (!is_8_digits(chunk)) {
+            break;
+        }
+        val = val * 100000000u + parse_8_digits(chunk);
+        p += 8;
+    }
+
+    while (p < end && is_digit(*p)) {
+        val = val * 10 + (uint64_t)(*p - '0');
+        p++;
+    }
+
+    view->len = (size_t)(end - p);
+    view->ptr = p;
+    return val;
+}
+
+uint64_t procfs_parse_fixed(procfs_view_t *view, uint32_t scale)
+{
+    uint64_t val = procfs_parse_u64(view) * scale;
+    uint32_t unit = scale;
+
+    if (view->len > 0 && view->ptr[0] == '.') {
+        view->ptr++;
+        view->len--;
+
+        while (view->len > 0 && is_digit(view->ptr[0])) {
+            unit /= 10;
+            val += (uint64_t)(view->ptr[0] - '0') * unit;
+            view->ptr++;
+            view->len--;
+        }
+    }
+
+    return val;
+}
+
+procfs_meminfo_key_t procfs_meminfo_lookup(procfs_view_t key)
+{
+    const meminfo_name_t *name;
+    int8_t slot;
+
+    /* The hash reads the 4th character, no known key is shorter */
+    if (key.len < 4) {
+        return PROCFS_MEMINFO_UNKNOWN;
+    }
+
+    slot = meminfo_slots[MEMINFO_HASH((const unsigned char *)key.ptr, (uint32_t)key.len)];
+    if (slot < 0) {
+        return PROCFS_MEMINFO_UNKNOWN;
+    }
+
+    name = &meminfo_names[slot];
+    if (name->len != key.len || memcmp(name->name, key.ptr, key.len) != 0) {
+        return PROCFS_MEMINFO_UNKNOWN;
+    }
+
+    return (procfs_meminfo_key_t)slot;
+}
+
+void procfs_parse_meminfo(const char *buf, size_t len, procfs_meminfo_t *info)
+{
+    procfs_view_t text = procfs_view(buf, len);
+    procfs_view_t line;
+    procfs_view_t key;
+    procfs_meminfo_key_t id;
+    const char *colon;
+
+    memset(info, 0, sizeof(*info));
+
+    /* Key:     123456 kB */
+    while (procfs_next_line(&text, &line)) {
+
+        colon = memchr(line.ptr, ':', line.len);
+        if (colon == NULL) {
+            continue;
+        }
+
+        key.ptr = line.ptr;
+        key.len = (size_t)(colon - line.ptr);
+
+        id = procfs_meminfo_lookup(key);
+        if (id == PROCFS_MEMINFO_UNKNOWN) {
+            continue;
+        }
+
+        line.len -= key.len + 1;
+        line.ptr = colon + 1;
+
+        info->values[id] = procfs_parse_u64(&line);
+        info->present |= 1u << id;
+    }
+}
+
+bool procfs_parse_cpu_line(procfs_view_t line, procfs_cpu_times_t *times)
+{
+    procfs_view_t name;
+    uint32_t i;
+
+    memset(times, 0, sizeof(*times));
+
+    if (!procfs_next_field(&line, &name) || !PROCFS_VIEW_STARTS_WITH(name, "cpu")) {
+        return false;
+    }
+
+    for (i = 0; i < PROCFS_CPU_FIELDS; i++) {
+
+        /* Skip the blanks to tell a missing column from a 0 */
+        while (line.len > 0 && line.ptr[0] == ' ') {
+            line.ptr++;
+            line.len--;
+        }
+
+        if (line.len == 0 || !is_digit(line.ptr[0])) {
+            break;
+        }
+
+        times->fields[i] = procfs_parse_u64(&line);
+    }
+
+    times->count = i;
+    return i > PROCFS_CPU_IDLE;
+}
+
+uint64_t procfs_cpu_total(const procfs_cpu_times_t *times)
+{
+    const uint64_t *f = times->fields;
+
+    return f[PROCFS_CPU_USER] + f[PROCFS_CPU_NICE] + f[PROCFS_CPU_SYSTEM] + f[PROCFS_CPU_IDLE] +
+           f[PROCFS_CPU_IOWAIT] + f[PROCFS_CPU_IRQ] + f[PROCFS_CPU_SOFTIRQ] + f[PROCFS_CPU_STEAL];
+}
+
+uint64_t procfs_cpu_idle(const procfs_cpu_times_t *times)
+{
+    return times->fields[PROCFS_CPU_IDLE] + times->fields[PROCFS_CPU_IOWAIT];
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static inline bool is_digit(char c)
+{
+    /* A single comparison thanks to the unsigned wrap around */
+    return (unsigned char)(c - '0') < 10;
+}
+
+/**
+ * Check that 8 characters loaded in a word are all digits
+ */
+static inline bool is_8_digits(uint64_t chunk)
+{
+    /* Any byte below '0' borrows into bit 7 with the subtraction, any byte above '9' carries into it with the addition */
+    return (((chunk + 0x4646464646464646ULL) | (chunk - 0x3030303030303030ULL)) & 0x8080808080808080ULL) == 0;
+}
+
+/**
+ * Convert 8 digits loaded in a word, the first digit is the lowest byte
+ */
+static inline uint64_t parse_8_digits(uint64_t chunk)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    chunk = __builtin_bswap64(chunk);
+#endif
+
+    /* Combine pairs of digits, then pairs of pairs, then the two halves */
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFULL;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFULL;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000FFFFFFFFULL;
+
+    return chunk;
+}
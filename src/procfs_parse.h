@@ -0,0 +1,262 @@
+/**
+ * @file procfs_parse.h
+ *
+ * Tokenizer for the procfs text formats
+ *
+ * Lines and fields are returned as views pointing into the read buffer,
+ * nothing is copied and nothing is NUL terminated. Numbers are parsed
+ * directly from the views.
+ */
+
+#ifndef PROCFS_PARSE_H
+#define PROCFS_PARSE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Number of columns of a cpu line of /proc/stat known to this parser */
+#define PROCFS_CPU_FIELDS   10
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* A slice of the read buffer */
+typedef struct {
+    const char *ptr;
+    size_t len;
+} procfs_view_t;
+
+/* Keys of /proc/meminfo that can be looked up */
+typedef enum {
+    PROCFS_MEMINFO_MEM_TOTAL,
+    PROCFS_MEMINFO_MEM_FREE,
+    PROCFS_MEMINFO_MEM_AVAILABLE,
+    PROCFS_MEMINFO_BUFFERS,
+    PROCFS_MEMINFO_CACHED,
+    PROCFS_MEMINFO_SWAP_CACHED,
+    PROCFS_MEMINFO_ACTIVE,
+    PROCFS_MEMINFO_INACTIVE,
+    PROCFS_MEMINFO_SHMEM,
+    PROCFS_MEMINFO_SLAB,
+    PROCFS_MEMINFO_SRECLAIMABLE,
+    PROCFS_MEMINFO_SUNRECLAIM,
+    PROCFS_MEMINFO_SWAP_TOTAL,
+    PROCFS_MEMINFO_SWAP_FREE,
+    PROCFS_MEMINFO_DIRTY,
+    PROCFS_MEMINFO_WRITEBACK,
+    PROCFS_MEMINFO_ANON_PAGES,
+    PROCFS_MEMINFO_MAPPED,
+    PROCFS_MEMINFO_KERNEL_STACK,
+    PROCFS_MEMINFO_PAGE_TABLES,
+    PROCFS_MEMINFO_HUGE_PAGES_TOTAL,
+    PROCFS_MEMINFO_HUGE_PAGES_FREE,
+    PROCFS_MEMINFO_HUGEPAGESIZE,
+    PROCFS_MEMINFO_COUNT,
+    PROCFS_MEMINFO_UNKNOWN = PROCFS_MEMINFO_COUNT,
+} procfs_meminfo_key_t;
+
+/* Values of /proc/meminfo, in kB except the HugePages_ counters */
+typedef struct {
+    uint64_t values[PROCFS_MEMINFO_COUNT];
+    uint32_t present;                   /* bit mask of the keys found */
+} procfs_meminfo_t;
+
+/* Columns of a cpu line of /proc/stat, in clock ticks */
+typedef enum {
+    PROCFS_CPU_USER,
+    PROCFS_CPU_NICE,
+    PROCFS_CPU_SYSTEM,
+    PROCFS_CPU_IDLE,
+    PROCFS_CPU_IOWAIT,
+    PROCFS_CPU_IRQ,
+    PROCFS_CPU_SOFTIRQ,
+    PROCFS_CPU_STEAL,
+    PROCFS_CPU_GUEST,
+    PROCFS_CPU_GUEST_NICE,
+} procfs_cpu_field_t;
+
+typedef struct {
+    uint64_t fields[PROCFS_CPU_FIELDS];
+    uint32_t count;                     /* number of columns present on the line */
+} procfs_cpu_times_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Parse an unsigned decimal number
+ * @description leading blanks are skipped, parsing stops at the first
+ * non digit character, 8 digits are converted at a time when possible
+ * @param view the text, it is advanced past the number
+ * @return the value, 0 if there are no digits
+ */
+uint64_t procfs_parse_u64(procfs_view_t *view);
+
+/**
+ * Parse a decimal number with a fractional part as a fixed point value
+ * @param view the text, i.e "0.52", it is advanced past the number
+ * @param scale the multiplier, i.e 100 to get 52 from "0.52"
+ * @return the value multiplied by scale, extra decimals are truncated
+ */
+uint64_t procfs_parse_fixed(procfs_view_t *view, uint32_t scale);
+
+/**
+ * Look up a /proc/meminfo key through a perfect hash
+ * @param key the key without the ':'
+ * @return the key, or PROCFS_MEMINFO_UNKNOWN
+ */
+procfs_meminfo_key_t procfs_meminfo_lookup(procfs_view_t key);
+
+/**
+ * Parse the content of /proc/meminfo
+ * @param buf the content
+ * @param len the length of the content
+ * @param info the parsed values, the keys not found are 0
+ */
+void procfs_parse_meminfo(const char *buf, size_t len, procfs_meminfo_t *info);
+
+/**
+ * Parse a cpu line of /proc/stat, i.e "cpu0 4705 150 1120 16250 520 ..."
+ * @description any number of columns is accepted, the ones beyond
+ * PROCFS_CPU_FIELDS are ignored
+ * @param line the line, including the cpu name
+ * @param times the parsed columns, the missing ones are 0
+ * @return false if it is not a cpu line
+ */
+bool procfs_parse_cpu_line(procfs_view_t line, procfs_cpu_times_t *times);
+
+/**
+ * Get the total time of a cpu line
+ * @description guest and guest_nice are already accounted in user and nice
+ * @param times the parsed line
+ * @return the sum of the columns, in clock ticks
+ */
+uint64_t procfs_cpu_total(const procfs_cpu_times_t *times);
+
+/**
+ * Get the idle time of a cpu line, idle + iowait
+ * @param times the parsed line
+ * @return the idle time, in clock ticks
+ */
+uint64_t procfs_cpu_idle(const procfs_cpu_times_t *times);
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**
+ * Make a view of a whole buffer
+ */
+static inline procfs_view_t procfs_view(const char *buf, size_t len)
+{
+    procfs_view_t view = {buf, len};
+    return view;
+}
+
+/**
+ * Split the next line off a view
+ * @param text the remaining text, it is advanced past the line
+ * @param line the line, without the '\n'
+ * @return false when there are no lines left
+ */
+static inline bool procfs_next_line(procfs_view_t *text, procfs_view_t *line)
+{
+    const char *nl;
+
+    if (text->len == 0) {
+        return false;
+    }
+
+    nl = (const char *)memchr(text->ptr, '\n', text->len);
+    line->ptr = text->ptr;
+    line->len = nl ? (size_t)(nl - text->ptr) : text->len;
+
+    text->ptr += line->len + (nl ? 1 : 0);
+    text->len -= line->len + (nl ? 1 : 0);
+    return true;
+}
+
+/**
+ * Split the next blank separated field off a view
+ * @param text the remaining text, it is advanced past the field
+ * @param field the field
+ * @return false when there are no fields left
+ */
+static inline bool procfs_next_field(procfs_view_t *text, procfs_view_t *field)
+{
+    const char *p = text->ptr;
+    const char *end = text->ptr + text->len;
+
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+
+    field->ptr = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\n') {
+        p++;
+    }
+    field->len = (size_t)(p - field->ptr);
+
+    text->len = (size_t)(end - p);
+    text->ptr = p;
+    return field->len != 0;
+}
+
+/**
+ * Skip fields
+ * @param text the remaining text, it is advanced past the fields
+ * @param n the number of fields to skip
+ * @return false if there were less than n fields
+ */
+static inline bool procfs_skip_fields(procfs_view_t *text, uint32_t n)
+{
+    procfs_view_t field;
+
+    while (n-- > 0) {
+        if (!procfs_next_field(text, &field)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Compare a view with a string literal
+ */
+static inline bool procfs_view_eq(procfs_view_t view, const char *str, size_t len)
+{
+    return view.len == len && memcmp(view.ptr, str, len) == 0;
+}
+
+/**
+ * Test if a view starts with a string literal
+ */
+static inline bool procfs_view_starts_with(procfs_view_t view, const char *str, size_t len)
+{
+    return view.len >= len && memcmp(view.ptr, str, len) == 0;
+}
+
+#define PROCFS_VIEW_EQ(view, lit)           procfs_view_eq((view), (lit), sizeof(lit) - 1)
+#define PROCFS_VIEW_STARTS_WITH(view, lit)  procfs_view_starts_with((view), (lit), sizeof(lit) - 1)
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*PROCFS_PARSE_H*/
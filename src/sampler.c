@@ -0,0 +1,556 @@
+/**
+ * @file sampler.c
+ *
+ * Background sampler of the system monitor
+ *
+ * Triple buffer protocol - the consumer holds the front slot, the
+ * producer fills the back slot, and the latest published slot sits in
+ * between. Both sides swap their slot with the middle one in a single
+ * atomic exchange, the FRESH bit tells the consumer the middle slot was
+ * published since its last swap. A new sample always replaces the one the
+ * consumer has not picked up yet, the freshest wins and nothing blocks.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "sampler.h"
+#include "proc_cpu.h"
+#include "procfs.h"
+#include "procfs_parse.h"
+#include "cpu_stat.h"
+#include "lib/cpu_affinity.h"
+#include "lib/realtime.h"
+#include "lib/mem_alloc.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define SLOT_FRESH  0x80000000u
+#define SLOT_MASK   0x7FFFFFFFu
+
+/* Packing of the process scan configuration in a single word */
+#define SCAN_ENABLED    0x80000000u
+#define SCAN_KEY_SHIFT  16
+#define SCAN_K_MASK     0xFFFFu
+
+/* Number of block devices whose kind (whole disk or partition) is remembered */
+#define DISK_CACHE_SIZE 32
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    sampler_snapshot_t slots[SAMPLER_SLOT_COUNT];
+    uint32_t middle;                    /* latest published slot, exchanged by both sides */
+    uint32_t front;                     /* consumer side only */
+    uint32_t back;                      /* producer side only */
+} snapshot_ring_t;
+
+typedef struct {
+    char name[32];
+    bool whole;                         /* whole disk, partitions are not summed */
+} disk_kind_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void *sampler_thread(void *arg);
+static int alloc_slots(void);
+static void open_files(void);
+static void close_files(void);
+static void publish_sample(void);
+static void take_sample(sampler_snapshot_t *snap);
+static int get_cpu_usage(sampler_snapshot_t *snap);
+static int get_mem_usage(long *total_kb, long *used_kb);
+static void get_loadavg(uint32_t loadavg_x100[3]);
+static bool get_disk_rates(uint32_t *read_kbps, uint32_t *write_kbps);
+static bool is_whole_disk(const char *name, size_t len);
+static void scan_processes(sampler_snapshot_t *snap, uint32_t config);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static snapshot_ring_t ring;
+static pthread_t thread;
+static pthread_mutex_t stop_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stop_cond;
+static bool running;
+static bool manual;
+static bool stop_requested;
+static uint32_t sample_period_ms;
+static uint32_t scan_config;            /* written by the consumer, read by the producer */
+static uint32_t sample_seq;
+
+/* Producer side state */
+static proc_scan_t scanner;
+static proc_cpu_t proc_cpu;
+static bool scanner_ready;
+static uint32_t topk_idx[SAMPLER_MAX_PROCS];
+static uint64_t topk_keys[SAMPLER_MAX_PROCS];
+
+/* Opened once, re-read with pread() on every sample */
+static procfs_file_t stat_file;
+static cpu_stat_t cpu_stat;
+static procfs_file_t meminfo_file;
+static procfs_file_t loadavg_file;
+static procfs_file_t diskstats_file;
+
+static disk_kind_t disk_kinds[DISK_CACHE_SIZE];
+static uint32_t disk_kind_count;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int sampler_start(uint32_t period_ms)
+{
+    pthread_condattr_t attr;
+
+    if (running) {
+        return 0;
+    }
+
+    sample_period_ms = period_ms ? period_ms : 1000;
+    stop_requested = false;
+
+    if (alloc_slots() != 0) {
+        return -1;
+    }
+
+    /* Timed waits are measured on the monotonic clock */
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&stop_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&thread, NULL, sampler_thread, NULL) != 0) {
+        pthread_cond_destroy(&stop_cond);
+        return -1;
+    }
+
+    running = true;
+    return 0;
+}
+
+int sampler_start_manual(void)
+{
+    if (running) {
+        return 0;
+    }
+
+    if (alloc_slots() != 0) {
+        return -1;
+    }
+
+    open_files();
+    manual = true;
+    running = true;
+    return 0;
+}
+
+void sampler_step(void)
+{
+    if (manual) {
+        publish_sample();
+    }
+}
+
+void sampler_stop(void)
+{
+    uint32_t i;
+
+    if (!running) {
+        return;
+    }
+
+    if (manual) {
+        close_files();
+        manual = false;
+    } else {
+        pthread_mutex_lock(&stop_lock);
+        stop_requested = true;
+        pthread_cond_signal(&stop_cond);
+        pthread_mutex_unlock(&stop_lock);
+
+        pthread_join(thread, NULL);
+        pthread_cond_destroy(&stop_cond);
+    }
+
+    running = false;
+
+    for (i = 0; i < SAMPLER_SLOT_COUNT; i++) {
+        lv_free(ring.slots[i].procs);
+    }
+    memset(&ring, 0, sizeof(ring));
+}
+
+void sampler_set_process_scan(bool enabled, proc_sort_key_t key, uint32_t k)
+{
+    uint32_t config;
+
+    if (k > SAMPLER_MAX_PROCS) {
+        k = SAMPLER_MAX_PROCS;
+    }
+
+    config = (enabled ? SCAN_ENABLED : 0) | ((uint32_t)key << SCAN_KEY_SHIFT) | k;
+    __atomic_store_n(&scan_config, config, __ATOMIC_RELAXED);
+}
+
+const sampler_snapshot_t *sampler_acquire_latest(void)
+{
+    uint32_t middle;
+
+    if (!(__atomic_load_n(&ring.middle, __ATOMIC_RELAXED) & SLOT_FRESH)) {
+        /* Nothing new */
+        return NULL;
+    }
+
+    /* Release the held slot to the producer, the latest one is now held */
+    middle = __atomic_exchange_n(&ring.middle, ring.front, __ATOMIC_ACQ_REL);
+    ring.front = middle & SLOT_MASK;
+
+    return &ring.slots[ring.front];
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void *sampler_thread(void *arg)
+{
+    struct timespec deadline;
+    bool stop;
+
+    (void)arg;
+
+    /* Created by the main thread, on its cores and policy, the sampling moves off them */
+    cpu_affinity_pin(CPU_AFFINITY_EFFICIENCY, 0);
+    realtime_leave();
+
+    open_files();
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    while (true) {
+
+        publish_sample();
+
+        /* Absolute deadlines, the period does not drift with the sampling time */
+        deadline.tv_nsec += (long)(sample_period_ms % 1000) * 1000000L;
+        deadline.tv_sec += sample_period_ms / 1000;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_nsec -= 1000000000L;
+            deadline.tv_sec++;
+        }
+
+        pthread_mutex_lock(&stop_lock);
+        while (!stop_requested) {
+            if (pthread_cond_timedwait(&stop_cond, &stop_lock, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        stop = stop_requested;
+        pthread_mutex_unlock(&stop_lock);
+
+        if (stop) {
+            break;
+        }
+    }
+
+    close_files();
+
+    return NULL;
+}
+
+/**
+ * Allocate the process rows of the slots
+ * @description the rows are large, they are allocated once and reused by every sample
+ * @return 0 on success, -1 on allocation failure
+ */
+static int alloc_slots(void)
+{
+    mem_tag_t tag = mem_tag_set(MEM_TAG_SAMPLER);
+    uint32_t i;
+
+    /* Nothing published yet, the consumer holds a slot it never reads */
+    ring.front = 0;
+    ring.middle = 1;
+    ring.back = 2;
+
+    for (i = 0; i < SAMPLER_SLOT_COUNT; i++) {
+        if (ring.slots[i].procs == NULL) {
+            ring.slots[i].procs = lv_malloc(SAMPLER_MAX_PROCS * sizeof(proc_row_t));
+            if (ring.slots[i].procs == NULL) {
+                mem_tag_set(tag);
+                return -1;
+            }
+        }
+    }
+
+    mem_tag_set(tag);
+    return 0;
+}
+
+static void open_files(void)
+{
+    /* A file that can not be opened simply reads as empty */
+    procfs_open(&stat_file, "/proc/stat");
+    procfs_open(&meminfo_file, "/proc/meminfo");
+    procfs_open(&loadavg_file, "/proc/loadavg");
+    procfs_open(&diskstats_file, "/proc/diskstats");
+    cpu_stat_init(&cpu_stat);
+}
+
+static void close_files(void)
+{
+    if (scanner_ready) {
+        proc_cpu_deinit(&proc_cpu);
+        proc_scan_deinit(&scanner);
+        scanner_ready = false;
+    }
+
+    procfs_close(&stat_file);
+    procfs_close(&meminfo_file);
+    procfs_close(&loadavg_file);
+    procfs_close(&diskstats_file);
+}
+
+/**
+ * Take a sample into a free slot and publish it
+ */
+static void publish_sample(void)
+{
+    uint32_t middle;
+
+    /* The front slot held by the consumer is never written */
+    take_sample(&ring.slots[ring.back]);
+
+    /* The sample not picked up yet, if any, is the next one overwritten */
+    middle = __atomic_exchange_n(&ring.middle, ring.back | SLOT_FRESH, __ATOMIC_ACQ_REL);
+    ring.back = middle & SLOT_MASK;
+}
+
+/**
+ * Fill a snapshot, runs on the sampler thread
+ */
+static void take_sample(sampler_snapshot_t *snap)
+{
+    uint32_t config = __atomic_load_n(&scan_config, __ATOMIC_RELAXED);
+
+    snap->seq = ++sample_seq;
+    snap->cpu_usage = get_cpu_usage(snap);
+    snap->mem_usage = get_mem_usage(&snap->mem_total_kb, &snap->mem_used_kb);
+    get_loadavg(snap->loadavg_x100);
+    snap->has_disk = get_disk_rates(&snap->disk_read_kbps, &snap->disk_write_kbps);
+
+    snap->has_procs = false;
+    snap->has_io = false;
+    snap->proc_total = 0;
+    snap->proc_count = 0;
+
+    if ((config & SCAN_ENABLED) && snap->procs != NULL) {
+        scan_processes(snap, config);
+    }
+}
+
+/* 读取 CPU 使用率 (读取 /proc/stat), 一次解析出总体和每个核心的使用率 */
+static int get_cpu_usage(sampler_snapshot_t *snap)
+{
+    int usage;
+
+    snap->core_count = 0;
+    if(procfs_read(&stat_file) <= 0) return 0;
+
+    usage = cpu_stat_update(&cpu_stat, stat_file.buf, stat_file.len, snap->core_usage);
+    if(usage < 0) return 0;
+
+    snap->core_count = cpu_stat.core_count;
+    return usage;
+}
+
+/* 读取内存使用率 (读取 /proc/meminfo) */
+static int get_mem_usage(long *total_kb, long *used_kb)
+{
+    procfs_meminfo_t info;
+    uint32_t needed = (1u << PROCFS_MEMINFO_MEM_TOTAL) | (1u << PROCFS_MEMINFO_MEM_AVAILABLE);
+
+    *total_kb = 0;
+    *used_kb = 0;
+    if(procfs_read(&meminfo_file) <= 0) return 0;
+
+    procfs_parse_meminfo(meminfo_file.buf, meminfo_file.len, &info);
+    if((info.present & needed) != needed || info.values[PROCFS_MEMINFO_MEM_TOTAL] == 0) return 0;
+
+    // 计算已用内存
+    *total_kb = (long)info.values[PROCFS_MEMINFO_MEM_TOTAL];
+    *used_kb = *total_kb - (long)info.values[PROCFS_MEMINFO_MEM_AVAILABLE];
+
+    return (int)(*used_kb * 100 / *total_kb);
+}
+
+/* 读取系统负载 (读取 /proc/loadavg) */
+static void get_loadavg(uint32_t loadavg_x100[3])
+{
+    procfs_view_t text;
+    int i;
+
+    loadavg_x100[0] = loadavg_x100[1] = loadavg_x100[2] = 0;
+    if(procfs_read(&loadavg_file) <= 0) return;
+
+    /* 0.52 0.40 0.33 1/123 4567 */
+    text = procfs_view(loadavg_file.buf, loadavg_file.len);
+    for(i = 0; i < 3; i++) {
+        loadavg_x100[i] = (uint32_t)procfs_parse_fixed(&text, 100);
+    }
+}
+
+/**
+ * Read the disk throughput from /proc/diskstats
+ * @return false until two samples are available
+ */
+static bool get_disk_rates(uint32_t *read_kbps, uint32_t *write_kbps)
+{
+    static uint64_t prev_read, prev_write;
+    static uint64_t prev_ns;
+    static bool has_prev;
+    uint64_t sectors_read = 0;
+    uint64_t sectors_written = 0;
+    uint64_t read_diff;
+    uint64_t written_diff;
+    long long elapsed_ms;
+    uint64_t now_ns;
+    procfs_view_t text;
+    procfs_view_t line;
+    procfs_view_t name;
+    bool valid;
+
+    *read_kbps = 0;
+    *write_kbps = 0;
+    if(procfs_read(&diskstats_file) <= 0) return false;
+
+    now_ns = procfs_now_ns();
+
+    /* major minor name reads merged sectors_read ms writes merged sectors_written ... */
+    text = procfs_view(diskstats_file.buf, diskstats_file.len);
+    while(procfs_next_line(&text, &line)) {
+        if(!procfs_skip_fields(&line, 2) || !procfs_next_field(&line, &name)) continue;
+        if(!is_whole_disk(name.ptr, name.len)) continue;
+
+        if(!procfs_skip_fields(&line, 2)) continue;
+        sectors_read += procfs_parse_u64(&line);
+        if(!procfs_skip_fields(&line, 3)) continue;
+        sectors_written += procfs_parse_u64(&line);
+    }
+
+    valid = has_prev;
+    if(has_prev) {
+        elapsed_ms = (long long)((now_ns - prev_ns) / 1000000ULL);
+        if(elapsed_ms <= 0) elapsed_ms = 1;
+
+        /* 磁盘被移除或计数器回绕时总和会变小, 计为 0 */
+        read_diff = sectors_read >= prev_read ? sectors_read - prev_read : 0;
+        written_diff = sectors_written >= prev_write ? sectors_written - prev_write : 0;
+
+        /* 扇区固定为 512 字节, 512 / 1024 * 1000 = 500 */
+        *read_kbps = (uint32_t)(read_diff * 500ULL / (unsigned long long)elapsed_ms);
+        *write_kbps = (uint32_t)(written_diff * 500ULL / (unsigned long long)elapsed_ms);
+    }
+
+    prev_read = sectors_read;
+    prev_write = sectors_written;
+    prev_ns = now_ns;
+    has_prev = true;
+
+    return valid;
+}
+
+/**
+ * Tell whether a block device is a whole disk, partitions would count twice
+ * @description only whole disks have an entry in /sys/block, the answer is
+ * cached so the check costs a syscall only the first time a device is seen
+ */
+static bool is_whole_disk(const char *name, size_t len)
+{
+    char name_path[64];
+    char path[PATH_MAX];
+    uint32_t i;
+    bool whole;
+
+    if(len >= sizeof(disk_kinds[0].name)) return false;
+
+    for(i = 0; i < disk_kind_count; i++) {
+        if(strncmp(disk_kinds[i].name, name, len) == 0 && disk_kinds[i].name[len] == '\0') {
+            return disk_kinds[i].whole;
+        }
+    }
+
+    snprintf(name_path, sizeof(name_path), "/sys/block/%.*s", (int)len, name);
+    whole = access(procfs_path(name_path, path, sizeof(path)), F_OK) == 0;
+
+    if(disk_kind_count < DISK_CACHE_SIZE) {
+        memcpy(disk_kinds[disk_kind_count].name, name, len);
+        disk_kinds[disk_kind_count].name[len] = '\0';
+        disk_kinds[disk_kind_count].whole = whole;
+        disk_kind_count++;
+    }
+
+    return whole;
+}
+
+/**
+ * Scan the processes and copy the top K rows into the snapshot
+ */
+static void scan_processes(sampler_snapshot_t *snap, uint32_t config)
+{
+    proc_sort_key_t key = (proc_sort_key_t)((config & ~SCAN_ENABLED) >> SCAN_KEY_SHIFT);
+    uint32_t k = config & SCAN_K_MASK;
+    uint32_t i;
+    int count;
+
+    if (!scanner_ready) {
+        if (proc_scan_init(&scanner) != 0) {
+            return;
+        }
+        if (proc_cpu_init(&proc_cpu) != 0) {
+            proc_scan_deinit(&scanner);
+            return;
+        }
+        scanner_ready = true;
+    }
+
+    scanner.want_io = (key == PROC_SORT_IO);
+
+    count = proc_scan_update(&scanner);
+    if (count < 0) {
+        return;
+    }
+
+    proc_cpu_update(&proc_cpu, scanner.rows, (uint32_t)count, scanner.want_io != 0);
+
+    snap->proc_total = (uint32_t)count;
+    snap->proc_count = proc_topk_select(scanner.rows, (uint32_t)count, key, k, topk_idx, topk_keys);
+
+    for (i = 0; i < snap->proc_count; i++) {
+        proc_row_t *row = &scanner.rows[topk_idx[i]];
+
+        /* Only the rows that are displayed get their owner resolved */
+        proc_scan_resolve(&scanner, row);
+        snap->procs[i] = *row;
+    }
+
+    snap->sort_key = key;
+    snap->has_io = scanner.want_io != 0;
+    snap->has_procs = true;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file sampler.h
+ *
+ * Background sampler of the system monitor
+ *
+ * All the /proc collection runs on a dedicated thread, every sample is
+ * published as an immutable snapshot through a single producer / single
+ * consumer triple buffer. The LVGL thread only picks up the latest
+ * snapshot, a slow procfs read can therefore never stall rendering or
+ * input, and a slow frame never holds back a new sample.
+ *
+ * In manual mode there is no thread, the samples are taken on demand by
+ * the caller so that a benchmark replays the same samples on every run.
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "proc_scan.h"
+#include "proc_topk.h"
+#include "cpu_stat.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Maximum number of process rows carried by a snapshot */
+#define SAMPLER_MAX_PROCS   4096
+
+/* Maximum number of cores carried by a snapshot */
+#define SAMPLER_MAX_CORES   CPU_STAT_MAX_CORES
+
+/* Number of snapshots: held by the consumer, latest published, being taken */
+#define SAMPLER_SLOT_COUNT  3
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* One sample, never modified once published */
+typedef struct {
+    uint32_t seq;                       /* increments with every sample */
+    int cpu_usage;                      /* percent */
+    uint32_t core_count;                /* number of valid entries in core_usage */
+    uint8_t core_usage[SAMPLER_MAX_CORES]; /* percent, indexed by core number */
+    int mem_usage;                      /* percent */
+    long mem_total_kb;
+    long mem_used_kb;
+    uint32_t loadavg_x100[3];           /* 1, 5 and 15 minutes load average, times 100 */
+    bool has_disk;                      /* the disk rates are valid */
+    uint32_t disk_read_kbps;            /* summed over the whole disks */
+    uint32_t disk_write_kbps;
+    bool has_procs;                     /* false when the process scan is disabled */
+    bool has_io;                        /* io_rate of the rows is valid */
+    proc_sort_key_t sort_key;
+    uint32_t proc_total;                /* number of processes on the system */
+    uint32_t proc_count;                /* number of valid rows in procs */
+    proc_row_t *procs;                  /* SAMPLER_MAX_PROCS rows, allocated once per slot */
+} sampler_snapshot_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Start the sampler thread
+ * @param period_ms the sampling period
+ * @return 0 on success, -1 on error
+ */
+int sampler_start(uint32_t period_ms);
+
+/**
+ * Start the sampler in manual mode
+ * @description no thread is created, the samples are only taken by
+ * sampler_step(). sampler_start() does nothing until sampler_stop()
+ * @return 0 on success, -1 on error
+ */
+int sampler_start_manual(void);
+
+/**
+ * Take and publish a sample on the calling thread, in manual mode only
+ */
+void sampler_step(void);
+
+/**
+ * Stop the sampler thread and wait for it to exit
+ */
+void sampler_stop(void);
+
+/**
+ * Configure the process scan, can be called at any time from the consumer
+ * @param enabled scan the processes, it is the most expensive part
+ * of a sample, only enable it while the result is displayed
+ * @param key the sort key
+ * @param k the number of rows to select, at most SAMPLER_MAX_PROCS
+ */
+void sampler_set_process_scan(bool enabled, proc_sort_key_t key, uint32_t k);
+
+/**
+ * Get the most recent snapshot
+ * @description must only be called from the consumer thread, older
+ * snapshots that were not picked up are skipped
+ * @return the latest snapshot, or NULL if nothing new was published
+ * since the previous call. The snapshot stays valid until the next call.
+ */
+const sampler_snapshot_t *sampler_acquire_latest(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*SAMPLER_H*/
@@ -0,0 +1,338 @@
+/**
+ * @file fontpack_gen.c
+ *
+ * Write the fonts selected at build time into a font pack
+ *
+ * The fonts are the LVGL built-in fonts listed in FONTPACK_FONTS, each is
+ * compiled from its LVGL source by a fontpack_<name>.c unit whatever
+ * lv_conf.h enables. The pack is written with the structure layout of
+ * this build, it is loaded by fontpack_open().
+ *
+ * Usage: fontpack_gen output.pack
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "lvgl/lvgl.h"
+#include "fontpack.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* The structures of the pack are 8 bytes aligned */
+#define PACK_ALIGN  8
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    const char *name;
+    const lv_font_t *font;
+} source_font_t;
+
+/* The pack being written */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} pack_buf_t;
+
+/**********************
+ *  EXTERNAL VARIABLES
+ **********************/
+#define FONTPACK_FONT(name) extern const lv_font_t fontpack_src_##name;
+#include "fontpack_fonts.h"
+#undef FONTPACK_FONT
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static int write_font(pack_buf_t *buf, fontpack_entry_t *entry, const source_font_t *src);
+static uint32_t count_glyphs(const lv_font_fmt_txt_dsc_t *dsc);
+static uint32_t bitmap_size(const lv_font_fmt_txt_dsc_t *dsc, uint32_t glyph_count);
+static uint64_t put(pack_buf_t *buf, const void *data, size_t size);
+static const void *offset_ptr(uint64_t offset);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static const source_font_t fonts[] = {
+#define FONTPACK_FONT(name) {#name, &fontpack_src_##name},
+#include "fontpack_fonts.h"
+#undef FONTPACK_FONT
+};
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(int argc, char **argv)
+{
+    const uint32_t count = sizeof(fonts) / sizeof(fonts[0]);
+    fontpack_header_t header;
+    fontpack_entry_t *entries;
+    pack_buf_t buf = {0};
+    uint64_t entries_offset;
+    FILE *f;
+    uint32_t i;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s output.pack\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FONTPACK_MAGIC, sizeof(header.magic));
+    header.version = FONTPACK_VERSION;
+    header.font_count = count;
+    header.font_size = sizeof(lv_font_t);
+    header.dsc_size = sizeof(lv_font_fmt_txt_dsc_t);
+    header.glyph_dsc_size = sizeof(lv_font_fmt_txt_glyph_dsc_t);
+    header.cmap_size = sizeof(lv_font_fmt_txt_cmap_t);
+    header.kern_classes_size = sizeof(lv_font_fmt_txt_kern_classes_t);
+    header.kern_pair_size = sizeof(lv_font_fmt_txt_kern_pair_t);
+
+    /* The entries are filled in once the fonts are written */
+    entries = calloc(count, sizeof(*entries));
+    if (entries == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    put(&buf, &header, sizeof(header));
+    entries_offset = put(&buf, entries, count * sizeof(*entries));
+
+    for (i = 0; i < count; i++) {
+        if (write_font(&buf, &entries[i], &fonts[i]) != 0) {
+            return EXIT_FAILURE;
+        }
+        printf("%-32s %6u glyphs %8u bytes of bitmaps\n", fonts[i].name, (unsigned)entries[i].glyph_count,
+               (unsigned)entries[i].bitmap_size);
+    }
+
+    memcpy(buf.data + entries_offset, entries, count * sizeof(*entries));
+
+    f = fopen(argv[1], "wb");
+    if (f == NULL || fwrite(buf.data, 1, buf.size, f) != buf.size || fclose(f) != 0) {
+        fprintf(stderr, "Failed to write %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    printf("Wrote %u fonts, %zu bytes to %s\n", (unsigned)count, buf.size, argv[1]);
+
+    free(entries);
+    free(buf.data);
+    return EXIT_SUCCESS;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Append a font, the pointers of its structures become offsets in the pack
+ * @return 0 on success, -1 if the font can not be packed
+ */
+static int write_font(pack_buf_t *buf, fontpack_entry_t *entry, const source_font_t *src)
+{
+    const lv_font_fmt_txt_dsc_t *dsc = src->font->dsc;
+    const lv_font_fmt_txt_kern_classes_t *kc;
+    const lv_font_fmt_txt_kern_pair_t *kp;
+    lv_font_fmt_txt_kern_classes_t kern_classes;
+    lv_font_fmt_txt_kern_pair_t kern_pair;
+    lv_font_fmt_txt_cmap_t *cmaps;
+    lv_font_fmt_txt_dsc_t out_dsc;
+    lv_font_t out_font;
+    uint32_t i;
+
+    if (strlen(src->name) >= FONTPACK_NAME_MAX) {
+        fprintf(stderr, "%s: the name is too long\n", src->name);
+        return -1;
+    }
+
+    /* The loader only sets up the text format */
+    if (src->font->get_glyph_dsc != lv_font_get_glyph_dsc_fmt_txt || dsc == NULL) {
+        fprintf(stderr, "%s: not a font in the text format\n", src->name);
+        return -1;
+    }
+
+    /* The size of a compressed bitmap is not known from its descriptor */
+    if (dsc->bitmap_format != LV_FONT_FMT_TXT_PLAIN) {
+        fprintf(stderr, "%s: compressed fonts are not supported\n", src->name);
+        return -1;
+    }
+
+    strcpy(entry->name, src->name);
+    entry->glyph_count = count_glyphs(dsc);
+    entry->bitmap_size = bitmap_size(dsc, entry->glyph_count);
+
+    out_dsc = *dsc;
+    out_dsc.glyph_bitmap = offset_ptr(put(buf, dsc->glyph_bitmap, entry->bitmap_size));
+    out_dsc.glyph_dsc = offset_ptr(put(buf, dsc->glyph_dsc, entry->glyph_count * sizeof(dsc->glyph_dsc[0])));
+
+    cmaps = calloc(dsc->cmap_num, sizeof(cmaps[0]));
+    if (cmaps == NULL && dsc->cmap_num > 0) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+
+    for (i = 0; i < dsc->cmap_num; i++) {
+        cmaps[i] = dsc->cmaps[i];
+        if (cmaps[i].unicode_list != NULL) {
+            cmaps[i].unicode_list = offset_ptr(put(buf, dsc->cmaps[i].unicode_list,
+                                                   fontpack_cmap_unicode_size(&dsc->cmaps[i])));
+        }
+        if (cmaps[i].glyph_id_ofs_list != NULL) {
+            cmaps[i].glyph_id_ofs_list = offset_ptr(put(buf, dsc->cmaps[i].glyph_id_ofs_list,
+                                                        fontpack_cmap_ofs_size(&dsc->cmaps[i])));
+        }
+    }
+    out_dsc.cmaps = offset_ptr(put(buf, cmaps, dsc->cmap_num * sizeof(cmaps[0])));
+    free(cmaps);
+
+    if (dsc->kern_dsc != NULL && dsc->kern_classes) {
+        kc = dsc->kern_dsc;
+        kern_classes = *kc;
+        kern_classes.class_pair_values = offset_ptr(put(buf, kc->class_pair_values,
+                                                        (size_t)kc->left_class_cnt * kc->right_class_cnt));
+        kern_classes.left_class_mapping = offset_ptr(put(buf, kc->left_class_mapping, entry->glyph_count));
+        kern_classes.right_class_mapping = offset_ptr(put(buf, kc->right_class_mapping, entry->glyph_count));
+        out_dsc.kern_dsc = offset_ptr(put(buf, &kern_classes, sizeof(kern_classes)));
+    } else if (dsc->kern_dsc != NULL) {
+        kp = dsc->kern_dsc;
+        kern_pair = *kp;
+        kern_pair.glyph_ids = offset_ptr(put(buf, kp->glyph_ids, (size_t)kp->pair_cnt *
+                                             (kp->glyph_ids_size == 0 ? 2 : 4)));
+        kern_pair.values = offset_ptr(put(buf, kp->values, kp->pair_cnt));
+        out_dsc.kern_dsc = offset_ptr(put(buf, &kern_pair, sizeof(kern_pair)));
+    }
+
+    /* The functions are set by the loader */
+    out_font = *src->font;
+    out_font.get_glyph_dsc = NULL;
+    out_font.get_glyph_bitmap = NULL;
+    out_font.release_glyph = NULL;
+    out_font.fallback = NULL;
+    out_font.user_data = NULL;
+    out_font.dsc = offset_ptr(put(buf, &out_dsc, sizeof(out_dsc)));
+
+    entry->font_offset = put(buf, &out_font, sizeof(out_font));
+    return 0;
+}
+
+/**
+ * Count the glyph descriptors, the highest glyph id of the character maps plus one
+ */
+static uint32_t count_glyphs(const lv_font_fmt_txt_dsc_t *dsc)
+{
+    const lv_font_fmt_txt_cmap_t *cmap;
+    const uint8_t *ofs8;
+    const uint16_t *ofs16;
+    uint32_t last = 0;
+    uint32_t id;
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < dsc->cmap_num; i++) {
+        cmap = &dsc->cmaps[i];
+        id = 0;
+
+        switch (cmap->type) {
+        case LV_FONT_FMT_TXT_CMAP_FORMAT0_TINY:
+            id = cmap->range_length > 0 ? cmap->glyph_id_start + cmap->range_length - 1u : 0;
+            break;
+        case LV_FONT_FMT_TXT_CMAP_SPARSE_TINY:
+            id = cmap->list_length > 0 ? cmap->glyph_id_start + cmap->list_length - 1u : 0;
+            break;
+        case LV_FONT_FMT_TXT_CMAP_FORMAT0_FULL:
+            ofs8 = cmap->glyph_id_ofs_list;
+            for (j = 0; j < cmap->range_length; j++) {
+                id = LV_MAX(id, cmap->glyph_id_start + ofs8[j]);
+            }
+            break;
+        case LV_FONT_FMT_TXT_CMAP_SPARSE_FULL:
+            ofs16 = cmap->glyph_id_ofs_list;
+            for (j = 0; j < cmap->list_length; j++) {
+                id = LV_MAX(id, cmap->glyph_id_start + ofs16[j]);
+            }
+            break;
+        }
+
+        last = LV_MAX(last, id);
+    }
+
+    return last + 1;
+}
+
+/**
+ * Size of the bitmaps, up to the end of the glyph stored last
+ */
+static uint32_t bitmap_size(const lv_font_fmt_txt_dsc_t *dsc, uint32_t glyph_count)
+{
+    const lv_font_fmt_txt_glyph_dsc_t *g;
+    uint32_t size = 0;
+    uint32_t row;
+    uint32_t end;
+    uint32_t i;
+
+    for (i = 0; i < glyph_count; i++) {
+        g = &dsc->glyph_dsc[i];
+
+        /* The rows are packed bit by bit unless they are aligned to a stride */
+        if (dsc->stride != 0) {
+            row = ((uint32_t)g->box_w * dsc->bpp + 7) / 8;
+            row = (row + dsc->stride - 1) / dsc->stride * dsc->stride;
+            end = g->bitmap_index + row * g->box_h;
+        } else {
+            end = g->bitmap_index + ((uint32_t)g->box_w * g->box_h * dsc->bpp + 7) / 8;
+        }
+
+        size = LV_MAX(size, end);
+    }
+
+    return size;
+}
+
+/**
+ * Append data to the pack
+ * @return the offset of the data
+ */
+static uint64_t put(pack_buf_t *buf, const void *data, size_t size)
+{
+    size_t offset = (buf->size + PACK_ALIGN - 1) / PACK_ALIGN * PACK_ALIGN;
+
+    while (offset + size > buf->capacity) {
+        buf->capacity = buf->capacity != 0 ? buf->capacity * 2 : 1024 * 1024;
+        buf->data = realloc(buf->data, buf->capacity);
+        if (buf->data == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memset(buf->data + buf->size, 0, offset - buf->size);
+    if (size > 0) {
+        memcpy(buf->data + offset, data, size);
+    }
+    buf->size = offset + size;
+
+    return offset;
+}
+
+static const void *offset_ptr(uint64_t offset)
+{
+    return (const void *)(uintptr_t)offset;
+}
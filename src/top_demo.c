@@ -1,4 +1,10 @@
 #include "top_demo.h"
+#include "sampler.h"
+#include "core_heatmap.h"
+#include "proc_list.h"
+#include "ui_bind.h"
+#include "lib/simulator_util.h"
+#include "lib/mem_alloc.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -8,6 +14,18 @@
  *      DEFINES
  *********************/
 #define CHART_POINT_COUNT 20
+/* 进程列表是虚拟化的, 最多显示所有进程 */
+#define PROCESS_TABLE_MAX_ROWS SAMPLER_MAX_PROCS
+/* 默认只选出列表顶部到可见区域底部的行, 再加一些余量, 滚动时不会立即出现空行 */
+#define PROCESS_TABLE_MARGIN_ROWS 32
+/* 采样线程的周期, 界面定时器只负责取最新的快照 */
+#define SAMPLE_PERIOD_MS 1000
+#define UI_POLL_PERIOD_MS 100
+/* 每个核心一个小圆弧 */
+#define CORE_ARC_SIZE 52
+/* 热力图显示的采样数和高度 */
+#define HEATMAP_COLUMNS 240
+#define HEATMAP_HEIGHT 320
 
 /*********************
  *      TYPEDEFS
@@ -19,112 +37,55 @@ typedef struct {
     lv_obj_t * chart;
     lv_chart_series_t * ser;
     lv_obj_t * win;
-    lv_obj_t * label_top_output; 
+    lv_obj_t * proc_list;
     const char * title;
-    int (*get_value_cb)(void);
+    int (*get_value_cb)(const sampler_snapshot_t * snap);
     int last_value;
+    /* 只有显示内容变化时才更新控件, 避免无谓的重绘 */
+    ui_bind_arc_t arc_bind;
+    ui_bind_label_t val_bind;
+    ui_bind_label_t info_bind;
+    ui_bind_chart_t chart_bind;
 } monitor_item_t;
 
 /*********************
  *  STATIC VARIABLES
  *********************/
- static long mem_total_kb = 0;
-static long mem_used_kb = 0;
 static monitor_item_t cpu_mon;
 static monitor_item_t mem_mon;
 static lv_timer_t * monitor_timer;
+static proc_sort_key_t process_sort_key = PROC_SORT_CPU;
+static uint32_t process_top_k;     /* 0: 按滚动位置选出的行数 */
+static lv_obj_t * core_cont;
+static ui_bind_arc_t core_arcs[SAMPLER_MAX_CORES];
+static uint32_t core_arc_count;
+static lv_obj_t * heatmap_win;
+static lv_obj_t * heatmap;
 
 /*********************
  *  HELPER FUNCTIONS
  *********************/
 
-/* 读取 CPU 使用率 (读取 /proc/stat) */
-static int get_cpu_usage(void)
+/* 从快照中取 CPU 使用率, 数据由采样线程读取 /proc/stat */
+static int get_cpu_usage(const sampler_snapshot_t * snap)
 {
-    static unsigned long long prev_total = 0, prev_idle = 0;
-    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
-    FILE *fp = fopen("/proc/stat", "r");
-    if(!fp) return 0;
-
-    if(fscanf(fp, "cpu  %llu %llu %llu %llu %llu %llu %llu %llu",
-              &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) != 8) {
-        fclose(fp);
-        return 0;
-    }
-    fclose(fp);
-
-    unsigned long long idle_time = idle + iowait;
-    unsigned long long total_time = user + nice + system + idle + iowait + irq + softirq + steal;
-    unsigned long long total_diff = total_time - prev_total;
-    unsigned long long idle_diff = idle_time - prev_idle;
-
-    prev_total = total_time;
-    prev_idle = idle_time;
-
-    if(total_diff == 0) return 0;
-    return (int)((total_diff - idle_diff) * 100 / total_diff);
+    return snap->cpu_usage;
 }
 
-/* 读取内存使用率 (读取 /proc/meminfo) */
-static int get_mem_usage(void)
+/* 从快照中取内存使用率, 数据由采样线程读取 /proc/meminfo */
+static int get_mem_usage(const sampler_snapshot_t * snap)
 {
-    long mem_available = 0;
-    FILE *fp = fopen("/proc/meminfo", "r");
-    if(!fp) return 0;
-
-    char key[32];
-    long value;
-    char unit[8];
-    
-    // 重置读取
-    mem_total_kb = 0;
-    
-    while(fscanf(fp, "%31s %ld %7s", key, &value, unit) == 3) {
-        if(strcmp(key, "MemTotal:") == 0) mem_total_kb = value;
-        else if(strcmp(key, "MemAvailable:") == 0) { mem_available = value; break; }
-    }
-    fclose(fp);
-
-    if(mem_total_kb == 0) return 0;
-    
-    // 计算已用内存
-    mem_used_kb = mem_total_kb - mem_available;
-    
-    return (int)(mem_used_kb * 100 / mem_total_kb);
+    return snap->mem_usage;
 }
 
-static void update_process_table(lv_obj_t * label)
+static void update_process_table(lv_obj_t * list, const sampler_snapshot_t * snap)
 {
-    if(!label) return;
+    if(!list) return;
 
-    /* 使用 ps 命令，因为它比 top 更稳定 */
-    /* 格式: PID, USER, COMMAND */
-    FILE *fp = popen("ps | head -n 10", "r");
-    if (fp == NULL) return;
+    /* 进程扫描和 Top-K 选择都在采样线程完成，这里只绑定数据, 列表只刷新可见且变化的单元格 */
+    if(!snap->has_procs) return;
 
-    char buf[1024] = ""; 
-    char line[128];
-    
-    /* 清空缓冲区 */
-    buf[0] = '\0';
-
-    while (fgets(line, sizeof(line), fp) != NULL) {
-        /* 简单的长度检查 */
-        if (strlen(buf) + strlen(line) < sizeof(buf) - 1) {
-            strcat(buf, line);
-        } else {
-            break; // 缓冲区满了，停止读取
-        }
-    }
-    pclose(fp);
-
-    /* [关键调试] 如果 buf 为空，强制显示错误信息 */
-    if (strlen(buf) < 2) {
-        lv_label_set_text(label, "Command returned empty string");
-    } else {
-        /* 正常设置文本 */
-        lv_label_set_text(label, buf);
-    }
+    proc_list_set_rows(list, snap->procs, snap->proc_count, snap->proc_total, snap->sort_key, snap->has_io);
 }
 
 /*********************
@@ -137,6 +98,13 @@ static void close_win_cb(lv_event_t * e)
     lv_obj_add_flag(win, LV_OBJ_FLAG_HIDDEN);
 }
 
+/* 点击进程表切换排序方式: CPU -> RSS -> IO */
+static void process_table_click_cb(lv_event_t * e)
+{
+    (void)e;
+    top_demo_set_process_sort((process_sort_key + 1) % PROC_SORT_COUNT, process_top_k);
+}
+
 static void meter_click_cb(lv_event_t * e)
 {
     monitor_item_t * item = (monitor_item_t *)lv_event_get_user_data(e);
@@ -145,7 +113,8 @@ static void meter_click_cb(lv_event_t * e)
     }
 }
 
-static void create_monitor_widget(lv_obj_t * parent, monitor_item_t * item, const char * title, int (*cb)(void))
+static void create_monitor_widget(lv_obj_t * parent, monitor_item_t * item, const char * title,
+                                  int (*cb)(const sampler_snapshot_t * snap))
 {
     item->title = title;
     item->get_value_cb = cb;
@@ -153,7 +122,9 @@ static void create_monitor_widget(lv_obj_t * parent, monitor_item_t * item, cons
 
     /* --- 1. 仪表盘部分 (保持不变) --- */
     lv_obj_t * cont = lv_obj_create(parent);
-    lv_obj_set_size(cont, 240, 240);
+    /* 内存的信息行较多, 高度随内容增长 */
+    lv_obj_set_size(cont, 240, LV_SIZE_CONTENT);
+    lv_obj_set_style_min_height(cont, 240, 0);
     lv_obj_set_flex_flow(cont, LV_FLEX_FLOW_COLUMN);
     lv_obj_set_flex_align(cont, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
     lv_obj_add_event_cb(cont, meter_click_cb, LV_EVENT_CLICKED, item);
@@ -170,7 +141,7 @@ static void create_monitor_widget(lv_obj_t * parent, monitor_item_t * item, cons
     lv_obj_remove_flag(item->arc, LV_OBJ_FLAG_CLICKABLE);
 
     item->label_info = lv_label_create(cont);
-    lv_label_set_text(item->label_info, ""); // 默认空，只有内存会更新它
+    lv_label_set_text(item->label_info, ""); // 默认空，CPU 显示负载, 内存显示用量和磁盘吞吐
     lv_obj_set_style_text_font(item->label_info, &lv_font_montserrat_14, 0);
     lv_obj_set_style_text_color(item->label_info, lv_palette_main(LV_PALETTE_GREY), 0);
 
@@ -257,26 +228,102 @@ static void create_monitor_widget(lv_obj_t * parent, monitor_item_t * item, cons
     lv_obj_set_style_margin_top(x_label, -5, 0);
 
 
-        item->label_top_output = lv_label_create(win_content);
-        lv_obj_set_grid_cell(item->label_top_output, LV_GRID_ALIGN_START, 1, 1, LV_GRID_ALIGN_START, 3, 1);
-        
-        /* [关键修改 1] 设置更小的字体，防止内容过多显示不下 */
-        lv_obj_set_style_text_font(item->label_top_output, &lv_font_montserrat_14, 0); 
-        // 如果没有 10 号字体，请使用 &lv_font_montserrat_14 并减少显示的行数
-        
-        /* [关键修改 2] 强制设置宽度和换行模式 */
-        lv_obj_set_width(item->label_top_output, 500); // 设置一个足够大的固定宽度
-        lv_label_set_long_mode(item->label_top_output, LV_LABEL_LONG_WRAP); // 允许换行
-        
-        /* [关键修改 3] 设置对齐和背景，方便调试看到它在哪里 */
-        lv_obj_set_style_bg_color(item->label_top_output, lv_palette_lighten(LV_PALETTE_GREY, 4), 0);
-        lv_obj_set_style_bg_opa(item->label_top_output, LV_OPA_COVER, 0);
-        
-        lv_label_set_text(item->label_top_output, "Waiting for data...");
-    
+    /* 虚拟化的进程列表, 只有可见的行才有对象, 点击切换排序方式 */
+    item->proc_list = proc_list_create(win_content);
+    lv_obj_set_grid_cell(item->proc_list, LV_GRID_ALIGN_STRETCH, 0, 2, LV_GRID_ALIGN_STRETCH, 3, 1);
+    lv_obj_add_event_cb(item->proc_list, process_table_click_cb, LV_EVENT_CLICKED, NULL);
 
-    /* 添加数据系列 */
+    /* 添加数据系列, 历史数据点计入 history */
+    mem_tag_t tag = mem_tag_set(MEM_TAG_HISTORY);
     item->ser = lv_chart_add_series(item->chart, lv_palette_main(LV_PALETTE_RED), LV_CHART_AXIS_PRIMARY_Y);
+    mem_tag_set(tag);
+
+    ui_bind_arc_init(&item->arc_bind, item->arc);
+    ui_bind_label_init(&item->val_bind, item->label_val);
+    ui_bind_label_init(&item->info_bind, item->label_info);
+    ui_bind_chart_init(&item->chart_bind, item->chart, item->ser);
+}
+
+static void heatmap_open_cb(lv_event_t * e)
+{
+    (void)e;
+    lv_obj_remove_flag(heatmap_win, LV_OBJ_FLAG_HIDDEN);
+}
+
+/* 每核心使用率面板, 放在 CPU 仪表盘旁边, 核心数在第一次采样后才知道 */
+static void create_core_panel(lv_obj_t * parent)
+{
+    core_cont = lv_obj_create(parent);
+    lv_obj_set_size(core_cont, 240, 240);
+    lv_obj_set_flex_flow(core_cont, LV_FLEX_FLOW_ROW_WRAP);
+    lv_obj_set_flex_align(core_cont, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+    lv_obj_set_style_pad_all(core_cont, 6, 0);
+    lv_obj_set_style_pad_gap(core_cont, 4, 0);
+    lv_obj_set_scroll_dir(core_cont, LV_DIR_VER);
+
+    /* 点击面板打开每核心历史热力图, 横轴为时间, 纵轴为核心 */
+    heatmap_win = lv_win_create(lv_screen_active());
+    lv_win_add_title(heatmap_win, "Per-core CPU history");
+    lv_obj_t * btn = lv_win_add_button(heatmap_win, LV_SYMBOL_CLOSE, 60);
+    lv_obj_add_event_cb(btn, close_win_cb, LV_EVENT_CLICKED, heatmap_win);
+    lv_obj_add_flag(heatmap_win, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_set_size(heatmap_win, 600, 440);
+    lv_obj_center(heatmap_win);
+
+    heatmap = core_heatmap_create(lv_win_get_content(heatmap_win), HEATMAP_COLUMNS, HEATMAP_HEIGHT);
+    lv_obj_center(heatmap);
+
+    lv_obj_add_event_cb(core_cont, heatmap_open_cb, LV_EVENT_CLICKED, NULL);
+}
+
+static void update_core_arcs(const sampler_snapshot_t * snap)
+{
+    uint32_t i;
+
+    /* 核心上线时补充新的圆弧, 不删除已有的 */
+    for(i = core_arc_count; i < snap->core_count; i++) {
+        lv_obj_t * arc = lv_arc_create(core_cont);
+        lv_obj_set_size(arc, CORE_ARC_SIZE, CORE_ARC_SIZE);
+        lv_arc_set_rotation(arc, 135);
+        lv_arc_set_bg_angles(arc, 0, 270);
+        lv_obj_set_style_arc_width(arc, 6, LV_PART_MAIN);
+        lv_obj_set_style_arc_width(arc, 6, LV_PART_INDICATOR);
+        lv_obj_remove_style(arc, NULL, LV_PART_KNOB);
+        lv_obj_remove_flag(arc, LV_OBJ_FLAG_CLICKABLE);
+
+        lv_obj_t * label = lv_label_create(arc);
+        lv_label_set_text_fmt(label, "%u", (unsigned)i);
+        lv_obj_set_style_text_font(label, &lv_font_montserrat_12, 0);
+        lv_obj_center(label);
+
+        ui_bind_arc_init(&core_arcs[i], arc);
+    }
+    if(snap->core_count > core_arc_count) core_arc_count = snap->core_count;
+
+    for(i = 0; i < core_arc_count; i++) {
+        ui_bind_arc_set(&core_arcs[i], i < snap->core_count ? snap->core_usage[i] : 0);
+    }
+}
+
+static bool process_window_visible(void)
+{
+    return (cpu_mon.win && !lv_obj_has_flag(cpu_mon.win, LV_OBJ_FLAG_HIDDEN)) ||
+           (mem_mon.win && !lv_obj_has_flag(mem_mon.win, LV_OBJ_FLAG_HIDDEN));
+}
+
+/* 采样线程选出的进程数, 没有设置时选到进程表可见区域的底部, 列表的高度仍按进程总数计算 */
+static uint32_t process_rows(void)
+{
+    uint32_t shown = 0;
+    uint32_t rows;
+
+    if(process_top_k) return process_top_k;
+
+    if(cpu_mon.proc_list) shown = proc_list_get_rows_shown(cpu_mon.proc_list);
+    if(mem_mon.proc_list) shown = LV_MAX(shown, proc_list_get_rows_shown(mem_mon.proc_list));
+
+    rows = shown + PROCESS_TABLE_MARGIN_ROWS;
+    return rows < PROCESS_TABLE_MAX_ROWS ? rows : PROCESS_TABLE_MAX_ROWS;
 }
 
 static void update_timer_cb(lv_timer_t * timer)
@@ -284,38 +331,104 @@ static void update_timer_cb(lv_timer_t * timer)
     (void)timer;
     monitor_item_t * items[] = {&cpu_mon, &mem_mon};
 
+    /* 只有窗口可见时才让采样线程扫描进程，避免后台浪费资源 */
+    sampler_set_process_scan(process_window_visible(), process_sort_key, process_rows());
+
+    /* 取最新的快照, 没有新数据时直接返回, 不会阻塞渲染 */
+    const sampler_snapshot_t * snap = sampler_acquire_latest();
+    if(snap == NULL) return;
+
+    update_core_arcs(snap);
+
+    /* 热力图每次采样只画新的一列, 窗口隐藏时也要记录历史 */
+    if(heatmap && snap->core_count) core_heatmap_push(heatmap, snap->core_usage, snap->core_count);
+
     for(int i=0; i<2; i++) {
         monitor_item_t * item = items[i];
         if(!item->get_value_cb) continue;
 
-        int val = item->get_value_cb();
+        int val = item->get_value_cb(snap);
         item->last_value = val;
 
         /* 更新 Arc 和 Label */
-        lv_arc_set_value(item->arc, val);
-        lv_label_set_text_fmt(item->label_val, "%d%%", val);
-
-        if(item == &mem_mon) {
-            int used_mb = mem_used_kb / 1024;
-            int total_mb = mem_total_kb / 1024;
-            lv_label_set_text_fmt(item->label_info, "%dMB / %dMB", used_mb, total_mb);
+        ui_bind_arc_set(&item->arc_bind, val);
+        ui_bind_label_set_fmt(&item->val_bind, "%d%%", val);
+
+        if(item == &cpu_mon) {
+            ui_bind_label_set_fmt(&item->info_bind, "Load %u.%02u %u.%02u %u.%02u",
+                                  (unsigned)snap->loadavg_x100[0] / 100, (unsigned)snap->loadavg_x100[0] % 100,
+                                  (unsigned)snap->loadavg_x100[1] / 100, (unsigned)snap->loadavg_x100[1] % 100,
+                                  (unsigned)snap->loadavg_x100[2] / 100, (unsigned)snap->loadavg_x100[2] % 100);
+        }
+        else if(item == &mem_mon) {
+            int used_mb = snap->mem_used_kb / 1024;
+            int total_mb = snap->mem_total_kb / 1024;
+            char own[64] = "";
+            mem_alloc_stats_t mem;
+
+            /* 仪表盘自身的内存, 按子系统分列 */
+            if(mem_alloc_get_stats(&mem) == 0) {
+                snprintf(own, sizeof(own), "\nWidgets %uK Draw %uK\nSampler %uK History %uK",
+                         (unsigned)(mem.tags[MEM_TAG_WIDGETS].bytes / 1024),
+                         (unsigned)(mem.tags[MEM_TAG_DRAW_BUF].bytes / 1024),
+                         (unsigned)(mem.tags[MEM_TAG_SAMPLER].bytes / 1024),
+                         (unsigned)(mem.tags[MEM_TAG_HISTORY].bytes / 1024));
+            }
+
+            if(snap->has_disk) {
+                ui_bind_label_set_fmt(&item->info_bind, "%dMB / %dMB\nDisk R %uKB/s W %uKB/s%s", used_mb, total_mb,
+                                      (unsigned)snap->disk_read_kbps, (unsigned)snap->disk_write_kbps, own);
+            }
+            else {
+                ui_bind_label_set_fmt(&item->info_bind, "%dMB / %dMB%s", used_mb, total_mb, own);
+            }
         }
 
         /* 更新折线图 */
         if(item->chart) {
-            lv_chart_set_next_value(item->chart, item->ser, val);
+            ui_bind_chart_push(&item->chart_bind, val);
         }
         
-        /* [新增] 如果窗口是可见的，且是 CPU 监视器，更新进程表 */
-        /* 检查窗口是否隐藏，避免后台更新浪费资源 */
-        if (item->label_top_output && item->win && !lv_obj_has_flag(item->win, LV_OBJ_FLAG_HIDDEN)) {
-            update_process_table(item->label_top_output);
+        /* [新增] 如果窗口是可见的，更新进程表 */
+        if (item->proc_list && item->win && !lv_obj_has_flag(item->win, LV_OBJ_FLAG_HIDDEN)) {
+            update_process_table(item->proc_list, snap);
         }
     }
 }
 
+void top_demo_set_process_sort(proc_sort_key_t key, uint32_t k)
+{
+    if(key >= PROC_SORT_COUNT) key = PROC_SORT_CPU;
+    if(k > PROCESS_TABLE_MAX_ROWS) k = PROCESS_TABLE_MAX_ROWS;
+
+    process_sort_key = key;
+    process_top_k = k;
+
+    /* 新的设置在下一次采样时生效, /proc/[pid]/io 只在按 IO 排序时读取 */
+    sampler_set_process_scan(process_window_visible(), key, process_rows());
+}
+
+void top_demo_show(top_demo_view_t view)
+{
+    lv_obj_add_flag(cpu_mon.win, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_flag(mem_mon.win, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_flag(heatmap_win, LV_OBJ_FLAG_HIDDEN);
+
+    /* 进程表可见后, 下一次定时器回调会打开进程扫描 */
+    if(view == TOP_DEMO_VIEW_PROCESSES) lv_obj_remove_flag(cpu_mon.win, LV_OBJ_FLAG_HIDDEN);
+    else if(view == TOP_DEMO_VIEW_HEATMAP) lv_obj_remove_flag(heatmap_win, LV_OBJ_FLAG_HIDDEN);
+}
+
 void top_demo_init(void)
 {
+    const char * sort = getenv_default("TOPDEMO_SORT", "cpu");
+    proc_sort_key_t key = PROC_SORT_CPU;
+
+    if(strcmp(sort, "rss") == 0) key = PROC_SORT_RSS;
+    else if(strcmp(sort, "io") == 0) key = PROC_SORT_IO;
+
+    top_demo_set_process_sort(key, (uint32_t)atoi(getenv_default("TOPDEMO_TOP_K", "0")));
+
     lv_obj_t * scr = lv_screen_active();
     
     /* 创建主布局容器 */
@@ -328,8 +441,29 @@ void top_demo_init(void)
     /* 创建三个监视器 */
     create_monitor_widget(main_cont, &cpu_mon, "CPU Usage(%)", get_cpu_usage);
 
+    create_core_panel(main_cont);
+
     create_monitor_widget(main_cont, &mem_mon, "Memory Usage(%)", get_mem_usage);
 
+    /* 启动采样线程, /proc 的读取不再占用 LVGL 线程 */
+    uint32_t period = (uint32_t)atoi(getenv_default("TOPDEMO_SAMPLE_MS", "0"));
+    if(period == 0) period = SAMPLE_PERIOD_MS;
+    if(sampler_start(period) != 0) {
+        LV_LOG_ERROR("Failed to start the sampler thread");
+    }
+
     /* 启动定时器 */
-    monitor_timer = lv_timer_create(update_timer_cb, 1000, NULL);
+    monitor_timer = lv_timer_create(update_timer_cb, UI_POLL_PERIOD_MS, NULL);
+}
+
+void top_demo_deinit(void)
+{
+    if(monitor_timer) {
+        lv_timer_delete(monitor_timer);
+        monitor_timer = NULL;
+    }
+
+    sampler_stop();
+
+    LV_LOG_USER("Unchanged widget updates skipped: %u", (unsigned)ui_bind_get_saved());
 }
\ No newline at end of file
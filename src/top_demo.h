@@ -6,12 +6,40 @@ extern "C" {
 #endif
 
 #include "../lvgl/lvgl.h"
+#include "proc_topk.h"
+
+/* 可单独显示的界面, 供基准测试切换 */
+typedef enum {
+    TOP_DEMO_VIEW_DASHBOARD,
+    TOP_DEMO_VIEW_PROCESSES,
+    TOP_DEMO_VIEW_HEATMAP,
+} top_demo_view_t;
 
 /**
  * 初始化系统资源监视器 Demo
+ * 进程表的排序方式和行数可以通过环境变量 TOPDEMO_SORT (cpu/rss/io)
+ * 和 TOPDEMO_TOP_K 设置
  */
 void top_demo_init(void);
 
+/**
+ * 停止采样线程, 在 lv_deinit() 之前调用
+ */
+void top_demo_deinit(void);
+
+/**
+ * 设置进程表的排序方式和显示的行数 (运行时可修改)
+ * @param key 排序方式
+ * @param k   显示的进程数, 0 表示按进程表的滚动位置选出可见的行加余量
+ */
+void top_demo_set_process_sort(proc_sort_key_t key, uint32_t k);
+
+/**
+ * 显示一个界面, 其他窗口全部隐藏
+ * @param view 仪表盘, CPU 窗口 (含进程表) 或每核心热力图
+ */
+void top_demo_show(top_demo_view_t view);
+
 #ifdef __cplusplus
 } /*extern "C"*/
 #endif
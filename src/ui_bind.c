@@ -0,0 +1,102 @@
+/**
+ * @file ui_bind.c
+ *
+ * Binding between snapshot values and widgets
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ui_bind.h"
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static uint32_t saved_redraws;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void ui_bind_arc_init(ui_bind_arc_t *bind, lv_obj_t *arc)
+{
+    bind->arc = arc;
+    bind->value = 0;
+    bind->valid = false;
+}
+
+void ui_bind_arc_set(ui_bind_arc_t *bind, int32_t value)
+{
+    if (bind->valid && bind->value == value) {
+        saved_redraws++;
+        return;
+    }
+
+    lv_arc_set_value(bind->arc, value);
+    bind->value = value;
+    bind->valid = true;
+}
+
+void ui_bind_label_init(ui_bind_label_t *bind, lv_obj_t *label)
+{
+    bind->label = label;
+    bind->text[0] = '\0';
+    bind->valid = false;
+}
+
+void ui_bind_label_set_fmt(ui_bind_label_t *bind, const char *fmt, ...)
+{
+    char text[UI_BIND_TEXT_LEN];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+
+    if (bind->valid && strcmp(bind->text, text) == 0) {
+        saved_redraws++;
+        return;
+    }
+
+    memcpy(bind->text, text, sizeof(text));
+    bind->valid = true;
+
+    /* The binding owns the text, the label does not need a copy */
+    lv_label_set_text_static(bind->label, bind->text);
+}
+
+void ui_bind_chart_init(ui_bind_chart_t *bind, lv_obj_t *chart, lv_chart_series_t *ser)
+{
+    bind->chart = chart;
+    bind->ser = ser;
+    bind->value = 0;
+    bind->run = 0;
+}
+
+void ui_bind_chart_push(ui_bind_chart_t *bind, int32_t value)
+{
+    if (bind->run > 0 && bind->value == value) {
+
+        /* Every point shows this value, scrolling would not change a pixel */
+        if (bind->run >= lv_chart_get_point_count(bind->chart)) {
+            saved_redraws++;
+            return;
+        }
+
+        bind->run++;
+    } else {
+        bind->value = value;
+        bind->run = 1;
+    }
+
+    lv_chart_set_next_value(bind->chart, bind->ser, value);
+}
+
+uint32_t ui_bind_get_saved(void)
+{
+    return saved_redraws;
+}
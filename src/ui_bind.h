@@ -0,0 +1,119 @@
+/**
+ * @file ui_bind.h
+ *
+ * Binding between snapshot values and widgets
+ *
+ * Setting a value on a widget invalidates it even when the value is the
+ * same, which costs a redraw and a flush. A binding remembers what was
+ * last rendered and only touches the widget when the visible result
+ * changes, the skipped updates are counted.
+ */
+
+#ifndef UI_BIND_H
+#define UI_BIND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Longest text of a label binding, including the NUL */
+#define UI_BIND_TEXT_LEN    128
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    lv_obj_t *arc;
+    int32_t value;
+    bool valid;
+} ui_bind_arc_t;
+
+typedef struct {
+    lv_obj_t *label;
+    char text[UI_BIND_TEXT_LEN];
+    bool valid;
+} ui_bind_label_t;
+
+typedef struct {
+    lv_obj_t *chart;
+    lv_chart_series_t *ser;
+    int32_t value;                      /* last value pushed */
+    uint32_t run;                       /* number of times in a row value was pushed */
+} ui_bind_chart_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Bind an arc
+ * @param bind the binding
+ * @param arc the arc
+ */
+void ui_bind_arc_init(ui_bind_arc_t *bind, lv_obj_t *arc);
+
+/**
+ * Set the value of a bound arc
+ * @param bind the binding
+ * @param value the new value
+ */
+void ui_bind_arc_set(ui_bind_arc_t *bind, int32_t value);
+
+/**
+ * Bind a label
+ * @param bind the binding
+ * @param label the label
+ */
+void ui_bind_label_init(ui_bind_label_t *bind, lv_obj_t *label);
+
+/**
+ * Set the text of a bound label
+ * @description the text is formatted into the binding first, the label
+ * is only updated if the result differs from what it shows
+ * @param bind the binding
+ * @param fmt printf-like format
+ */
+void ui_bind_label_set_fmt(ui_bind_label_t *bind, const char *fmt, ...) LV_FORMAT_ATTRIBUTE(2, 3);
+
+/**
+ * Bind a chart series
+ * @param bind the binding
+ * @param chart the chart
+ * @param ser the series
+ */
+void ui_bind_chart_init(ui_bind_chart_t *bind, lv_obj_t *chart, lv_chart_series_t *ser);
+
+/**
+ * Push the next value of a bound series
+ * @description pushing a value scrolls the chart, it is only skipped once
+ * every visible point already has this value
+ * @param bind the binding
+ * @param value the new value
+ */
+void ui_bind_chart_push(ui_bind_chart_t *bind, int32_t value);
+
+/**
+ * Get the number of widget updates skipped because nothing visible changed
+ * @return the number of redraws saved since the start
+ */
+uint32_t ui_bind_get_saved(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*UI_BIND_H*/